@@ -8,6 +8,9 @@
 #include "txdb.h"
 #include "libzerocoin/Denominations.h"
 
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
 using namespace libzerocoin;
 using namespace std;
 
@@ -61,6 +64,33 @@ bool AccumulatorMap::Accumulate(PublicCoin pubCoin, bool fSkipValidation)
     return true;
 }
 
+//Add already validated zerocoins of several denominations. The accumulators of the denominations are independent, each
+//one is brought up to date on its own thread.
+bool AccumulatorMap::AccumulateDenominations(const std::map<CoinDenomination, std::vector<CBigNum> >& mapValues)
+{
+    std::vector<std::pair<Accumulator*, const std::vector<CBigNum>*> > vWork;
+    for (auto& denomValues : mapValues) {
+        if (denomValues.first == CoinDenomination::ZQ_ERROR)
+            return false;
+        if (!denomValues.second.empty())
+            vWork.push_back(make_pair(mapAccumulators.at(denomValues.first).get(), &denomValues.second));
+    }
+
+    auto accumulate = [](Accumulator* accumulator, const std::vector<CBigNum>* pvValues) {
+        for (const CBigNum& bnValue : *pvValues)
+            accumulator->increment(bnValue);
+    };
+
+    //the last denomination is done on this thread
+    boost::thread_group threadGroup;
+    for (size_t i = 0; i + 1 < vWork.size(); i++)
+        threadGroup.create_thread(boost::bind<void>(accumulate, vWork[i].first, vWork[i].second));
+    if (!vWork.empty())
+        accumulate(vWork.back().first, vWork.back().second);
+    threadGroup.join_all();
+    return true;
+}
+
 //Get the value of a specific accumulator
 CBigNum AccumulatorMap::GetValue(CoinDenomination denom)
 {
@@ -16,6 +16,7 @@ public:
     AccumulatorMap();
     bool Load(uint256 nCheckpoint);
     bool Accumulate(libzerocoin::PublicCoin pubCoin, bool fSkipValidation = false);
+    bool AccumulateDenominations(const std::map<libzerocoin::CoinDenomination, std::vector<CBigNum> >& mapValues);
     CBigNum GetValue(libzerocoin::CoinDenomination denom);
     uint256 GetCheckpoint();
     void Reset();
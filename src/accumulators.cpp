@@ -151,6 +151,41 @@ bool EraseCheckpoints(int nStartHeight, int nEndHeight)
     return true;
 }
 
+//Get the validated pubcoins minted in a block by denomination, along with the block's total mint count.
+//Uses the per block pubcoin index in zerocoinDB and only reads and validates the full block the first time.
+bool GetBlockPubcoins(const CBlockIndex* pindex, int& nMints, std::map<CoinDenomination, std::vector<CBigNum> >& mapPubcoins)
+{
+    if (zerocoinDB->ReadBlockPubcoins(pindex->nHeight, pindex->GetBlockHash(), nMints, mapPubcoins))
+        return true;
+
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex)) {
+        LogPrint("zero", "%s: failed to read block from disk\n", __func__);
+        return false;
+    }
+
+    std::list<PublicCoin> listPubcoins;
+    if (!BlockToPubcoinList(block, listPubcoins)) {
+        LogPrint("zero", "%s: failed to get zerocoin mintlist from block %d\n", __func__, pindex->nHeight);
+        return false;
+    }
+
+    nMints = listPubcoins.size();
+    mapPubcoins.clear();
+    for (const PublicCoin& pubcoin : listPubcoins) {
+        //There are two invalid mints on chain that were never accumulated
+        if (!pubcoin.validate())
+            continue;
+
+        mapPubcoins[pubcoin.getDenomination()].push_back(pubcoin.getValue());
+    }
+
+    if (!zerocoinDB->WriteBlockPubcoins(pindex->nHeight, pindex->GetBlockHash(), nMints, mapPubcoins))
+        LogPrint("zero", "%s: failed to index pubcoins of block %d\n", __func__, pindex->nHeight);
+
+    return true;
+}
+
 //Get checkpoint value for a specific block height
 bool CalculateAccumulatorCheckpoint(int nHeight, uint256& nCheckpoint)
 {
@@ -179,6 +214,7 @@ bool CalculateAccumulatorCheckpoint(int nHeight, uint256& nCheckpoint)
 
     //Accumulate all coins over the last ten blocks that havent been accumulated (height - 20 through height - 11)
     int nTotalMintsFound = 0;
+    std::map<CoinDenomination, std::vector<CBigNum> > mapPubcoinsAdded;
     CBlockIndex *pindex = chainActive[nHeight - 20];
 
     //When zerocoin activates, search previous blocks for mints that were accidentally minted before activation time
@@ -199,35 +235,29 @@ bool CalculateAccumulatorCheckpoint(int nHeight, uint256& nCheckpoint)
             continue;
         }
 
-        //grab mints from this block
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex)) {
-            LogPrint("zero","%s: failed to read block from disk\n", __func__);
-            return false;
-        }
-
-        std::list<PublicCoin> listPubcoins;
-        if (!BlockToPubcoinList(block, listPubcoins)) {
-            LogPrint("zero","%s: failed to get zerocoin mintlist from block %n\n", __func__, pindex->nHeight);
+        //grab the validated mints of this block
+        int nMints = 0;
+        std::map<CoinDenomination, std::vector<CBigNum> > mapPubcoins;
+        if (!GetBlockPubcoins(pindex, nMints, mapPubcoins))
             return false;
-        }
 
-        nTotalMintsFound += listPubcoins.size();
-        LogPrint("zero", "%s found %d mints\n", __func__, listPubcoins.size());
-
-        //add the pubcoins to accumulator
-        for (const PublicCoin pubcoin : listPubcoins) {
-            if (!pubcoin.validate())
-                continue;
+        nTotalMintsFound += nMints;
+        LogPrint("zero", "%s found %d mints\n", __func__, nMints);
 
-            if(!mapAccumulators.Accumulate(pubcoin, true)) {
-                LogPrintf("%s: failed to add pubcoin to accumulator at height %n\n", __func__, pindex->nHeight);
-                return false;
-            }
+        //queue the pubcoins, the accumulators of all denominations are updated together
+        for (auto& denomPubcoins : mapPubcoins) {
+            std::vector<CBigNum>& vAdded = mapPubcoinsAdded[denomPubcoins.first];
+            vAdded.insert(vAdded.end(), denomPubcoins.second.begin(), denomPubcoins.second.end());
         }
         pindex = chainActive.Next(pindex);
     }
 
+    //add the pubcoins to accumulator
+    if (!mapAccumulators.AccumulateDenominations(mapPubcoinsAdded)) {
+        LogPrintf("%s: failed to add pubcoins to accumulator at height %d\n", __func__, nHeight);
+        return false;
+    }
+
     // if there were no new mints found, the accumulator checkpoint will be the same as the last checkpoint
     if (nTotalMintsFound == 0) {
         nCheckpoint = chainActive[nHeight - 1]->nAccumulatorCheckpoint;
@@ -247,7 +277,27 @@ bool InvalidCheckpointRange(int nHeight)
     return nHeight > Params().Zerocoin_Block_LastGoodCheckpoint() && nHeight < Params().Zerocoin_Block_RecalculateAccumulators();
 }
 
-bool GenerateAccumulatorWitness(const CZerocoinMint &mint, Accumulator& accumulator, AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, string& strError)
+bool IsWitnessCacheValid(const CZerocoinWitness& witnessCache, const CBigNum& bnPubcoin, int nAccStartHeight, const CBlockIndex* pindexTip)
+{
+    if (witnessCache.IsNull() || witnessCache.bnPubcoin != bnPubcoin || witnessCache.nHeightAccStart != nAccStartHeight)
+        return false;
+    if (witnessCache.nHeightAccEnd <= nAccStartHeight || witnessCache.nHeightAccEnd > pindexTip->nHeight + 1)
+        return false;
+
+    //the last block added must still be an ancestor of the tip, otherwise it was reorganized away
+    return pindexTip->GetAncestor(witnessCache.nHeightAccEnd - 1)->GetBlockHash() == witnessCache.hashBlockEnd;
+}
+
+//! The part of a block index entry a witness is built from, copied under cs_main
+struct CWitnessBlock {
+    const CBlockIndex* pindex;
+    uint256 nAccumulatorCheckpoint;
+    bool fMinted; //! whether the block has mints of the denomination of the witness
+
+    CWitnessBlock(const CBlockIndex* pindexIn, const uint256& nAccumulatorCheckpointIn, bool fMintedIn) : pindex(pindexIn), nAccumulatorCheckpoint(nAccumulatorCheckpointIn), fMinted(fMintedIn) {}
+};
+
+bool GenerateAccumulatorWitness(const CZerocoinMint &mint, Accumulator& accumulator, AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, string& strError, CZerocoinWitness* pwitnessCache)
 {
     libzerocoin::PublicCoin coin(Params().Zerocoin_Params(), mint.GetValue(), mint.GetDenomination());
     CTransaction txMinted;
@@ -257,40 +307,57 @@ bool GenerateAccumulatorWitness(const CZerocoinMint &mint, Accumulator& accumula
         return false;
     }
 
-    int nHeightMintAdded= mapBlockIndex[hashBlock]->nHeight;
+    //copy what is needed of the blocks from the accumulator start to the tip in one pass under cs_main, the
+    //checkpoints and mint denominations of the index are written by ConnectBlock and DisconnectBlock
+    const CBlockIndex* pindexTip;
+    int nHeightMintAdded;
     uint256 nCheckpointBeforeMint = 0;
-    CBlockIndex* pindex = chainActive[nHeightMintAdded];
-    int nChanges = 0;
-
-    //find the checksum when this was added to the accumulator officially, which will be two checksum changes later
-    //reminder that checksums are generated when the block height is a multiple of 10
-    while (pindex->nHeight < chainActive.Tip()->nHeight - 1) {
-        if (pindex->nHeight == nHeightMintAdded) {
-            pindex = chainActive[pindex->nHeight + 1];
-            continue;
+    int nAccStartHeight;
+    int nMintsBeforeStart = 0;
+    std::vector<CWitnessBlock> vBlocks;
+    {
+        LOCK(cs_main);
+        BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+        if (mi == mapBlockIndex.end() || !chainActive.Contains(mi->second)) {
+            LogPrintf("%s mint tx is not in the active chain\n", __func__);
+            return false;
         }
+        pindexTip = chainActive.Tip();
+        nHeightMintAdded = mi->second->nHeight;
+
+        //find the checksum when this was added to the accumulator officially, which will be two checksum changes later
+        //reminder that checksums are generated when the block height is a multiple of 10
+        int nHeightCheckpoint = nHeightMintAdded + 10 - (nHeightMintAdded % 10);
+        if (nHeightCheckpoint < pindexTip->nHeight - 1)
+            nCheckpointBeforeMint = chainActive[nHeightCheckpoint]->nAccumulatorCheckpoint;
+        else
+            nHeightCheckpoint = std::max(nHeightMintAdded, pindexTip->nHeight - 1);
 
-        //check if the next checksum was generated
-        if (pindex->nHeight % 10 == 0) {
-            nChanges++;
+        //the height to start accumulating coins to add to witness
+        nAccStartHeight = nHeightMintAdded - (nHeightMintAdded % 10);
 
-            if (nChanges == 1) {
-                nCheckpointBeforeMint = pindex->nAccumulatorCheckpoint;
-                break;
-            }
+        //If the checkpoint is from the recalculated checkpoint period, then adjust it
+        if (nHeightCheckpoint < Params().Zerocoin_StartHeight()) {
+            //The checkpoint before the mint will be the last good checkpoint
+            nCheckpointBeforeMint = 0;
+            nAccStartHeight = Params().Zerocoin_AccumulatorStartHeight();
         }
-        pindex = chainActive.Next(pindex);
-    }
 
-    //the height to start accumulating coins to add to witness
-    int nAccStartHeight = nHeightMintAdded - (nHeightMintAdded % 10);
+        //count how many mints of this denomination existed in the accumulator the witness starts from
+        for (int nHeight = Params().Zerocoin_AccumulatorStartHeight(); nHeight < nAccStartHeight; nHeight++) {
+            const std::vector<CoinDenomination>& vMinted = chainActive[nHeight]->vMintDenominationsInBlock;
+            nMintsBeforeStart += count(vMinted.begin(), vMinted.end(), coin.getDenomination());
+        }
 
-    //If the checkpoint is from the recalculated checkpoint period, then adjust it
-    if (pindex->nHeight < Params().Zerocoin_StartHeight()) {
-        //The checkpoint before the mint will be the last good checkpoint
-        nCheckpointBeforeMint = 0;
-        nAccStartHeight = Params().Zerocoin_AccumulatorStartHeight();
+        //the block before the start is included for the checkpoint change test of the first block added
+        int nFirstHeight = std::max(nAccStartHeight - 1, 0);
+        vBlocks.reserve(pindexTip->nHeight - nFirstHeight + 1);
+        for (int nHeight = nFirstHeight; nHeight <= pindexTip->nHeight; nHeight++) {
+            const CBlockIndex* pindex = chainActive[nHeight];
+            vBlocks.push_back(CWitnessBlock(pindex, pindex->nAccumulatorCheckpoint, pindex->MintedDenomination(coin.getDenomination())));
+        }
     }
+    const int nFirstHeight = pindexTip->nHeight + 1 - vBlocks.size();
 
     //Get the accumulator that is right before the cluster of blocks containing our mint was added to the accumulator
     CBigNum bnAccValue = 0;
@@ -316,64 +383,83 @@ bool GenerateAccumulatorWitness(const CZerocoinMint &mint, Accumulator& accumula
             nSecurityLevel = 99;
     }
 
-    //add the pubcoins (zerocoinmints that have been published to the chain) up to the next checksum starting from the block
-    pindex = chainActive[nAccStartHeight];
-    int nChainHeight = chainActive.Height();
+    //find the block where the witness stops: the pubcoins (zerocoinmints that have been published to the chain) are added
+    //up to the next checksum starting from the block
+    int nChainHeight = pindexTip->nHeight;
     int nHeightStop = nChainHeight % 10;
     nHeightStop = nChainHeight - nHeightStop - 20; // at least two checkpoints deep
     int nCheckpointsAdded = 0;
+    int nHeightWitnessEnd = -1;
     nMintsAdded = 0;
-    while (pindex->nHeight < nHeightStop + 1) {
-        if (pindex->nHeight != nAccStartHeight && pindex->pprev->nAccumulatorCheckpoint != pindex->nAccumulatorCheckpoint)
+    for (int nHeight = nAccStartHeight; nHeight < nHeightStop + 1; nHeight++) {
+        if (nHeight != nAccStartHeight && vBlocks[nHeight - 1 - nFirstHeight].nAccumulatorCheckpoint != vBlocks[nHeight - nFirstHeight].nAccumulatorCheckpoint)
             ++nCheckpointsAdded;
 
         //if a new checkpoint was generated on this block, and we have added the specified amount of checkpointed accumulators,
         //then initialize the accumulator at this point and break
-        if (pindex->nHeight == nHeightStop || (nSecurityLevel != 100 && nCheckpointsAdded >= nSecurityLevel)) {
-            uint32_t nChecksum = ParseChecksum(chainActive[pindex->nHeight + 10]->nAccumulatorCheckpoint, coin.getDenomination());
+        if (nHeight == nHeightStop || (nSecurityLevel != 100 && nCheckpointsAdded >= nSecurityLevel)) {
+            uint32_t nChecksum = ParseChecksum(vBlocks[nHeight + 10 - nFirstHeight].nAccumulatorCheckpoint, coin.getDenomination());
             CBigNum bnAccValue = 0;
             if (!zerocoinDB->ReadAccumulatorValue(nChecksum, bnAccValue)) {
                 LogPrintf("%s : failed to find checksum in database for accumulator\n", __func__);
                 return false;
             }
             accumulator.setValue(bnAccValue);
+            nHeightWitnessEnd = nHeight;
             break;
         }
+    }
 
-        // if this block contains mints of the denomination that is being spent, then add them to the witness
-        if (pindex->nHeight < Params().Zerocoin_StartHeight() || pindex->MintedDenomination(coin.getDenomination())) {
-            //grab mints from this block
-            CBlock block;
-            if(!ReadBlockFromDisk(block, pindex)) {
-                LogPrintf("%s: failed to read block from disk while adding pubcoins to witness\n", __func__);
-                return false;
-            }
+    //resume from the cached witness if it was built on this chain and does not already go past the requested end
+    int nHeightAddFrom = nAccStartHeight;
+    if (pwitnessCache && !pwitnessCache->IsNull()) {
+        //a witness built on blocks that were since reorganized away has to be rebuilt from the start
+        bool fCacheValid = IsWitnessCacheValid(*pwitnessCache, mint.GetValue(), nAccStartHeight, pindexTip);
+        if (fCacheValid && pwitnessCache->nHeightAccEnd <= nHeightWitnessEnd) {
+            Accumulator accumulatorCached(Params().Zerocoin_Params(), coin.getDenomination(), pwitnessCache->bnWitness);
+            witness.resetValue(accumulatorCached, coin);
+            nMintsAdded = pwitnessCache->nMintsAdded;
+            nHeightAddFrom = pwitnessCache->nHeightAccEnd;
+            LogPrint("zero", "%s : resuming witness at height %d\n", __func__, nHeightAddFrom);
+        } else if (!fCacheValid) {
+            LogPrint("zero", "%s : discarding stale witness cache\n", __func__);
+            pwitnessCache->SetNull();
+        }
+    }
+
+    //add the pubcoins of the denomination being spent, from the start height up to (not including) the end block
+    for (int nHeight = nHeightAddFrom; nHeight < nHeightWitnessEnd; nHeight++) {
+        const CWitnessBlock& block = vBlocks[nHeight - nFirstHeight];
 
-            list<PublicCoin> listPubcoins;
-            if(!BlockToPubcoinList(block, listPubcoins)) {
-                LogPrintf("%s: failed to get zerocoin mintlist from block %n\n", __func__, pindex->nHeight);
+        // if this block contains mints of the denomination that is being spent, then add them to the witness
+        if (nHeight < Params().Zerocoin_StartHeight() || block.fMinted) {
+            //grab the validated mints from this block
+            int nMints = 0;
+            std::map<CoinDenomination, std::vector<CBigNum> > mapPubcoins;
+            if (!GetBlockPubcoins(block.pindex, nMints, mapPubcoins)) {
+                LogPrintf("%s: failed to get pubcoins of block %d while adding them to witness\n", __func__, nHeight);
                 return false;
             }
 
             //add the mints to the witness
-            for (const PublicCoin pubcoin : listPubcoins) {
-                if (pubcoin.getDenomination() != coin.getDenomination())
-                    continue;
-
-                if (pindex->nHeight == nHeightMintAdded && pubcoin.getValue() == coin.getValue())
+            for (const CBigNum& bnValue : mapPubcoins[coin.getDenomination()]) {
+                if (nHeight == nHeightMintAdded && bnValue == coin.getValue())
                     continue;
 
-                //There are two invalid mints that were not accumulated - note this significantly slows down the witness
-                //it may be better finding those two invalid mints and hard coding a check against their value instead
-                if (!pubcoin.validate())
-                    continue;
-
-                witness.addRawValue(pubcoin.getValue());
+                witness.addRawValue(bnValue);
                 ++nMintsAdded;
             }
         }
+    }
 
-        pindex = chainActive[pindex->nHeight + 1];
+    //remember how far the witness got so the next request only has to add the blocks after it
+    if (pwitnessCache && nHeightWitnessEnd > nAccStartHeight && (pwitnessCache->IsNull() || nHeightWitnessEnd > pwitnessCache->nHeightAccEnd)) {
+        pwitnessCache->bnPubcoin = mint.GetValue();
+        pwitnessCache->nHeightAccStart = nAccStartHeight;
+        pwitnessCache->nHeightAccEnd = nHeightWitnessEnd;
+        pwitnessCache->hashBlockEnd = vBlocks[nHeightWitnessEnd - 1 - nFirstHeight].pindex->GetBlockHash();
+        pwitnessCache->bnWitness = witness.getValue();
+        pwitnessCache->nMintsAdded = nMintsAdded;
     }
 
     if (nMintsAdded < Params().Zerocoin_RequiredAccumulation()) {
@@ -382,12 +468,8 @@ bool GenerateAccumulatorWitness(const CZerocoinMint &mint, Accumulator& accumula
         return false;
     }
 
-    // calculate how many mints of this denomination existed in the accumulator we initialized
-    pindex = chainActive[Params().Zerocoin_AccumulatorStartHeight()];
-    while (pindex->nHeight < nAccStartHeight) {
-        nMintsAdded += count(pindex->vMintDenominationsInBlock.begin(), pindex->vMintDenominationsInBlock.end(), coin.getDenomination());
-        pindex = chainActive[pindex->nHeight + 1];
-    }
+    // add how many mints of this denomination existed in the accumulator we initialized
+    nMintsAdded += nMintsBeforeStart;
 
     LogPrintf("%s : %d mints added to witness\n", __func__, nMintsAdded);
     return true;
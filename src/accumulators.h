@@ -11,7 +11,15 @@
 #include "primitives/zerocoin.h"
 #include "uint256.h"
 
-bool GenerateAccumulatorWitness(const CZerocoinMint& mint, libzerocoin::Accumulator& accumulator, libzerocoin::AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, std::string& strError);
+#include <map>
+#include <vector>
+
+class CBlockIndex;
+
+bool GetBlockPubcoins(const CBlockIndex* pindex, int& nMints, std::map<libzerocoin::CoinDenomination, std::vector<CBigNum> >& mapPubcoins);
+/** Whether a cached witness of bnPubcoin can be resumed on the chain ending at pindexTip */
+bool IsWitnessCacheValid(const CZerocoinWitness& witnessCache, const CBigNum& bnPubcoin, int nAccStartHeight, const CBlockIndex* pindexTip);
+bool GenerateAccumulatorWitness(const CZerocoinMint& mint, libzerocoin::Accumulator& accumulator, libzerocoin::AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, std::string& strError, CZerocoinWitness* pwitnessCache = NULL);
 bool GetAccumulatorValueFromDB(uint256 nCheckpoint, libzerocoin::CoinDenomination denom, CBigNum& bnAccValue);
 bool GetAccumulatorValueFromChecksum(uint32_t nChecksum, bool fMemoryOnly, CBigNum& bnAccValue);
 void AddAccumulatorChecksum(const uint32_t nChecksum, const CBigNum &bnValue, bool fMemoryOnly);
@@ -0,0 +1,107 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Copyright (c) 2026 The Loonie developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using namespace benchmark;
+
+static int64_t GetTimeNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+BenchRunner::BenchmarkMap& BenchRunner::benchmarks()
+{
+    static BenchmarkMap benchmarks_map;
+    return benchmarks_map;
+}
+
+BenchRunner::BenchRunner(std::string name, BenchFunction func, uint64_t nIterations)
+{
+    Bench bench;
+    bench.func = func;
+    bench.nIterations = nIterations;
+    benchmarks().insert(std::make_pair(name, bench));
+}
+
+void BenchRunner::RunAll(double elapsedTimeForOne, const std::string& strFilter, const std::string& strFormat)
+{
+    std::vector<Result> vResults;
+    for (BenchmarkMap::iterator it = benchmarks().begin(); it != benchmarks().end(); ++it) {
+        if (!strFilter.empty() && it->first.find(strFilter) == std::string::npos)
+            continue;
+
+        std::cerr << "Running " << it->first << std::endl;
+        State state(it->first, elapsedTimeForOne, it->second.nIterations);
+        it->second.func(state);
+        vResults.push_back(state.GetResult());
+    }
+
+    PrintResults(vResults, strFormat);
+}
+
+bool State::KeepRunning()
+{
+    int64_t now = GetTimeNanos();
+    if (count == 0) {
+        beginTime = lastTime = now;
+        ++count;
+        return true;
+    }
+
+    double elapsed = now - lastTime;
+    if (count == 1 || elapsed < minTime)
+        minTime = elapsed;
+    if (elapsed > maxTime)
+        maxTime = elapsed;
+    lastTime = now;
+
+    bool fDone = maxIterations ? count >= maxIterations : (now - beginTime) * 1e-9 >= maxElapsed;
+    if (fDone)
+        return false;
+
+    ++count;
+    return true;
+}
+
+Result State::GetResult() const
+{
+    Result result;
+    result.strName = name;
+    result.nIterations = count;
+    result.dTotal = lastTime - beginTime;
+    result.dMin = minTime;
+    result.dMax = maxTime;
+    return result;
+}
+
+void benchmark::PrintResults(const std::vector<Result>& vResults, const std::string& strFormat)
+{
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    if (strFormat == "json") {
+        ss << "[\n";
+        for (size_t i = 0; i < vResults.size(); i++) {
+            const Result& result = vResults[i];
+            ss << "  {\"name\": \"" << result.strName << "\", \"iterations\": " << result.nIterations
+               << ", \"ns_per_op\": " << result.NsPerOp() << ", \"ops_per_sec\": " << result.OpsPerSec()
+               << ", \"min_ns\": " << result.dMin << ", \"max_ns\": " << result.dMax << "}"
+               << (i + 1 < vResults.size() ? "," : "") << "\n";
+        }
+        ss << "]\n";
+    } else {
+        ss << "#name,iterations,ns_per_op,ops_per_sec,min_ns,max_ns\n";
+        for (const Result& result : vResults) {
+            ss << result.strName << "," << result.nIterations << "," << result.NsPerOp() << ","
+               << result.OpsPerSec() << "," << result.dMin << "," << result.dMax << "\n";
+        }
+    }
+    std::cout << ss.str();
+}
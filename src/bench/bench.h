@@ -0,0 +1,100 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Copyright (c) 2026 The Loonie developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BENCH_BENCH_H
+#define BITCOIN_BENCH_BENCH_H
+
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/preprocessor/cat.hpp>
+#include <boost/preprocessor/stringize.hpp>
+
+// Simple micro-benchmarking framework; API mostly matches a subset of the Google Benchmark
+// framework (see https://github.com/google/benchmark)
+// Why not use the Google Benchmark framework? Because adding Yet Another Dependency
+// (that uses cmake as its build system and has lots of features we don't need) isn't
+// worth it.
+
+/*
+ * Usage:
+
+static void CODE_TO_TIME(benchmark::State& state)
+{
+    ... do any setup needed...
+    while (state.KeepRunning()) {
+       ... do stuff you want to time...
+    }
+    ... do any cleanup needed...
+}
+
+BENCHMARK(CODE_TO_TIME);
+
+ */
+
+namespace benchmark
+{
+/** Timing of one benchmark, in nanoseconds per iteration */
+struct Result {
+    std::string strName;
+    uint64_t nIterations;
+    double dTotal;
+    double dMin;
+    double dMax;
+
+    double NsPerOp() const { return nIterations ? dTotal / nIterations : 0; }
+    double OpsPerSec() const { return dTotal > 0 ? nIterations * 1e9 / dTotal : 0; }
+};
+
+class State
+{
+    std::string name;
+    double maxElapsed;
+    uint64_t maxIterations;
+    int64_t beginTime;
+    int64_t lastTime;
+    double minTime, maxTime;
+    uint64_t count;
+
+public:
+    /** Run until maxElapsed seconds have passed, or for exactly maxIterations if it is not 0 */
+    State(std::string _name, double _maxElapsed, uint64_t _maxIterations = 0) : name(_name), maxElapsed(_maxElapsed), maxIterations(_maxIterations), beginTime(0), lastTime(0), minTime(0), maxTime(0), count(0) {}
+    bool KeepRunning();
+    Result GetResult() const;
+};
+
+typedef boost::function<void(State&)> BenchFunction;
+
+class BenchRunner
+{
+    struct Bench {
+        BenchFunction func;
+        uint64_t nIterations;
+    };
+    typedef std::map<std::string, Bench> BenchmarkMap;
+    static BenchmarkMap& benchmarks();
+
+public:
+    BenchRunner(std::string name, BenchFunction func, uint64_t nIterations = 0);
+
+    /** Run every benchmark whose name contains strFilter and print the results as "csv" or "json" */
+    static void RunAll(double elapsedTimeForOne, const std::string& strFilter, const std::string& strFormat);
+};
+
+void PrintResults(const std::vector<Result>& vResults, const std::string& strFormat);
+}
+
+// BENCHMARK(foo) expands to:  benchmark::BenchRunner bench_11foo("foo", foo);
+#define BENCHMARK(n) \
+    benchmark::BenchRunner BOOST_PP_CAT(bench_, BOOST_PP_CAT(__LINE__, n))(BOOST_PP_STRINGIZE(n), n);
+
+// BENCHMARK_N(foo, 100) times exactly 100 iterations of foo instead of running for a fixed time
+#define BENCHMARK_N(n, iterations) \
+    benchmark::BenchRunner BOOST_PP_CAT(bench_, BOOST_PP_CAT(__LINE__, n))(BOOST_PP_STRINGIZE(n), n, iterations);
+
+#endif // BITCOIN_BENCH_BENCH_H
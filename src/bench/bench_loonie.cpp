@@ -0,0 +1,30 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Copyright (c) 2026 The Loonie developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "chainparams.h"
+#include "util.h"
+
+#include <iostream>
+
+int main(int argc, char** argv)
+{
+    ParseParameters(argc, argv);
+    if (mapArgs.count("-?") || mapArgs.count("-h") || mapArgs.count("-help")) {
+        std::cout << "Usage: bench_loonie [options]\n\n"
+                  << "Options:\n"
+                  << "  -filter=<name>     Only run the benchmarks whose name contains <name>\n"
+                  << "  -format=<format>   Output format of the results: csv or json (default: csv)\n"
+                  << "  -time=<seconds>    Time to run each benchmark for (default: 1)\n";
+        return 0;
+    }
+
+    SelectParams(CBaseChainParams::MAIN);
+    fPrintToDebugLog = false;
+
+    double dTime = atof(GetArg("-time", "1").c_str());
+    benchmark::BenchRunner::RunAll(dTime, GetArg("-filter", ""), GetArg("-format", "csv"));
+}
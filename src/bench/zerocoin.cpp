@@ -0,0 +1,152 @@
+// Copyright (c) 2026 The Loonie developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+
+#include "accumulatormap.h"
+#include "chainparams.h"
+#include "libzerocoin/Accumulator.h"
+#include "libzerocoin/Coin.h"
+#include "libzerocoin/CoinSpend.h"
+#include "libzerocoin/Denominations.h"
+
+using namespace libzerocoin;
+
+//amount of coins the accumulator growth benchmark adds to a single accumulator
+static const uint64_t ACCUMULATOR_GROWTH_COINS = 100000;
+
+//coins of each denomination added per checkpoint, roughly a busy ten blocks
+static const int CHECKPOINT_COINS_PER_DENOM = 10;
+
+//Random values of the size of a pubcoin. Accumulating does not depend on the value being prime, so these
+//stand in for real coins where minting that many would dominate the benchmark
+static std::vector<CBigNum> RandomPubcoinValues(size_t nCount)
+{
+    const ZerocoinParams* params = Params().Zerocoin_Params();
+    std::vector<CBigNum> vValues;
+    vValues.reserve(nCount);
+    for (size_t i = 0; i < nCount; i++)
+        vValues.push_back(CBigNum::randBignum(params->coinCommitmentGroup.modulus));
+    return vValues;
+}
+
+static void ZerocoinMint(benchmark::State& state)
+{
+    const ZerocoinParams* params = Params().Zerocoin_Params();
+    while (state.KeepRunning()) {
+        PrivateCoin coin(params, ZQ_ONE);
+    }
+}
+
+static void ZerocoinPubcoinValidate(benchmark::State& state)
+{
+    const ZerocoinParams* params = Params().Zerocoin_Params();
+    PrivateCoin coin(params, ZQ_ONE);
+    const PublicCoin& pubcoin = coin.getPublicCoin();
+    while (state.KeepRunning()) {
+        if (!pubcoin.validate())
+            throw std::runtime_error("minted coin does not validate");
+    }
+}
+
+//Spend setup: a coin and its witness in an accumulator holding a few other coins
+struct SpendSetup {
+    PrivateCoin coin;
+    Accumulator accumulator;
+    AccumulatorWitness witness;
+
+    SpendSetup(const ZerocoinParams* params) : coin(params, ZQ_ONE), accumulator(params, ZQ_ONE), witness(params, accumulator, coin.getPublicCoin())
+    {
+        for (int i = 0; i < 5; i++) {
+            PrivateCoin coinOther(params, ZQ_ONE);
+            accumulator += coinOther.getPublicCoin();
+            witness += coinOther.getPublicCoin();
+        }
+        accumulator += coin.getPublicCoin();
+    }
+};
+
+static void ZerocoinSpendCreate(benchmark::State& state)
+{
+    const ZerocoinParams* params = Params().Zerocoin_Params();
+    SpendSetup setup(params);
+    while (state.KeepRunning()) {
+        CoinSpend spend(params, setup.coin, setup.accumulator, 0, setup.witness, 0);
+    }
+}
+
+static void ZerocoinSpendVerify(benchmark::State& state)
+{
+    const ZerocoinParams* params = Params().Zerocoin_Params();
+    SpendSetup setup(params);
+    CoinSpend spend(params, setup.coin, setup.accumulator, 0, setup.witness, 0);
+    while (state.KeepRunning()) {
+        if (!spend.Verify(setup.accumulator))
+            throw std::runtime_error("spend does not verify");
+    }
+}
+
+static void ZerocoinAccumulatorGrowth(benchmark::State& state)
+{
+    std::vector<CBigNum> vValues = RandomPubcoinValues(ACCUMULATOR_GROWTH_COINS);
+    Accumulator accumulator(Params().Zerocoin_Params(), ZQ_ONE);
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        accumulator.increment(vValues[i++ % vValues.size()]);
+    }
+}
+
+static void ZerocoinWitnessUpdate(benchmark::State& state)
+{
+    const ZerocoinParams* params = Params().Zerocoin_Params();
+    std::vector<CBigNum> vValues = RandomPubcoinValues(1000);
+    PrivateCoin coin(params, ZQ_ONE);
+    Accumulator accumulator(params, ZQ_ONE);
+    AccumulatorWitness witness(params, accumulator, coin.getPublicCoin());
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        witness.addRawValue(vValues[i++ % vValues.size()]);
+    }
+}
+
+static std::map<CoinDenomination, std::vector<CBigNum> > CheckpointPubcoins()
+{
+    std::map<CoinDenomination, std::vector<CBigNum> > mapPubcoins;
+    for (auto& denom : zerocoinDenomList)
+        mapPubcoins[denom] = RandomPubcoinValues(CHECKPOINT_COINS_PER_DENOM);
+    return mapPubcoins;
+}
+
+//one denomination after the other, the way a checkpoint was calculated before the denominations ran in parallel
+static void ZerocoinCheckpointCalculationSequential(benchmark::State& state)
+{
+    std::map<CoinDenomination, std::vector<CBigNum> > mapPubcoins = CheckpointPubcoins();
+    AccumulatorMap mapAccumulators;
+    while (state.KeepRunning()) {
+        for (auto& denomPubcoins : mapPubcoins) {
+            for (const CBigNum& bnValue : denomPubcoins.second)
+                mapAccumulators.Accumulate(PublicCoin(Params().Zerocoin_Params(), bnValue, denomPubcoins.first), true);
+        }
+        mapAccumulators.GetCheckpoint();
+    }
+}
+
+static void ZerocoinCheckpointCalculation(benchmark::State& state)
+{
+    std::map<CoinDenomination, std::vector<CBigNum> > mapPubcoins = CheckpointPubcoins();
+    AccumulatorMap mapAccumulators;
+    while (state.KeepRunning()) {
+        mapAccumulators.AccumulateDenominations(mapPubcoins);
+        mapAccumulators.GetCheckpoint();
+    }
+}
+
+BENCHMARK(ZerocoinMint);
+BENCHMARK(ZerocoinPubcoinValidate);
+BENCHMARK(ZerocoinSpendCreate);
+BENCHMARK(ZerocoinSpendVerify);
+BENCHMARK_N(ZerocoinAccumulatorGrowth, ACCUMULATOR_GROWTH_COINS);
+BENCHMARK(ZerocoinWitnessUpdate);
+BENCHMARK(ZerocoinCheckpointCalculationSequential);
+BENCHMARK(ZerocoinCheckpointCalculation);
@@ -122,6 +122,7 @@ public:
         /** Height or Time Based Activations **/
         nLastPOWBlock = 2000;
         nModifierUpdateBlock = 999999999;
+        nStakeKernelChainBlock = 999999999; //Check stake kernels on the chain of their block starting this block
         nZerocoinStartHeight = 90000;
         nAccumulatorStartHeight = 1;
         nBlockEnforceSerialRange = 90003; //Enforce serial range starting this block
@@ -197,7 +198,7 @@ public:
         fMineBlocksOnDemand = false;
         fSkipProofOfWorkCheck = false;
         fTestnetToBeDeprecatedFieldRPC = false;
-        fHeadersFirstSyncingActive = false;
+        fHeadersFirstSyncingActive = true;
 
         nPoolMaxTransactions = 3;
         strSporkKey = "04c03a20082e774c6c93da0251e00ed00e73b28d2f3bbb692b7ab7ec64a8a7b9374c16afa15b6d7355fc482b5aa6b8fc7ec4d0fb71fcc21bdd9b07bf06a7c9d611";
@@ -248,6 +249,7 @@ public:
         nMaturity = 2;
         nMasternodeCountDrift = 4;
         nModifierUpdateBlock = 51197; //approx Mon, 17 Apr 2017 04:00:00 GMT
+        nStakeKernelChainBlock = 999999999; //Check stake kernels on the chain of their block starting this block
         nMaxMoneyOut = 39999999999 * COIN;
         nZerocoinStartHeight = 3;
         nBlockEnforceSerialRange = 1; //Enforce serial range starting this block
@@ -349,6 +351,7 @@ public:
         nRejectBlockOutdatedMajority = 950;
         nToCheckBlockUpgradeMajority = 1000;
         nMinerThreads = 1;
+        nStakeKernelChainBlock = 0; //Check stake kernels on the chain of their block from the start
         nTargetTimespan = 24 * 60 * 60; // Loonie: 1 day
         nTargetSpacing = 1 * 60;        // Loonie: 1 minutes
         bnProofOfWorkLimit = ~uint256(0) >> 1;
@@ -0,0 +1,85 @@
+// Copyright (c) 2026 The Loonie developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#if defined(HAVE_CONFIG_H)
+#include "config/loonie-config.h"
+#endif
+
+#include "crypto/xevan.h"
+
+#include <string.h>
+
+// The portable kernel, one lane wide, is always available.
+#define XEVAN_LANES 1
+#define XEVAN_LANES_NAMESPACE xevan_scalar
+#include "crypto/xevan_lanes.h"
+#undef XEVAN_LANES
+#undef XEVAN_LANES_NAMESPACE
+
+// The wider kernel lives in its own translation unit, built with the -m flags they need.
+#if defined(ENABLE_AVX2)
+namespace xevan_avx2
+{
+void Hash(unsigned char* const* ppOutput, const unsigned char* const* ppInput, size_t nLen);
+}
+#endif
+
+namespace
+{
+typedef void (*XevanKernel)(unsigned char* const* ppOutput, const unsigned char* const* ppInput, size_t nLen);
+
+struct XevanImpl {
+    XevanKernel kernel;
+    int nLanes;
+};
+
+XevanImpl SelectXevanImpl()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+#if defined(ENABLE_AVX2)
+    if (__builtin_cpu_supports("avx2")) {
+        XevanImpl impl = {xevan_avx2::Hash, 4};
+        return impl;
+    }
+#endif
+#endif
+    XevanImpl impl = {xevan_scalar::Hash, 1};
+    return impl;
+}
+
+const XevanImpl& GetXevanImpl()
+{
+    static const XevanImpl impl = SelectXevanImpl();
+    return impl;
+}
+} // namespace
+
+int XevanLanes()
+{
+    return GetXevanImpl().nLanes;
+}
+
+void XevanMulti(unsigned char* const* ppOutput, const unsigned char* const* ppInput, size_t nLen, size_t nCount)
+{
+    const XevanImpl& impl = GetXevanImpl();
+    const size_t nLanes = impl.nLanes;
+
+    for (size_t i = 0; i < nCount; i += nLanes) {
+        const unsigned char* ppIn[XEVAN_MAX_LANES];
+        unsigned char* ppOut[XEVAN_MAX_LANES];
+        unsigned char vchSpare[XEVAN_MAX_LANES][32];
+        // a short final batch fills its idle lanes with the last input and drops their results
+        for (size_t l = 0; l < nLanes; l++) {
+            if (i + l < nCount) {
+                ppIn[l] = ppInput[i + l];
+                ppOut[l] = ppOutput[i + l];
+            } else {
+                ppIn[l] = ppInput[nCount - 1];
+                ppOut[l] = vchSpare[l];
+            }
+        }
+        impl.kernel(ppOut, ppIn, nLen);
+    }
+}
@@ -0,0 +1,24 @@
+// Copyright (c) 2026 The Loonie developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CRYPTO_XEVAN_H
+#define BITCOIN_CRYPTO_XEVAN_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/** The widest lane count any of the XEVAN kernels hashes at once. */
+static const int XEVAN_MAX_LANES = 4;
+
+/** Number of inputs the kernel selected for this CPU hashes side by side (4 with AVX2, else 1). */
+int XevanLanes();
+
+/**
+ * Compute the 32 byte XEVAN hash of nCount inputs that are all nLen bytes long,
+ * writing the result for ppInput[i] to ppOutput[i]. Batches of XevanLanes() inputs
+ * share one pass through the vector kernel; the result equals XEVAN() in hash.h.
+ */
+void XevanMulti(unsigned char* const* ppOutput, const unsigned char* const* ppInput, size_t nLen, size_t nCount);
+
+#endif // BITCOIN_CRYPTO_XEVAN_H
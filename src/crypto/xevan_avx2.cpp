@@ -0,0 +1,8 @@
+// Copyright (c) 2026 The Loonie developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// Built with -mavx -mavx2: four lanes fill a 256-bit register.
+#define XEVAN_LANES 4
+#define XEVAN_LANES_NAMESPACE xevan_avx2
+#include "crypto/xevan_lanes.h"
@@ -0,0 +1,826 @@
+// Copyright (c) 2026 The Loonie developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/*
+ * Lane-parallel XEVAN, hashing XEVAN_LANES equal length inputs side by side.
+ *
+ * This file is compiled once per instruction set: the including translation
+ * unit defines XEVAN_LANES and XEVAN_LANES_NAMESPACE and is built with the
+ * matching -m flags, so the GCC vector types below map onto AVX2
+ * registers (one 64-bit word of every lane per register). The ARX stages
+ * (blake, bmw, skein, keccak, cubehash, sha512) run vectorized; the table
+ * driven ones call the sph implementation once per lane.
+ *
+ * Everything except the entry point has internal linkage, so the copies built
+ * with different flags never get merged by the linker.
+ */
+
+#ifndef XEVAN_LANES
+#error "XEVAN_LANES must be defined before including xevan_lanes.h"
+#endif
+
+#include "crypto/common.h"
+#include "crypto/sph_blake.h"
+#include "crypto/sph_bmw.h"
+#include "crypto/sph_cubehash.h"
+#include "crypto/sph_echo.h"
+#include "crypto/sph_fugue.h"
+#include "crypto/sph_groestl.h"
+#include "crypto/sph_hamsi.h"
+#include "crypto/sph_haval.h"
+#include "crypto/sph_jh.h"
+#include "crypto/sph_keccak.h"
+#include "crypto/sph_luffa.h"
+#include "crypto/sph_sha2.h"
+#include "crypto/sph_shabal.h"
+#include "crypto/sph_shavite.h"
+#include "crypto/sph_simd.h"
+#include "crypto/sph_skein.h"
+#include "crypto/sph_whirlpool.h"
+
+#include <stdint.h>
+#include <string.h>
+
+namespace
+{
+/// Internal lane-parallel XEVAN implementation.
+namespace xevan_lanes
+{
+typedef uint64_t v64 __attribute__((vector_size(8 * XEVAN_LANES)));
+typedef uint32_t v32 __attribute__((vector_size(4 * XEVAN_LANES)));
+
+/** Every stage after the first hashes the previous 64-byte result followed by 64 zero bytes. */
+static const size_t STAGE_SIZE = 128;
+typedef unsigned char LaneBuffer[STAGE_SIZE];
+
+v64 inline Splat64(uint64_t x)
+{
+    v64 r;
+    for (int l = 0; l < XEVAN_LANES; l++)
+        r[l] = x;
+    return r;
+}
+
+v32 inline Splat32(uint32_t x)
+{
+    v32 r;
+    for (int l = 0; l < XEVAN_LANES; l++)
+        r[l] = x;
+    return r;
+}
+
+v64 inline Rotl64(v64 x, int n) { return n == 0 ? x : (x << n) | (x >> (64 - n)); }
+v64 inline Rotr64(v64 x, int n) { return n == 0 ? x : (x >> n) | (x << (64 - n)); }
+v32 inline Rotl32(v32 x, int n) { return (x << n) | (x >> (32 - n)); }
+
+v64 inline LoadLE64(const unsigned char* const* ppIn, size_t nOffset)
+{
+    v64 r;
+    for (int l = 0; l < XEVAN_LANES; l++)
+        r[l] = ReadLE64(ppIn[l] + nOffset);
+    return r;
+}
+
+v64 inline LoadBE64(const unsigned char* const* ppIn, size_t nOffset)
+{
+    v64 r;
+    for (int l = 0; l < XEVAN_LANES; l++)
+        r[l] = ReadBE64(ppIn[l] + nOffset);
+    return r;
+}
+
+v32 inline LoadLE32(const unsigned char* const* ppIn, size_t nOffset)
+{
+    v32 r;
+    for (int l = 0; l < XEVAN_LANES; l++)
+        r[l] = ReadLE32(ppIn[l] + nOffset);
+    return r;
+}
+
+void inline StoreLE64(LaneBuffer* pOut, size_t nOffset, v64 x)
+{
+    for (int l = 0; l < XEVAN_LANES; l++)
+        WriteLE64(pOut[l] + nOffset, x[l]);
+}
+
+void inline StoreBE64(LaneBuffer* pOut, size_t nOffset, v64 x)
+{
+    for (int l = 0; l < XEVAN_LANES; l++)
+        WriteBE64(pOut[l] + nOffset, x[l]);
+}
+
+void inline StoreLE32(LaneBuffer* pOut, size_t nOffset, v32 x)
+{
+    for (int l = 0; l < XEVAN_LANES; l++)
+        WriteLE32(pOut[l] + nOffset, x[l]);
+}
+
+/** Pointers to the lanes of a stage buffer, for the loaders above. */
+void inline LanePointers(const unsigned char** ppIn, const LaneBuffer* pBuf)
+{
+    for (int l = 0; l < XEVAN_LANES; l++)
+        ppIn[l] = pBuf[l];
+}
+
+/// BLAKE-512, any (common) input length.
+namespace blake
+{
+static const uint64_t C[16] = {
+    0x243F6A8885A308D3ull, 0x13198A2E03707344ull, 0xA4093822299F31D0ull, 0x082EFA98EC4E6C89ull,
+    0x452821E638D01377ull, 0xBE5466CF34E90C6Cull, 0xC0AC29B7C97C50DDull, 0x3F84D5B5B5470917ull,
+    0x9216D5D98979FB1Bull, 0xD1310BA698DFB5ACull, 0x2FFD72DBD01ADFB7ull, 0xB8E1AFED6A267E96ull,
+    0xBA7C9045F12C7F99ull, 0x24A19947B3916CF7ull, 0x0801F2E2858EFC16ull, 0x636920D871574E69ull};
+
+static const uint8_t SIGMA[10][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3},
+    {11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4},
+    {7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8},
+    {9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13},
+    {2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9},
+    {12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11},
+    {13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10},
+    {6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5},
+    {10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0}};
+
+void inline G(v64* v, int a, int b, int c, int d, const v64* m, const uint8_t* s, int i)
+{
+    v[a] += v[b] + (m[s[i]] ^ Splat64(C[s[i + 1]]));
+    v[d] = Rotr64(v[d] ^ v[a], 32);
+    v[c] += v[d];
+    v[b] = Rotr64(v[b] ^ v[c], 25);
+    v[a] += v[b] + (m[s[i + 1]] ^ Splat64(C[s[i]]));
+    v[d] = Rotr64(v[d] ^ v[a], 16);
+    v[c] += v[d];
+    v[b] = Rotr64(v[b] ^ v[c], 11);
+}
+
+/** Compress one block; nCounter is the message bit count up to the end of the block (0 for a padding-only block). */
+void Compress(v64* h, const v64* m, uint64_t nCounter)
+{
+    v64 v[16];
+    for (int i = 0; i < 8; i++)
+        v[i] = h[i];
+    for (int i = 0; i < 4; i++)
+        v[8 + i] = Splat64(C[i]);
+    v[12] = Splat64(nCounter ^ C[4]);
+    v[13] = Splat64(nCounter ^ C[5]);
+    v[14] = Splat64(C[6]);
+    v[15] = Splat64(C[7]);
+    for (int r = 0; r < 16; r++) {
+        const uint8_t* s = SIGMA[r % 10];
+        G(v, 0, 4, 8, 12, m, s, 0);
+        G(v, 1, 5, 9, 13, m, s, 2);
+        G(v, 2, 6, 10, 14, m, s, 4);
+        G(v, 3, 7, 11, 15, m, s, 6);
+        G(v, 0, 5, 10, 15, m, s, 8);
+        G(v, 1, 6, 11, 12, m, s, 10);
+        G(v, 2, 7, 8, 13, m, s, 12);
+        G(v, 3, 4, 9, 14, m, s, 14);
+    }
+    for (int i = 0; i < 8; i++)
+        h[i] ^= v[i] ^ v[i + 8];
+}
+
+void CompressBuffer(v64* h, const LaneBuffer* pBlock, uint64_t nCounter)
+{
+    const unsigned char* ppIn[XEVAN_LANES];
+    LanePointers(ppIn, pBlock);
+    v64 m[16];
+    for (int i = 0; i < 16; i++)
+        m[i] = LoadBE64(ppIn, 8 * i);
+    Compress(h, m, nCounter);
+}
+
+void Hash512(LaneBuffer* pOut, const unsigned char* const* ppIn, size_t nLen)
+{
+    static const uint64_t IV[8] = {
+        0x6A09E667F3BCC908ull, 0xBB67AE8584CAA73Bull, 0x3C6EF372FE94F82Bull, 0xA54FF53A5F1D36F1ull,
+        0x510E527FADE682D1ull, 0x9B05688C2B3E6C1Full, 0x1F83D9ABFB41BD6Bull, 0x5BE0CD19137E2179ull};
+    v64 h[8];
+    for (int i = 0; i < 8; i++)
+        h[i] = Splat64(IV[i]);
+
+    const uint64_t nBits = (uint64_t)nLen << 3;
+    size_t nOffset = 0;
+    v64 m[16];
+    for (; nLen - nOffset >= 128; nOffset += 128) {
+        for (int i = 0; i < 16; i++)
+            m[i] = LoadBE64(ppIn, nOffset + 8 * i);
+        Compress(h, m, (uint64_t)(nOffset + 128) << 3);
+    }
+
+    // the tail and the padding are laid out per lane and then compressed like any other block
+    size_t nRemaining = nLen - nOffset;
+    LaneBuffer block[XEVAN_LANES];
+    for (int l = 0; l < XEVAN_LANES; l++) {
+        memset(block[l], 0, STAGE_SIZE);
+        memcpy(block[l], ppIn[l] + nOffset, nRemaining);
+        block[l][nRemaining] = 0x80;
+    }
+    if (nRemaining >= 112) {
+        CompressBuffer(h, block, nBits);
+        for (int l = 0; l < XEVAN_LANES; l++)
+            memset(block[l], 0, STAGE_SIZE);
+        nRemaining = 0;
+    }
+    for (int l = 0; l < XEVAN_LANES; l++) {
+        block[l][111] |= 1;
+        WriteBE64(block[l] + 120, nBits);
+    }
+    CompressBuffer(h, block, nRemaining ? nBits : 0);
+
+    for (int i = 0; i < 8; i++)
+        StoreBE64(pOut, 8 * i, h[i]);
+}
+} // namespace blake
+
+/// Blue Midnight Wish 512, 128-byte input.
+namespace bmw
+{
+v64 inline s0(v64 x) { return (x >> 1) ^ (x << 3) ^ Rotl64(x, 4) ^ Rotl64(x, 37); }
+v64 inline s1(v64 x) { return (x >> 1) ^ (x << 2) ^ Rotl64(x, 13) ^ Rotl64(x, 43); }
+v64 inline s2(v64 x) { return (x >> 2) ^ (x << 1) ^ Rotl64(x, 19) ^ Rotl64(x, 53); }
+v64 inline s3(v64 x) { return (x >> 2) ^ (x << 2) ^ Rotl64(x, 28) ^ Rotl64(x, 59); }
+v64 inline s4(v64 x) { return (x >> 1) ^ x; }
+v64 inline s5(v64 x) { return (x >> 2) ^ x; }
+
+v64 inline AddElement(const v64* m, const v64* h, int j)
+{
+    const int j0 = j & 15, j3 = (j + 3) & 15, j10 = (j + 10) & 15;
+    return (Rotl64(m[j0], j0 + 1) + Rotl64(m[j3], j3 + 1) - Rotl64(m[j10], j10 + 1) +
+            Splat64((uint64_t)(j + 16) * 0x0555555555555555ull)) ^ h[(j + 7) & 15];
+}
+
+void Compress(const v64* m, const v64* h, v64* dh)
+{
+    v64 w[16], q[32];
+#define X(i) (m[i] ^ h[i])
+    w[0] = X(5) - X(7) + X(10) + X(13) + X(14);
+    w[1] = X(6) - X(8) + X(11) + X(14) - X(15);
+    w[2] = X(0) + X(7) + X(9) - X(12) + X(15);
+    w[3] = X(0) - X(1) + X(8) - X(10) + X(13);
+    w[4] = X(1) + X(2) + X(9) - X(11) - X(14);
+    w[5] = X(3) - X(2) + X(10) - X(12) + X(15);
+    w[6] = X(4) - X(0) - X(3) - X(11) + X(13);
+    w[7] = X(1) - X(4) - X(5) - X(12) - X(14);
+    w[8] = X(2) - X(5) - X(6) + X(13) - X(15);
+    w[9] = X(0) - X(3) + X(6) - X(7) + X(14);
+    w[10] = X(8) - X(1) - X(4) - X(7) + X(15);
+    w[11] = X(8) - X(0) - X(2) - X(5) + X(9);
+    w[12] = X(1) + X(3) - X(6) - X(9) + X(10);
+    w[13] = X(2) + X(4) + X(7) + X(10) + X(11);
+    w[14] = X(3) - X(5) + X(8) - X(11) - X(12);
+    w[15] = X(12) - X(4) - X(6) - X(9) + X(13);
+#undef X
+
+    for (int i = 0; i < 15; i += 5) {
+        q[i + 0] = s0(w[i + 0]) + h[i + 1];
+        q[i + 1] = s1(w[i + 1]) + h[i + 2];
+        q[i + 2] = s2(w[i + 2]) + h[i + 3];
+        q[i + 3] = s3(w[i + 3]) + h[i + 4];
+        q[i + 4] = s4(w[i + 4]) + h[i + 5];
+    }
+    q[15] = s0(w[15]) + h[0];
+
+    for (int i = 16; i < 18; i++) {
+        v64 sum = AddElement(m, h, i - 16);
+        for (int k = 0; k < 16; k += 4)
+            sum += s1(q[i - 16 + k]) + s2(q[i - 15 + k]) + s3(q[i - 14 + k]) + s0(q[i - 13 + k]);
+        q[i] = sum;
+    }
+    for (int i = 18; i < 32; i++) {
+        q[i] = q[i - 16] + Rotl64(q[i - 15], 5) + q[i - 14] + Rotl64(q[i - 13], 11) +
+               q[i - 12] + Rotl64(q[i - 11], 27) + q[i - 10] + Rotl64(q[i - 9], 32) +
+               q[i - 8] + Rotl64(q[i - 7], 37) + q[i - 6] + Rotl64(q[i - 5], 43) +
+               q[i - 4] + Rotl64(q[i - 3], 53) + s4(q[i - 2]) + s5(q[i - 1]) +
+               AddElement(m, h, i - 16);
+    }
+
+    v64 xl = q[16] ^ q[17] ^ q[18] ^ q[19] ^ q[20] ^ q[21] ^ q[22] ^ q[23];
+    v64 xh = xl ^ q[24] ^ q[25] ^ q[26] ^ q[27] ^ q[28] ^ q[29] ^ q[30] ^ q[31];
+    dh[0] = ((xh << 5) ^ (q[16] >> 5) ^ m[0]) + (xl ^ q[24] ^ q[0]);
+    dh[1] = ((xh >> 7) ^ (q[17] << 8) ^ m[1]) + (xl ^ q[25] ^ q[1]);
+    dh[2] = ((xh >> 5) ^ (q[18] << 5) ^ m[2]) + (xl ^ q[26] ^ q[2]);
+    dh[3] = ((xh >> 1) ^ (q[19] << 5) ^ m[3]) + (xl ^ q[27] ^ q[3]);
+    dh[4] = ((xh >> 3) ^ q[20] ^ m[4]) + (xl ^ q[28] ^ q[4]);
+    dh[5] = ((xh << 6) ^ (q[21] >> 6) ^ m[5]) + (xl ^ q[29] ^ q[5]);
+    dh[6] = ((xh >> 4) ^ (q[22] << 6) ^ m[6]) + (xl ^ q[30] ^ q[6]);
+    dh[7] = ((xh >> 11) ^ (q[23] << 2) ^ m[7]) + (xl ^ q[31] ^ q[7]);
+    dh[8] = Rotl64(dh[4], 9) + (xh ^ q[24] ^ m[8]) + ((xl << 8) ^ q[23] ^ q[8]);
+    dh[9] = Rotl64(dh[5], 10) + (xh ^ q[25] ^ m[9]) + ((xl >> 6) ^ q[16] ^ q[9]);
+    dh[10] = Rotl64(dh[6], 11) + (xh ^ q[26] ^ m[10]) + ((xl << 6) ^ q[17] ^ q[10]);
+    dh[11] = Rotl64(dh[7], 12) + (xh ^ q[27] ^ m[11]) + ((xl << 4) ^ q[18] ^ q[11]);
+    dh[12] = Rotl64(dh[0], 13) + (xh ^ q[28] ^ m[12]) + ((xl >> 3) ^ q[19] ^ q[12]);
+    dh[13] = Rotl64(dh[1], 14) + (xh ^ q[29] ^ m[13]) + ((xl >> 4) ^ q[20] ^ q[13]);
+    dh[14] = Rotl64(dh[2], 15) + (xh ^ q[30] ^ m[14]) + ((xl >> 7) ^ q[21] ^ q[14]);
+    dh[15] = Rotl64(dh[3], 16) + (xh ^ q[31] ^ m[15]) + ((xl >> 2) ^ q[22] ^ q[15]);
+}
+
+void Hash512(LaneBuffer* pBuf)
+{
+    v64 h[16], m[16], h2[16];
+    for (int i = 0; i < 16; i++)
+        h[i] = Splat64(0x8081828384858687ull + 0x0808080808080808ull * i);
+
+    const unsigned char* ppIn[XEVAN_LANES];
+    LanePointers(ppIn, pBuf);
+    for (int i = 0; i < 16; i++)
+        m[i] = LoadLE64(ppIn, 8 * i);
+    Compress(m, h, h2);
+
+    // padding block: the 0x80 marker followed by the bit length in the last word
+    for (int i = 0; i < 16; i++)
+        m[i] = Splat64(0);
+    m[0] = Splat64(0x80);
+    m[15] = Splat64(STAGE_SIZE << 3);
+    Compress(m, h2, h);
+
+    // final compression of the chaining value under the constant key
+    for (int i = 0; i < 16; i++)
+        h2[i] = Splat64(0xaaaaaaaaaaaaaaa0ull + i);
+    Compress(h, h2, m);
+    for (int i = 0; i < 8; i++)
+        StoreLE64(pBuf, 8 * i, m[8 + i]);
+}
+} // namespace bmw
+
+/// Skein-512-512, 128-byte input.
+namespace skein
+{
+void inline Mix(v64& x0, v64& x1, int rc)
+{
+    x0 += x1;
+    x1 = Rotl64(x1, rc) ^ x0;
+}
+
+void inline Mix8(v64* p, int a0, int a1, int b0, int b1, int c0, int c1, int d0, int d1, int rc0, int rc1, int rc2, int rc3)
+{
+    Mix(p[a0], p[a1], rc0);
+    Mix(p[b0], p[b1], rc1);
+    Mix(p[c0], p[c1], rc2);
+    Mix(p[d0], p[d1], rc3);
+}
+
+/** Eight Threefish-512 rounds: the subkey injections S and S + 1 with four mixing rounds after each. */
+template <int S>
+void inline Rounds8(v64* p, const v64* k, const v64* t)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] += k[(S + i) % 9];
+    p[5] += t[S % 3];
+    p[6] += t[(S + 1) % 3];
+    p[7] += Splat64(S);
+    Mix8(p, 0, 1, 2, 3, 4, 5, 6, 7, 46, 36, 19, 37);
+    Mix8(p, 2, 1, 4, 7, 6, 5, 0, 3, 33, 27, 14, 42);
+    Mix8(p, 4, 1, 6, 3, 0, 5, 2, 7, 17, 49, 36, 39);
+    Mix8(p, 6, 1, 0, 7, 2, 5, 4, 3, 44, 9, 54, 56);
+
+    for (int i = 0; i < 8; i++)
+        p[i] += k[(S + 1 + i) % 9];
+    p[5] += t[(S + 1) % 3];
+    p[6] += t[(S + 2) % 3];
+    p[7] += Splat64(S + 1);
+    Mix8(p, 0, 1, 2, 3, 4, 5, 6, 7, 39, 30, 34, 24);
+    Mix8(p, 2, 1, 4, 7, 6, 5, 0, 3, 13, 50, 10, 17);
+    Mix8(p, 4, 1, 6, 3, 0, 5, 2, 7, 25, 29, 39, 43);
+    Mix8(p, 6, 1, 0, 7, 2, 5, 4, 3, 8, 35, 56, 22);
+}
+
+/** One UBI compression with Threefish-512. */
+void Ubi(v64* h, const v64* m, uint64_t t0, uint64_t t1)
+{
+    const v64 t[3] = {Splat64(t0), Splat64(t1), Splat64(t0 ^ t1)};
+
+    v64 k[9], p[8];
+    k[8] = Splat64(0x1BD11BDAA9FC1A22ull);
+    for (int i = 0; i < 8; i++) {
+        k[i] = h[i];
+        k[8] ^= h[i];
+        p[i] = m[i];
+    }
+
+    Rounds8<0>(p, k, t);
+    Rounds8<2>(p, k, t);
+    Rounds8<4>(p, k, t);
+    Rounds8<6>(p, k, t);
+    Rounds8<8>(p, k, t);
+    Rounds8<10>(p, k, t);
+    Rounds8<12>(p, k, t);
+    Rounds8<14>(p, k, t);
+    Rounds8<16>(p, k, t);
+    for (int i = 0; i < 8; i++)
+        p[i] += k[(18 + i) % 9];
+    p[5] += t[0];
+    p[6] += t[1];
+    p[7] += Splat64(18);
+
+    for (int i = 0; i < 8; i++)
+        h[i] = m[i] ^ p[i];
+}
+
+void Hash512(LaneBuffer* pBuf)
+{
+    static const uint64_t IV[8] = {
+        0x4903ADFF749C51CEull, 0x0D95DE399746DF03ull, 0x8FD1934127C79BCEull, 0x9A255629FF352CB1ull,
+        0x5DB62599DF6CA7B0ull, 0xEABE394CA9D5C3F4ull, 0x991112C71A75B523ull, 0xAE18A40B660FCC33ull};
+    // tweak high words: first message block, final message block, final output block
+    static const uint64_t T1_MSG_FIRST = 224ull << 55;
+    static const uint64_t T1_MSG_FINAL = 352ull << 55;
+    static const uint64_t T1_OUT_FINAL = 510ull << 55;
+
+    v64 h[8], m[8];
+    for (int i = 0; i < 8; i++)
+        h[i] = Splat64(IV[i]);
+
+    const unsigned char* ppIn[XEVAN_LANES];
+    LanePointers(ppIn, pBuf);
+    for (int i = 0; i < 8; i++)
+        m[i] = LoadLE64(ppIn, 8 * i);
+    Ubi(h, m, 64, T1_MSG_FIRST);
+    for (int i = 0; i < 8; i++)
+        m[i] = LoadLE64(ppIn, 64 + 8 * i);
+    Ubi(h, m, 128, T1_MSG_FINAL);
+
+    for (int i = 0; i < 8; i++)
+        m[i] = Splat64(0);
+    Ubi(h, m, 8, T1_OUT_FINAL);
+    for (int i = 0; i < 8; i++)
+        StoreLE64(pBuf, 8 * i, h[i]);
+}
+} // namespace skein
+
+/// Keccak-512 (original submission padding, as in sph), 128-byte input.
+namespace keccak
+{
+static const uint64_t RC[24] = {
+    0x0000000000000001ull, 0x0000000000008082ull, 0x800000000000808Aull, 0x8000000080008000ull,
+    0x000000000000808Bull, 0x0000000080000001ull, 0x8000000080008081ull, 0x8000000000008009ull,
+    0x000000000000008Aull, 0x0000000000000088ull, 0x0000000080008009ull, 0x000000008000000Aull,
+    0x000000008000808Bull, 0x800000000000008Bull, 0x8000000000008089ull, 0x8000000000008003ull,
+    0x8000000000008002ull, 0x8000000000000080ull, 0x000000000000800Aull, 0x800000008000000Aull,
+    0x8000000080008081ull, 0x8000000000008080ull, 0x0000000080000001ull, 0x8000000080008008ull};
+
+void inline Round(v64* a, uint64_t rc)
+{
+    const v64 c0 = a[0] ^ a[5] ^ a[10] ^ a[15] ^ a[20];
+    const v64 c1 = a[1] ^ a[6] ^ a[11] ^ a[16] ^ a[21];
+    const v64 c2 = a[2] ^ a[7] ^ a[12] ^ a[17] ^ a[22];
+    const v64 c3 = a[3] ^ a[8] ^ a[13] ^ a[18] ^ a[23];
+    const v64 c4 = a[4] ^ a[9] ^ a[14] ^ a[19] ^ a[24];
+    const v64 d0 = c4 ^ Rotl64(c1, 1);
+    const v64 d1 = c0 ^ Rotl64(c2, 1);
+    const v64 d2 = c1 ^ Rotl64(c3, 1);
+    const v64 d3 = c2 ^ Rotl64(c4, 1);
+    const v64 d4 = c3 ^ Rotl64(c0, 1);
+
+    // theta, rho and pi: b[y + 5 * ((2x + 3y) % 5)] = rot(a[x + 5y] ^ d[x])
+    v64 b[25];
+    b[0] = Rotl64(a[0] ^ d0, 0);
+    b[10] = Rotl64(a[1] ^ d1, 1);
+    b[20] = Rotl64(a[2] ^ d2, 62);
+    b[5] = Rotl64(a[3] ^ d3, 28);
+    b[15] = Rotl64(a[4] ^ d4, 27);
+    b[16] = Rotl64(a[5] ^ d0, 36);
+    b[1] = Rotl64(a[6] ^ d1, 44);
+    b[11] = Rotl64(a[7] ^ d2, 6);
+    b[21] = Rotl64(a[8] ^ d3, 55);
+    b[6] = Rotl64(a[9] ^ d4, 20);
+    b[7] = Rotl64(a[10] ^ d0, 3);
+    b[17] = Rotl64(a[11] ^ d1, 10);
+    b[2] = Rotl64(a[12] ^ d2, 43);
+    b[12] = Rotl64(a[13] ^ d3, 25);
+    b[22] = Rotl64(a[14] ^ d4, 39);
+    b[23] = Rotl64(a[15] ^ d0, 41);
+    b[8] = Rotl64(a[16] ^ d1, 45);
+    b[18] = Rotl64(a[17] ^ d2, 15);
+    b[3] = Rotl64(a[18] ^ d3, 21);
+    b[13] = Rotl64(a[19] ^ d4, 8);
+    b[14] = Rotl64(a[20] ^ d0, 18);
+    b[24] = Rotl64(a[21] ^ d1, 2);
+    b[9] = Rotl64(a[22] ^ d2, 61);
+    b[19] = Rotl64(a[23] ^ d3, 56);
+    b[4] = Rotl64(a[24] ^ d4, 14);
+
+    // chi and iota
+    a[0] = b[0] ^ (~b[1] & b[2]);
+    a[1] = b[1] ^ (~b[2] & b[3]);
+    a[2] = b[2] ^ (~b[3] & b[4]);
+    a[3] = b[3] ^ (~b[4] & b[0]);
+    a[4] = b[4] ^ (~b[0] & b[1]);
+    a[5] = b[5] ^ (~b[6] & b[7]);
+    a[6] = b[6] ^ (~b[7] & b[8]);
+    a[7] = b[7] ^ (~b[8] & b[9]);
+    a[8] = b[8] ^ (~b[9] & b[5]);
+    a[9] = b[9] ^ (~b[5] & b[6]);
+    a[10] = b[10] ^ (~b[11] & b[12]);
+    a[11] = b[11] ^ (~b[12] & b[13]);
+    a[12] = b[12] ^ (~b[13] & b[14]);
+    a[13] = b[13] ^ (~b[14] & b[10]);
+    a[14] = b[14] ^ (~b[10] & b[11]);
+    a[15] = b[15] ^ (~b[16] & b[17]);
+    a[16] = b[16] ^ (~b[17] & b[18]);
+    a[17] = b[17] ^ (~b[18] & b[19]);
+    a[18] = b[18] ^ (~b[19] & b[15]);
+    a[19] = b[19] ^ (~b[15] & b[16]);
+    a[20] = b[20] ^ (~b[21] & b[22]);
+    a[21] = b[21] ^ (~b[22] & b[23]);
+    a[22] = b[22] ^ (~b[23] & b[24]);
+    a[23] = b[23] ^ (~b[24] & b[20]);
+    a[24] = b[24] ^ (~b[20] & b[21]);
+    a[0] ^= Splat64(rc);
+}
+
+void inline Permute(v64* a)
+{
+    for (int r = 0; r < 24; r++)
+        Round(a, RC[r]);
+}
+
+void Hash512(LaneBuffer* pBuf)
+{
+    // 72-byte rate: one full block, then the last 56 bytes with the padding
+    v64 a[25];
+    for (int i = 0; i < 25; i++)
+        a[i] = Splat64(0);
+
+    const unsigned char* ppIn[XEVAN_LANES];
+    LanePointers(ppIn, pBuf);
+    for (int i = 0; i < 9; i++)
+        a[i] ^= LoadLE64(ppIn, 8 * i);
+    Permute(a);
+    for (int i = 0; i < 7; i++)
+        a[i] ^= LoadLE64(ppIn, 72 + 8 * i);
+    a[7] ^= Splat64(0x01);
+    a[8] ^= Splat64(0x8000000000000000ull);
+    Permute(a);
+
+    for (int i = 0; i < 8; i++)
+        StoreLE64(pBuf, 8 * i, a[i]);
+}
+} // namespace keccak
+
+/// CubeHash16/32-512, 128-byte input.
+namespace cubehash
+{
+/** Two CubeHash rounds; the word swaps of each round are folded into the indexing, which is the identity again after two. */
+void inline DoubleRound(v32* x)
+{
+    x[16] += x[0]; x[0] = Rotl32(x[0], 7);
+    x[17] += x[1]; x[1] = Rotl32(x[1], 7);
+    x[18] += x[2]; x[2] = Rotl32(x[2], 7);
+    x[19] += x[3]; x[3] = Rotl32(x[3], 7);
+    x[20] += x[4]; x[4] = Rotl32(x[4], 7);
+    x[21] += x[5]; x[5] = Rotl32(x[5], 7);
+    x[22] += x[6]; x[6] = Rotl32(x[6], 7);
+    x[23] += x[7]; x[7] = Rotl32(x[7], 7);
+    x[24] += x[8]; x[8] = Rotl32(x[8], 7);
+    x[25] += x[9]; x[9] = Rotl32(x[9], 7);
+    x[26] += x[10]; x[10] = Rotl32(x[10], 7);
+    x[27] += x[11]; x[11] = Rotl32(x[11], 7);
+    x[28] += x[12]; x[12] = Rotl32(x[12], 7);
+    x[29] += x[13]; x[13] = Rotl32(x[13], 7);
+    x[30] += x[14]; x[14] = Rotl32(x[14], 7);
+    x[31] += x[15]; x[15] = Rotl32(x[15], 7);
+    x[8] ^= x[16]; x[9] ^= x[17]; x[10] ^= x[18]; x[11] ^= x[19];
+    x[12] ^= x[20]; x[13] ^= x[21]; x[14] ^= x[22]; x[15] ^= x[23];
+    x[0] ^= x[24]; x[1] ^= x[25]; x[2] ^= x[26]; x[3] ^= x[27];
+    x[4] ^= x[28]; x[5] ^= x[29]; x[6] ^= x[30]; x[7] ^= x[31];
+    x[18] += x[8]; x[8] = Rotl32(x[8], 11);
+    x[19] += x[9]; x[9] = Rotl32(x[9], 11);
+    x[16] += x[10]; x[10] = Rotl32(x[10], 11);
+    x[17] += x[11]; x[11] = Rotl32(x[11], 11);
+    x[22] += x[12]; x[12] = Rotl32(x[12], 11);
+    x[23] += x[13]; x[13] = Rotl32(x[13], 11);
+    x[20] += x[14]; x[14] = Rotl32(x[14], 11);
+    x[21] += x[15]; x[15] = Rotl32(x[15], 11);
+    x[26] += x[0]; x[0] = Rotl32(x[0], 11);
+    x[27] += x[1]; x[1] = Rotl32(x[1], 11);
+    x[24] += x[2]; x[2] = Rotl32(x[2], 11);
+    x[25] += x[3]; x[3] = Rotl32(x[3], 11);
+    x[30] += x[4]; x[4] = Rotl32(x[4], 11);
+    x[31] += x[5]; x[5] = Rotl32(x[5], 11);
+    x[28] += x[6]; x[6] = Rotl32(x[6], 11);
+    x[29] += x[7]; x[7] = Rotl32(x[7], 11);
+    x[12] ^= x[18]; x[13] ^= x[19]; x[14] ^= x[16]; x[15] ^= x[17];
+    x[8] ^= x[22]; x[9] ^= x[23]; x[10] ^= x[20]; x[11] ^= x[21];
+    x[4] ^= x[26]; x[5] ^= x[27]; x[6] ^= x[24]; x[7] ^= x[25];
+    x[0] ^= x[30]; x[1] ^= x[31]; x[2] ^= x[28]; x[3] ^= x[29];
+
+    x[19] += x[12]; x[12] = Rotl32(x[12], 7);
+    x[18] += x[13]; x[13] = Rotl32(x[13], 7);
+    x[17] += x[14]; x[14] = Rotl32(x[14], 7);
+    x[16] += x[15]; x[15] = Rotl32(x[15], 7);
+    x[23] += x[8]; x[8] = Rotl32(x[8], 7);
+    x[22] += x[9]; x[9] = Rotl32(x[9], 7);
+    x[21] += x[10]; x[10] = Rotl32(x[10], 7);
+    x[20] += x[11]; x[11] = Rotl32(x[11], 7);
+    x[27] += x[4]; x[4] = Rotl32(x[4], 7);
+    x[26] += x[5]; x[5] = Rotl32(x[5], 7);
+    x[25] += x[6]; x[6] = Rotl32(x[6], 7);
+    x[24] += x[7]; x[7] = Rotl32(x[7], 7);
+    x[31] += x[0]; x[0] = Rotl32(x[0], 7);
+    x[30] += x[1]; x[1] = Rotl32(x[1], 7);
+    x[29] += x[2]; x[2] = Rotl32(x[2], 7);
+    x[28] += x[3]; x[3] = Rotl32(x[3], 7);
+    x[4] ^= x[19]; x[5] ^= x[18]; x[6] ^= x[17]; x[7] ^= x[16];
+    x[0] ^= x[23]; x[1] ^= x[22]; x[2] ^= x[21]; x[3] ^= x[20];
+    x[12] ^= x[27]; x[13] ^= x[26]; x[14] ^= x[25]; x[15] ^= x[24];
+    x[8] ^= x[31]; x[9] ^= x[30]; x[10] ^= x[29]; x[11] ^= x[28];
+    x[17] += x[4]; x[4] = Rotl32(x[4], 11);
+    x[16] += x[5]; x[5] = Rotl32(x[5], 11);
+    x[19] += x[6]; x[6] = Rotl32(x[6], 11);
+    x[18] += x[7]; x[7] = Rotl32(x[7], 11);
+    x[21] += x[0]; x[0] = Rotl32(x[0], 11);
+    x[20] += x[1]; x[1] = Rotl32(x[1], 11);
+    x[23] += x[2]; x[2] = Rotl32(x[2], 11);
+    x[22] += x[3]; x[3] = Rotl32(x[3], 11);
+    x[25] += x[12]; x[12] = Rotl32(x[12], 11);
+    x[24] += x[13]; x[13] = Rotl32(x[13], 11);
+    x[27] += x[14]; x[14] = Rotl32(x[14], 11);
+    x[26] += x[15]; x[15] = Rotl32(x[15], 11);
+    x[29] += x[8]; x[8] = Rotl32(x[8], 11);
+    x[28] += x[9]; x[9] = Rotl32(x[9], 11);
+    x[31] += x[10]; x[10] = Rotl32(x[10], 11);
+    x[30] += x[11]; x[11] = Rotl32(x[11], 11);
+    x[0] ^= x[17]; x[1] ^= x[16]; x[2] ^= x[19]; x[3] ^= x[18];
+    x[4] ^= x[21]; x[5] ^= x[20]; x[6] ^= x[23]; x[7] ^= x[22];
+    x[8] ^= x[25]; x[9] ^= x[24]; x[10] ^= x[27]; x[11] ^= x[26];
+    x[12] ^= x[29]; x[13] ^= x[28]; x[14] ^= x[31]; x[15] ^= x[30];
+}
+
+void inline Rounds(v32* x, int nRounds)
+{
+    for (int r = 0; r < nRounds; r += 2)
+        DoubleRound(x);
+}
+
+void Hash512(LaneBuffer* pBuf)
+{
+    static const uint32_t IV[32] = {
+        0x2AEA2A61, 0x50F494D4, 0x2D538B8B, 0x4167D83E, 0x3FEE2313, 0xC701CF8C, 0xCC39968E, 0x50AC5695,
+        0x4D42C787, 0xA647A8B3, 0x97CF0BEF, 0x825B4537, 0xEEF864D2, 0xF22090C4, 0xD0E5CD33, 0xA23911AE,
+        0xFCD398D9, 0x148FE485, 0x1B017BEF, 0xB6444532, 0x6A536159, 0x2FF5781C, 0x91FA7934, 0x0DBADEA9,
+        0xD65C8A2B, 0xA5A70E75, 0xB1C62456, 0xBC796576, 0x1921C8F7, 0xE7989AF1, 0x7795D246, 0xD43E3B44};
+
+    v32 x[32];
+    for (int i = 0; i < 32; i++)
+        x[i] = Splat32(IV[i]);
+
+    const unsigned char* ppIn[XEVAN_LANES];
+    LanePointers(ppIn, pBuf);
+    for (size_t nOffset = 0; nOffset < STAGE_SIZE; nOffset += 32) {
+        for (int i = 0; i < 8; i++)
+            x[i] ^= LoadLE32(ppIn, nOffset + 4 * i);
+        Rounds(x, 16);
+    }
+    x[0] ^= Splat32(0x80);
+    Rounds(x, 16);
+    x[31] ^= Splat32(1);
+    Rounds(x, 160);
+
+    for (int i = 0; i < 16; i++)
+        StoreLE32(pBuf, 4 * i, x[i]);
+}
+} // namespace cubehash
+
+/// SHA-512, 128-byte input.
+namespace sha512
+{
+static const uint64_t K[80] = {
+    0x428a2f98d728ae22ull, 0x7137449123ef65cdull, 0xb5c0fbcfec4d3b2full, 0xe9b5dba58189dbbcull,
+    0x3956c25bf348b538ull, 0x59f111f1b605d019ull, 0x923f82a4af194f9bull, 0xab1c5ed5da6d8118ull,
+    0xd807aa98a3030242ull, 0x12835b0145706fbeull, 0x243185be4ee4b28cull, 0x550c7dc3d5ffb4e2ull,
+    0x72be5d74f27b896full, 0x80deb1fe3b1696b1ull, 0x9bdc06a725c71235ull, 0xc19bf174cf692694ull,
+    0xe49b69c19ef14ad2ull, 0xefbe4786384f25e3ull, 0x0fc19dc68b8cd5b5ull, 0x240ca1cc77ac9c65ull,
+    0x2de92c6f592b0275ull, 0x4a7484aa6ea6e483ull, 0x5cb0a9dcbd41fbd4ull, 0x76f988da831153b5ull,
+    0x983e5152ee66dfabull, 0xa831c66d2db43210ull, 0xb00327c898fb213full, 0xbf597fc7beef0ee4ull,
+    0xc6e00bf33da88fc2ull, 0xd5a79147930aa725ull, 0x06ca6351e003826full, 0x142929670a0e6e70ull,
+    0x27b70a8546d22ffcull, 0x2e1b21385c26c926ull, 0x4d2c6dfc5ac42aedull, 0x53380d139d95b3dfull,
+    0x650a73548baf63deull, 0x766a0abb3c77b2a8ull, 0x81c2c92e47edaee6ull, 0x92722c851482353bull,
+    0xa2bfe8a14cf10364ull, 0xa81a664bbc423001ull, 0xc24b8b70d0f89791ull, 0xc76c51a30654be30ull,
+    0xd192e819d6ef5218ull, 0xd69906245565a910ull, 0xf40e35855771202aull, 0x106aa07032bbd1b8ull,
+    0x19a4c116b8d2d0c8ull, 0x1e376c085141ab53ull, 0x2748774cdf8eeb99ull, 0x34b0bcb5e19b48a8ull,
+    0x391c0cb3c5c95a63ull, 0x4ed8aa4ae3418acbull, 0x5b9cca4f7763e373ull, 0x682e6ff3d6b2b8a3ull,
+    0x748f82ee5defb2fcull, 0x78a5636f43172f60ull, 0x84c87814a1f0ab72ull, 0x8cc702081a6439ecull,
+    0x90befffa23631e28ull, 0xa4506cebde82bde9ull, 0xbef9a3f7b2c67915ull, 0xc67178f2e372532bull,
+    0xca273eceea26619cull, 0xd186b8c721c0c207ull, 0xeada7dd6cde0eb1eull, 0xf57d4f7fee6ed178ull,
+    0x06f067aa72176fbaull, 0x0a637dc5a2c898a6ull, 0x113f9804bef90daeull, 0x1b710b35131c471bull,
+    0x28db77f523047d84ull, 0x32caab7b40c72493ull, 0x3c9ebe0a15c9bebcull, 0x431d67c49c100d4cull,
+    0x4cc5d4becb3e42b6ull, 0x597f299cfc657e2aull, 0x5fcb6fab3ad6faecull, 0x6c44198c4a475817ull};
+
+v64 inline Sigma0(v64 x) { return Rotr64(x, 28) ^ Rotr64(x, 34) ^ Rotr64(x, 39); }
+v64 inline Sigma1(v64 x) { return Rotr64(x, 14) ^ Rotr64(x, 18) ^ Rotr64(x, 41); }
+v64 inline sigma0(v64 x) { return Rotr64(x, 1) ^ Rotr64(x, 8) ^ (x >> 7); }
+v64 inline sigma1(v64 x) { return Rotr64(x, 19) ^ Rotr64(x, 61) ^ (x >> 6); }
+
+void Transform(v64* s, v64* w)
+{
+    v64 a[8];
+    for (int i = 0; i < 8; i++)
+        a[i] = s[i];
+    for (int i = 0; i < 80; i++) {
+        if (i >= 16)
+            w[i & 15] += sigma1(w[(i + 14) & 15]) + w[(i + 9) & 15] + sigma0(w[(i + 1) & 15]);
+        v64 t1 = a[7] + Sigma1(a[4]) + (a[6] ^ (a[4] & (a[5] ^ a[6]))) + Splat64(K[i]) + w[i & 15];
+        v64 t2 = Sigma0(a[0]) + ((a[0] & a[1]) | (a[2] & (a[0] | a[1])));
+        a[7] = a[6];
+        a[6] = a[5];
+        a[5] = a[4];
+        a[4] = a[3] + t1;
+        a[3] = a[2];
+        a[2] = a[1];
+        a[1] = a[0];
+        a[0] = t1 + t2;
+    }
+    for (int i = 0; i < 8; i++)
+        s[i] += a[i];
+}
+
+void Hash512(LaneBuffer* pBuf)
+{
+    static const uint64_t IV[8] = {
+        0x6a09e667f3bcc908ull, 0xbb67ae8584caa73bull, 0x3c6ef372fe94f82bull, 0xa54ff53a5f1d36f1ull,
+        0x510e527fade682d1ull, 0x9b05688c2b3e6c1full, 0x1f83d9abfb41bd6bull, 0x5be0cd19137e2179ull};
+    v64 s[8], w[16];
+    for (int i = 0; i < 8; i++)
+        s[i] = Splat64(IV[i]);
+
+    const unsigned char* ppIn[XEVAN_LANES];
+    LanePointers(ppIn, pBuf);
+    for (int i = 0; i < 16; i++)
+        w[i] = LoadBE64(ppIn, 8 * i);
+    Transform(s, w);
+
+    for (int i = 0; i < 16; i++)
+        w[i] = Splat64(0);
+    w[0] = Splat64(0x8000000000000000ull);
+    w[15] = Splat64(STAGE_SIZE << 3);
+    Transform(s, w);
+
+    for (int i = 0; i < 8; i++)
+        StoreBE64(pBuf, 8 * i, s[i]);
+}
+} // namespace sha512
+
+/** Run one sph primitive over every lane; its 64-byte result replaces the lane's input. */
+template <typename Context, void (*Init)(void*), void (*Update)(void*, const void*, size_t), void (*Close)(void*, void*)>
+void ScalarStage(LaneBuffer* pBuf)
+{
+    for (int l = 0; l < XEVAN_LANES; l++) {
+        Context ctx;
+        Init(&ctx);
+        Update(&ctx, pBuf[l], STAGE_SIZE);
+        Close(&ctx, pBuf[l]);
+    }
+}
+
+/** The sixteen stages that follow blake in each of the two XEVAN passes. */
+void Pass(LaneBuffer* pBuf)
+{
+    bmw::Hash512(pBuf);
+    ScalarStage<sph_groestl512_context, sph_groestl512_init, sph_groestl512, sph_groestl512_close>(pBuf);
+    skein::Hash512(pBuf);
+    ScalarStage<sph_jh512_context, sph_jh512_init, sph_jh512, sph_jh512_close>(pBuf);
+    keccak::Hash512(pBuf);
+    ScalarStage<sph_luffa512_context, sph_luffa512_init, sph_luffa512, sph_luffa512_close>(pBuf);
+    cubehash::Hash512(pBuf);
+    ScalarStage<sph_shavite512_context, sph_shavite512_init, sph_shavite512, sph_shavite512_close>(pBuf);
+    ScalarStage<sph_simd512_context, sph_simd512_init, sph_simd512, sph_simd512_close>(pBuf);
+    ScalarStage<sph_echo512_context, sph_echo512_init, sph_echo512, sph_echo512_close>(pBuf);
+    ScalarStage<sph_hamsi512_context, sph_hamsi512_init, sph_hamsi512, sph_hamsi512_close>(pBuf);
+    ScalarStage<sph_fugue512_context, sph_fugue512_init, sph_fugue512, sph_fugue512_close>(pBuf);
+    ScalarStage<sph_shabal512_context, sph_shabal512_init, sph_shabal512, sph_shabal512_close>(pBuf);
+    ScalarStage<sph_whirlpool_context, sph_whirlpool_init, sph_whirlpool, sph_whirlpool_close>(pBuf);
+    sha512::Hash512(pBuf);
+    ScalarStage<sph_haval256_5_context, sph_haval256_5_init, sph_haval256_5, sph_haval256_5_close>(pBuf);
+
+    // haval only writes 32 bytes, the rest of its result slot stays zero
+    for (int l = 0; l < XEVAN_LANES; l++)
+        memset(pBuf[l] + 32, 0, 32);
+}
+} // namespace xevan_lanes
+} // namespace
+
+namespace XEVAN_LANES_NAMESPACE
+{
+void Hash(unsigned char* const* ppOutput, const unsigned char* const* ppInput, size_t nLen)
+{
+    using namespace xevan_lanes;
+
+    LaneBuffer buf[XEVAN_LANES];
+    blake::Hash512(buf, ppInput, nLen);
+    for (int l = 0; l < XEVAN_LANES; l++)
+        memset(buf[l] + 64, 0, 64);
+    Pass(buf);
+
+    const unsigned char* ppLanes[XEVAN_LANES];
+    LanePointers(ppLanes, buf);
+    blake::Hash512(buf, ppLanes, STAGE_SIZE);
+    Pass(buf);
+
+    for (int l = 0; l < XEVAN_LANES; l++)
+        memcpy(ppOutput[l], buf[l], 32);
+}
+} // namespace XEVAN_LANES_NAMESPACE
@@ -241,19 +241,51 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
     return true;
 }
 
+// Stake modifiers already looked up, by the hash of the block the staked coin is from. An entry stays valid
+// for as long as the block its modifier was selected from is in the active chain.
+struct CStakeModifierCacheEntry {
+    uint64_t nStakeModifier;
+    int nStakeModifierHeight;
+    int64_t nStakeModifierTime;
+    const CBlockIndex* pindexSelected;
+};
+static const size_t MAX_STAKE_MODIFIER_CACHE_SIZE = 50000;
+static std::map<uint256, CStakeModifierCacheEntry> mapStakeModifierCache;
+static CCriticalSection cs_stakeModifierCache;
+
+// The block at nHeight on the chain ending at pindexPrev, or on the active chain without one
+static const CBlockIndex* GetKernelChainBlock(const CBlockIndex* pindexPrev, int nHeight)
+{
+    if (!pindexPrev)
+        return chainActive[nHeight];
+    return nHeight <= pindexPrev->nHeight ? pindexPrev->GetAncestor(nHeight) : NULL;
+}
+
 // The stake modifier used to hash for a stake kernel is chosen as the stake
 // modifier about a selection interval later than the coin generating the kernel
-bool GetKernelStakeModifier(uint256 hashBlockFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, bool fPrintProofOfStake)
+bool GetKernelStakeModifier(uint256 hashBlockFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, bool fPrintProofOfStake, const CBlockIndex* pindexPrev)
 {
     nStakeModifier = 0;
-    if (!mapBlockIndex.count(hashBlockFrom))
+    {
+        LOCK(cs_stakeModifierCache);
+        std::map<uint256, CStakeModifierCacheEntry>::const_iterator it = mapStakeModifierCache.find(hashBlockFrom);
+        if (it != mapStakeModifierCache.end() && GetKernelChainBlock(pindexPrev, it->second.pindexSelected->nHeight) == it->second.pindexSelected) {
+            nStakeModifier = it->second.nStakeModifier;
+            nStakeModifierHeight = it->second.nStakeModifierHeight;
+            nStakeModifierTime = it->second.nStakeModifierTime;
+            return true;
+        }
+    }
+
+    BlockMap::const_iterator mi = mapBlockIndex.find(hashBlockFrom);
+    if (mi == mapBlockIndex.end())
         return error("GetKernelStakeModifier() : block not indexed");
-    const CBlockIndex* pindexFrom = mapBlockIndex[hashBlockFrom];
+    const CBlockIndex* pindexFrom = mi->second;
     nStakeModifierHeight = pindexFrom->nHeight;
     nStakeModifierTime = pindexFrom->GetBlockTime();
     int64_t nStakeModifierSelectionInterval = GetStakeModifierSelectionInterval();
     const CBlockIndex* pindex = pindexFrom;
-    CBlockIndex* pindexNext = chainActive[pindexFrom->nHeight + 1];
+    const CBlockIndex* pindexNext = GetKernelChainBlock(pindexPrev, pindexFrom->nHeight + 1);
 
     // loop to find the stake modifier later by a selection interval
     while (nStakeModifierTime < pindexFrom->GetBlockTime() + nStakeModifierSelectionInterval) {
@@ -263,16 +295,40 @@ bool GetKernelStakeModifier(uint256 hashBlockFrom, uint64_t& nStakeModifier, int
         }
 
         pindex = pindexNext;
-        pindexNext = chainActive[pindexNext->nHeight + 1];
+        pindexNext = GetKernelChainBlock(pindexPrev, pindexNext->nHeight + 1);
         if (pindex->GeneratedStakeModifier()) {
             nStakeModifierHeight = pindex->nHeight;
             nStakeModifierTime = pindex->GetBlockTime();
         }
     }
     nStakeModifier = pindex->nStakeModifier;
+
+    CStakeModifierCacheEntry entry;
+    entry.nStakeModifier = nStakeModifier;
+    entry.nStakeModifierHeight = nStakeModifierHeight;
+    entry.nStakeModifierTime = nStakeModifierTime;
+    entry.pindexSelected = pindex;
+    LOCK(cs_stakeModifierCache);
+    if (mapStakeModifierCache.size() >= MAX_STAKE_MODIFIER_CACHE_SIZE)
+        mapStakeModifierCache.clear();
+    mapStakeModifierCache[hashBlockFrom] = entry;
     return true;
 }
 
+CStakeKernelHasher::CStakeKernelHasher(uint64_t nStakeModifier, unsigned int nTimeBlockFrom, const COutPoint& prevout) : ssPrefix(SER_GETHASH, 0)
+{
+    //same layout as stakeHash(): the modifier, then the transaction hash and index to make sure each hash is unique
+    ssPrefix << nStakeModifier << nTimeBlockFrom << prevout.n << prevout.hash;
+}
+
+uint256 CStakeKernelHasher::GetHash(unsigned int nTimeTx) const
+{
+    //the prefix is shorter than a sha256 block, so every try costs one compression per round of the double hash
+    CHashWriter ss(ssPrefix);
+    ss << nTimeTx;
+    return ss.GetHash();
+}
+
 uint256 stakeHash(unsigned int nTimeTx, CDataStream ss, unsigned int prevoutIndex, uint256 prevoutHash, unsigned int nTimeBlockFrom)
 {
     //Loonie will hash in the transaction hash and the index number in order to make sure each hash is unique
@@ -290,90 +346,114 @@ bool stakeTargetHit(uint256 hashProofOfStake, int64_t nValueIn, uint256 bnTarget
     return (uint256(hashProofOfStake) < bnCoinDayWeight * bnTargetPerCoinDay);
 }
 
-//instead of looping outside and reinitializing variables many times, we will give a nTimeTx and also search interval so that we can do all the hashing here
-bool CheckStakeKernelHash(unsigned int nBits, const CBlock blockFrom, const CTransaction txPrev, const COutPoint prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake)
+static bool CheckStakeKernelTime(unsigned int nTimeBlockFrom, unsigned int nTimeTx)
 {
-    //assign new variables to make it easier to read
-    int64_t nValueIn = txPrev.vout[prevout.n].nValue;
-    unsigned int nTimeBlockFrom = blockFrom.GetBlockTime();
-
     if (nTimeTx < nTimeBlockFrom) // Transaction timestamp violation
         return error("CheckStakeKernelHash() : nTime violation");
 
     if (nTimeBlockFrom + nStakeMinAge > nTimeTx) // Min age requirement
         return error("CheckStakeKernelHash() : min age violation - nTimeBlockFrom=%d nStakeMinAge=%d nTimeTx=%d", nTimeBlockFrom, nStakeMinAge, nTimeTx);
 
-    //grab difficulty
-    uint256 bnTargetPerCoinDay;
-    bnTargetPerCoinDay.SetCompact(nBits);
+    return true;
+}
+
+bool GetStakeKernelInput(const CBlockIndex* pindexFrom, const CTransaction& txPrev, const COutPoint& prevout, CStakeKernelInput& input, bool fPrintProofOfStake, const CBlockIndex* pindexPrev)
+{
+    input.prevout = prevout;
+    input.nValueIn = txPrev.vout[prevout.n].nValue;
+    input.nTimeBlockFrom = pindexFrom->GetBlockTime();
+    input.nHeightBlockFrom = pindexFrom->nHeight;
 
     //grab stake modifier
-    uint64_t nStakeModifier = 0;
-    int nStakeModifierHeight = 0;
-    int64_t nStakeModifierTime = 0;
-    if (!GetKernelStakeModifier(blockFrom.GetHash(), nStakeModifier, nStakeModifierHeight, nStakeModifierTime, fPrintProofOfStake)) {
+    if (!GetKernelStakeModifier(pindexFrom->GetBlockHash(), input.nStakeModifier, input.nStakeModifierHeight, input.nStakeModifierTime, fPrintProofOfStake, pindexPrev)) {
         LogPrintf("CheckStakeKernelHash(): failed to get kernel stake modifier \n");
         return false;
     }
+    return true;
+}
 
-    //create data stream once instead of repeating it in the loop
-    CDataStream ss(SER_GETHASH, 0);
-    ss << nStakeModifier;
+bool SearchStakeKernelHash(unsigned int nBits, const CStakeKernelInput& input, unsigned int& nTimeTx, unsigned int nHashDrift, const std::atomic<bool>& fInterrupt, uint256& hashProofOfStake, bool fPrintProofOfStake)
+{
+    if (!CheckStakeKernelTime(input.nTimeBlockFrom, nTimeTx))
+        return false;
 
-    //if wallet is simply checking to make sure a hash is valid
-    if (fCheck) {
-        hashProofOfStake = stakeHash(nTimeTx, ss, prevout.n, prevout.hash, nTimeBlockFrom);
-        return stakeTargetHit(hashProofOfStake, nValueIn, bnTargetPerCoinDay);
-    }
+    //hash the part of the kernel that is the same for every try once instead of repeating it in the loop
+    CStakeKernelHasher hasher(input.nStakeModifier, input.nTimeBlockFrom, input.prevout);
 
-    bool fSuccess = false;
-    unsigned int nTryTime = 0;
-    unsigned int i;
-    int nHeightStart = chainActive.Height();
-    for (i = 0; i < (nHashDrift); i++) //iterate the hashing
+    //the target only depends on the coin, see stakeTargetHit()
+    uint256 bnTargetPerCoinDay;
+    bnTargetPerCoinDay.SetCompact(nBits);
+    uint256 bnTarget = (uint256(input.nValueIn) / 100) * bnTargetPerCoinDay;
+
+    for (unsigned int i = 0; i < nHashDrift; i++) //iterate the hashing
     {
-        //new block came in, move on
-        if (chainActive.Height() != nHeightStart)
+        //new block came in or another search won, move on
+        if (fInterrupt)
             break;
 
         //hash this iteration
-        nTryTime = nTimeTx + nHashDrift - i;
-        hashProofOfStake = stakeHash(nTryTime, ss, prevout.n, prevout.hash, nTimeBlockFrom);
+        unsigned int nTryTime = nTimeTx + nHashDrift - i;
+        hashProofOfStake = hasher.GetHash(nTryTime);
 
         // if stake hash does not meet the target then continue to next iteration
-        if (!stakeTargetHit(hashProofOfStake, nValueIn, bnTargetPerCoinDay))
+        if (!(hashProofOfStake < bnTarget))
             continue;
 
-        fSuccess = true; // if we make it this far then we have successfully created a stake hash
+        // if we make it this far then we have successfully created a stake hash
         nTimeTx = nTryTime;
 
         if (fDebug || fPrintProofOfStake) {
             LogPrintf("CheckStakeKernelHash() : using modifier %s at height=%d timestamp=%s for block from height=%d timestamp=%s\n",
-                boost::lexical_cast<std::string>(nStakeModifier).c_str(), nStakeModifierHeight,
-                DateTimeStrFormat("%Y-%m-%d %H:%M:%S", nStakeModifierTime).c_str(),
-                mapBlockIndex[blockFrom.GetHash()]->nHeight,
-                DateTimeStrFormat("%Y-%m-%d %H:%M:%S", blockFrom.GetBlockTime()).c_str());
+                boost::lexical_cast<std::string>(input.nStakeModifier).c_str(), input.nStakeModifierHeight,
+                DateTimeStrFormat("%Y-%m-%d %H:%M:%S", input.nStakeModifierTime).c_str(),
+                input.nHeightBlockFrom,
+                DateTimeStrFormat("%Y-%m-%d %H:%M:%S", input.nTimeBlockFrom).c_str());
             LogPrintf("CheckStakeKernelHash() : pass protocol=%s modifier=%s nTimeBlockFrom=%u prevoutHash=%s nTimeTxPrev=%u nPrevout=%u nTimeTx=%u hashProof=%s\n",
                 "0.3",
-                boost::lexical_cast<std::string>(nStakeModifier).c_str(),
-                nTimeBlockFrom, prevout.hash.ToString().c_str(), nTimeBlockFrom, prevout.n, nTryTime,
+                boost::lexical_cast<std::string>(input.nStakeModifier).c_str(),
+                input.nTimeBlockFrom, input.prevout.hash.ToString().c_str(), input.nTimeBlockFrom, input.prevout.n, nTryTime,
                 hashProofOfStake.ToString().c_str());
         }
-        break;
+        return true;
     }
 
-    mapHashedBlocks.clear();
-    mapHashedBlocks[chainActive.Tip()->nHeight] = GetTime(); //store a time stamp of when we last hashed on this block
-    return fSuccess;
+    return false;
+}
+
+//instead of looping outside and reinitializing variables many times, we will give a nTimeTx and also search interval so that we can do all the hashing here
+bool CheckStakeKernelHash(unsigned int nBits, const CBlockIndex* pindexFrom, const CTransaction& txPrev, const COutPoint& prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake, const CBlockIndex* pindexPrev)
+{
+    if (!CheckStakeKernelTime(pindexFrom->GetBlockTime(), nTimeTx))
+        return false;
+
+    CStakeKernelInput input;
+    if (!GetStakeKernelInput(pindexFrom, txPrev, prevout, input, fPrintProofOfStake, pindexPrev))
+        return false;
+
+    //if wallet is simply checking to make sure a hash is valid
+    if (fCheck) {
+        uint256 bnTargetPerCoinDay;
+        bnTargetPerCoinDay.SetCompact(nBits);
+        hashProofOfStake = CStakeKernelHasher(input.nStakeModifier, input.nTimeBlockFrom, prevout).GetHash(nTimeTx);
+        return stakeTargetHit(hashProofOfStake, input.nValueIn, bnTargetPerCoinDay);
+    }
+
+    //the caller holds cs_main for the whole search, so the tip cannot move underneath it
+    std::atomic<bool> fInterrupt(false);
+    return SearchStakeKernelHash(nBits, input, nTimeTx, nHashDrift, fInterrupt, hashProofOfStake, fPrintProofOfStake);
 }
 
 // Check kernel hash target and coinstake signature
-bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake)
+bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake, const CBlockIndex* pindexPrev)
 {
     const CTransaction tx = block.vtx[1];
     if (!tx.IsCoinStake())
         return error("CheckProofOfStake() : called on non-coinstake %s", tx.GetHash().ToString().c_str());
 
+    // before StakeKernelChainBlock() the kernel is looked up along the active chain, whatever chain the block is on
+    if (pindexPrev && pindexPrev->nHeight + 1 < Params().StakeKernelChainBlock())
+        pindexPrev = NULL;
+
     // Kernel (input 0) must match the stake hash target per coin age (nBits)
     const CTxIn& txin = tx.vin[0];
 
@@ -394,14 +474,13 @@ bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake)
     else
         return error("CheckProofOfStake() : read block failed");
 
-    // Read block header
-    CBlock blockprev;
-    if (!ReadBlockFromDisk(blockprev, pindex->GetBlockPos()))
-        return error("CheckProofOfStake(): INFO: failed to find block");
+    // the staked coin has to be on the chain the block builds on, which needn't be the active one
+    if (pindexPrev && pindexPrev->GetAncestor(pindex->nHeight) != pindex)
+        return error("CheckProofOfStake() : INFO: coinstake %s spends a coin off the chain of block %s", tx.GetHash().ToString().c_str(), block.GetHash().ToString().c_str());
 
     unsigned int nInterval = 0;
     unsigned int nTime = block.nTime;
-    if (!CheckStakeKernelHash(block.nBits, blockprev, txPrev, txin.prevout, nTime, nInterval, true, hashProofOfStake, fDebug))
+    if (!CheckStakeKernelHash(block.nBits, pindex, txPrev, txin.prevout, nTime, nInterval, true, hashProofOfStake, fDebug, pindexPrev))
         return error("CheckProofOfStake() : INFO: check kernel failed on coinstake %s, hashProof=%s \n", tx.GetHash().ToString().c_str(), hashProofOfStake.ToString().c_str()); // may occur during initial download or if behind on block chain sync
 
     return true;
@@ -7,6 +7,7 @@
 
 #include "main.h"
 
+#include <atomic>
 
 // MODIFIER_INTERVAL: time to elapse before new modifier is computed
 static const unsigned int MODIFIER_INTERVAL = 60;
@@ -21,15 +22,50 @@ static const int MODIFIER_INTERVAL_RATIO = 3;
 // Compute the hash modifier for proof-of-stake
 bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeModifier, bool& fGeneratedStakeModifier);
 
+// Get the stake modifier used for kernels of coins from the given block, results are cached per block.
+// It is looked up on the chain ending at pindexPrev, by default on the active chain
+bool GetKernelStakeModifier(uint256 hashBlockFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, bool fPrintProofOfStake, const CBlockIndex* pindexPrev = NULL);
+
+/** Hashes the stake kernel of one coin. Everything but the transaction time is fixed for a given coin,
+ *  so the serialized prefix is written once and every try only appends nTimeTx to a copy of it. */
+class CStakeKernelHasher
+{
+private:
+    CHashWriter ssPrefix;
+
+public:
+    CStakeKernelHasher(uint64_t nStakeModifier, unsigned int nTimeBlockFrom, const COutPoint& prevout);
+    uint256 GetHash(unsigned int nTimeTx) const;
+};
+
 // Check whether stake kernel meets hash target
 // Sets hashProofOfStake on success return
 uint256 stakeHash(unsigned int nTimeTx, CDataStream ss, unsigned int prevoutIndex, uint256 prevoutHash, unsigned int nTimeBlockFrom);
 bool stakeTargetHit(uint256 hashProofOfStake, int64_t nValueIn, uint256 bnTargetPerCoinDay);
-bool CheckStakeKernelHash(unsigned int nBits, const CBlock blockFrom, const CTransaction txPrev, const COutPoint prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake = false);
+bool CheckStakeKernelHash(unsigned int nBits, const CBlockIndex* pindexFrom, const CTransaction& txPrev, const COutPoint& prevout, unsigned int& nTimeTx, unsigned int nHashDrift, bool fCheck, uint256& hashProofOfStake, bool fPrintProofOfStake = false, const CBlockIndex* pindexPrev = NULL);
+
+/** What a kernel search needs to know about one coin and the block it is from. It is filled in
+ *  under cs_main, so the search itself never touches the block index or the active chain. */
+struct CStakeKernelInput {
+    COutPoint prevout;
+    int64_t nValueIn;
+    unsigned int nTimeBlockFrom;
+    int nHeightBlockFrom;
+    uint64_t nStakeModifier;
+    int nStakeModifierHeight;
+    int64_t nStakeModifierTime;
+};
+
+// Look up the kernel data of a coin, requires cs_main
+bool GetStakeKernelInput(const CBlockIndex* pindexFrom, const CTransaction& txPrev, const COutPoint& prevout, CStakeKernelInput& input, bool fPrintProofOfStake = false, const CBlockIndex* pindexPrev = NULL);
+
+// Try the nHashDrift kernel times after nTimeTx, giving up once fInterrupt is set; takes no locks
+bool SearchStakeKernelHash(unsigned int nBits, const CStakeKernelInput& input, unsigned int& nTimeTx, unsigned int nHashDrift, const std::atomic<bool>& fInterrupt, uint256& hashProofOfStake, bool fPrintProofOfStake = false);
 
-// Check kernel hash target and coinstake signature
+// Check kernel hash target and coinstake signature, on the chain ending at pindexPrev if given and
+// Params().StakeKernelChainBlock() is reached
 // Sets hashProofOfStake on success return
-bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake);
+bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake, const CBlockIndex* pindexPrev = NULL);
 
 // Check whether the coinstake timestamp meets protocol
 bool CheckCoinStakeTimestamp(int64_t nTimeBlock, int64_t nTimeTx);
@@ -14,6 +14,7 @@
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
+#include "crypto/xevan.h"
 #include "init.h"
 #include "kernel.h"
 #include "masternode-budget.h"
@@ -41,6 +42,7 @@
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 
 using namespace boost;
@@ -144,6 +146,11 @@ set<CBlockIndex*, CBlockIndexWorkComparator> setBlockIndexCandidates;
 int nSyncStarted = 0;
 /** All pairs A->B, where A (or one if its ancestors) misses transactions, but B has transactions. */
 multimap<CBlockIndex*, CBlockIndex*> mapBlocksUnlinked;
+/** Proof of stake headers whose block, and with it the stake kernel, hasn't come in yet, with the peer that sent them.
+ *  At most MAX_HEADERS_UNCHECKED per peer. */
+map<CBlockIndex*, NodeId> mapHeadersUnchecked;
+/** The unchecked header with the most work we took in. */
+CBlockIndex* pindexBestHeaderUnchecked = NULL;
 
 CCriticalSection cs_LastBlockFile;
 std::vector<CBlockFileInfo> vinfoBlockFile;
@@ -186,6 +193,12 @@ set<CBlockIndex*> setDirtyBlockIndex;
 set<int> setDirtyFileInfo;
 } // anon namespace
 
+// The masternode, budget, obfuscation, spork and SwiftTX handlers, and the maps they keep, were written
+// for a single message handler thread. Their messages are handled one at a time under cs_extensions,
+// while the chain messages of other peers, which synchronize on cs_main, go ahead on the other threads.
+// The handlers take cs_main inside cs_extensions, so with cs_main held cs_extensions is only ever tried.
+static CCriticalSection cs_extensions;
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // dispatching functions
@@ -196,6 +209,8 @@ set<int> setDirtyFileInfo;
 namespace
 {
 struct CMainSignals {
+    /** Notifies listeners of updated block chain tip */
+    boost::signals2::signal<void(const CBlockIndex*)> UpdatedBlockTip;
     /** Notifies listeners of updated transaction data (transaction, and optionally the block it is found in. */
     boost::signals2::signal<void(const CTransaction&, const CBlock*)> SyncTransaction;
     /** Notifies listeners of an erased transaction (currently disabled, requires transaction replacement). */
@@ -216,6 +231,7 @@ struct CMainSignals {
 
 void RegisterValidationInterface(CValidationInterface* pwalletIn)
 {
+    g_signals.UpdatedBlockTip.connect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1));
     g_signals.SyncTransaction.connect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2));
 // XX42 g_signals.EraseTransaction.connect(boost::bind(&CValidationInterface::EraseFromWallet, pwalletIn, _1));
     g_signals.UpdatedTransaction.connect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
@@ -234,6 +250,7 @@ void UnregisterValidationInterface(CValidationInterface* pwalletIn)
     g_signals.UpdatedTransaction.disconnect(boost::bind(&CValidationInterface::UpdatedTransaction, pwalletIn, _1));
 // XX42    g_signals.EraseTransaction.disconnect(boost::bind(&CValidationInterface::EraseFromWallet, pwalletIn, _1));
     g_signals.SyncTransaction.disconnect(boost::bind(&CValidationInterface::SyncTransaction, pwalletIn, _1, _2));
+    g_signals.UpdatedBlockTip.disconnect(boost::bind(&CValidationInterface::UpdatedBlockTip, pwalletIn, _1));
 }
 
 void UnregisterAllValidationInterfaces()
@@ -245,6 +262,7 @@ void UnregisterAllValidationInterfaces()
     g_signals.UpdatedTransaction.disconnect_all_slots();
 // XX42    g_signals.EraseTransaction.disconnect_all_slots();
     g_signals.SyncTransaction.disconnect_all_slots();
+    g_signals.UpdatedBlockTip.disconnect_all_slots();
 }
 
 void SyncWithWallets(const CTransaction& tx, const CBlock* pblock)
@@ -292,6 +310,10 @@ struct CNodeState {
     CBlockIndex* pindexLastCommonBlock;
     //! Whether we've started headers synchronization with this peer.
     bool fSyncStarted;
+    //! Active chain height at which to carry on with headers we didn't take in yet, or 0.
+    int nHeadersWaitHeight;
+    //! Number of proof of stake headers from this peer still waiting for their block.
+    int nHeadersUnchecked;
     //! Since when we're stalling block download progress (in microseconds), or 0.
     int64_t nStallingSince;
     list<QueuedBlock> vBlocksInFlight;
@@ -308,6 +330,8 @@ struct CNodeState {
         hashLastUnknownBlock = uint256(0);
         pindexLastCommonBlock = NULL;
         fSyncStarted = false;
+        nHeadersWaitHeight = 0;
+        nHeadersUnchecked = 0;
         nStallingSince = 0;
         nBlocksInFlight = 0;
         fPreferredDownload = false;
@@ -326,6 +350,25 @@ CNodeState* State(NodeId pnode)
     return &it->second;
 }
 
+// Requires cs_main.
+void EraseUncheckedHeader(map<CBlockIndex*, NodeId>::iterator it)
+{
+    CNodeState* state = State(it->second);
+    if (state)
+        state->nHeadersUnchecked--;
+    mapHeadersUnchecked.erase(it);
+}
+
+/** The best header we know of, counting proof of stake headers still waiting for their block. Locators for getheaders
+ *  start from it, so the headers we already hold aren't sent again. Requires cs_main. */
+CBlockIndex* GetBestKnownHeader()
+{
+    if (pindexBestHeaderUnchecked && mapHeadersUnchecked.count(pindexBestHeaderUnchecked) &&
+        pindexBestHeaderUnchecked->nChainWork > pindexBestHeader->nChainWork)
+        return pindexBestHeaderUnchecked;
+    return pindexBestHeader;
+}
+
 int GetHeight()
 {
     while (true) {
@@ -371,6 +414,14 @@ void FinalizeNode(NodeId nodeid)
     BOOST_FOREACH (const QueuedBlock& entry, state->vBlocksInFlight)
         mapBlocksInFlight.erase(entry.hash);
     EraseOrphansFor(nodeid);
+
+    // the headers of this peer still waiting for their block stop counting, whether it left or stalled
+    for (map<CBlockIndex*, NodeId>::iterator it = mapHeadersUnchecked.begin(); it != mapHeadersUnchecked.end();) {
+        if (it->second == nodeid)
+            mapHeadersUnchecked.erase(it++);
+        else
+            ++it;
+    }
     nPreferredDownload -= state->fPreferredDownload;
 
     mapNodeState.erase(nodeid);
@@ -441,6 +492,12 @@ void UpdateBlockAvailability(NodeId nodeid, const uint256& hash)
     }
 }
 
+/** Whether blocks are fetched from this peer headers-first rather than by following its getblocks inventory. */
+bool IsHeadersFirstPeer(const CNode* pnode)
+{
+    return Params().HeadersFirstSyncingActive() && pnode->nVersion >= HEADERS_FIRST_VERSION;
+}
+
 /** Find the last common ancestor two blocks have.
  *  Both pa and pb must be non-NULL. */
 CBlockIndex* LastCommonAncestor(CBlockIndex* pa, CBlockIndex* pb)
@@ -497,6 +554,7 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBl
     // Never fetch further than the best block we know the peer has, or more than BLOCK_DOWNLOAD_WINDOW + 1 beyond the last
     // linked block we have in common with this peer. The +1 is so we can detect stalling, namely if we would be able to
     // download that next block if the window were 1 larger.
+    // Past the last proof of work block, the headers the peer sent are within MAX_HEADERS_AHEAD of the active chain.
     int nWindowEnd = state->pindexLastCommonBlock->nHeight + BLOCK_DOWNLOAD_WINDOW;
     int nMaxHeight = std::min<int>(state->pindexBestKnownBlock->nHeight, nWindowEnd + 1);
     NodeId waitingfor = -1;
@@ -903,6 +961,7 @@ int GetInputAgeIX(uint256 nTXHash, CTxIn& vin)
     if (nResult < 0) nResult = 0;
 
     if (nResult < 6) {
+        LOCK(cs_mapTxLocks);
         std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(nTXHash);
         if (i != mapTxLocks.end()) {
             sigs = (*i).second.CountSignatures();
@@ -919,9 +978,12 @@ int GetIXConfirmations(uint256 nTXHash)
 {
     int sigs = 0;
 
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(nTXHash);
-    if (i != mapTxLocks.end()) {
-        sigs = (*i).second.CountSignatures();
+    {
+        LOCK(cs_mapTxLocks);
+        std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(nTXHash);
+        if (i != mapTxLocks.end()) {
+            sigs = (*i).second.CountSignatures();
+        }
     }
     if (sigs >= SWIFTTX_SIGNATURES_REQUIRED) {
         return nSwiftTXDepth;
@@ -1309,7 +1371,159 @@ bool IsZerocoinSpendUnknown(CoinSpend coinSpend, uint256 hashTx, CValidationStat
     return true;
 }
 
-bool CheckZerocoinSpend(const CTransaction tx, bool fVerifySignature, CValidationState& state)
+bool CZerocoinSpendCheck::operator()()
+{
+    if (!pspend)
+        return false;
+
+    try {
+        Accumulator accumulator(Params().Zerocoin_Params(), pspend->getDenomination(), bnAccumulatorValue);
+        return pspend->Verify(accumulator);
+    } catch (std::exception& e) {
+        return ::error("CZerocoinSpendCheck(): %s", e.what());
+    }
+}
+
+static CCheckQueue<CZerocoinSpendCheck> zerocoinspendcheckqueue(128);
+static CCriticalSection cs_zerocoinspendcheckqueue;
+
+void ThreadZerocoinSpendCheck()
+{
+    RenameThread("loonie-zspendch");
+    zerocoinspendcheckqueue.Thread();
+}
+
+/**
+ * Closure computing the hashes of up to XEVAN_MAX_LANES legacy block headers in one pass of
+ * the multi-lane XEVAN kernel, the results are kept in the headers' hash memos
+ */
+class CHeaderHashCheck
+{
+private:
+    const CBlockHeader* vpheader[XEVAN_MAX_LANES];
+    int nHeaders;
+
+public:
+    CHeaderHashCheck() : nHeaders(0) {}
+
+    bool IsEmpty() const { return nHeaders == 0; }
+
+    bool Add(const CBlockHeader* pheader)
+    {
+        vpheader[nHeaders++] = pheader;
+        return nHeaders == XevanLanes();
+    }
+
+    bool operator()()
+    {
+        if (nHeaders == 0)
+            return true;
+
+        const unsigned char* ppInput[XEVAN_MAX_LANES];
+        unsigned char vchOutput[XEVAN_MAX_LANES][32];
+        unsigned char* ppOutput[XEVAN_MAX_LANES];
+        for (int i = 0; i < nHeaders; i++) {
+            ppInput[i] = (const unsigned char*)BEGIN(vpheader[i]->nVersion);
+            ppOutput[i] = vchOutput[i];
+        }
+        XevanMulti(ppOutput, ppInput, CBlockHeader::LEGACY_HEADER_SIZE, nHeaders);
+
+        for (int i = 0; i < nHeaders; i++) {
+            uint256 hash;
+            memcpy(hash.begin(), vchOutput[i], 32);
+            vpheader[i]->hashMemo.Set(ppInput[i], hash);
+        }
+        return true;
+    }
+
+    void swap(CHeaderHashCheck& check)
+    {
+        for (int i = 0; i < XEVAN_MAX_LANES; i++)
+            std::swap(vpheader[i], check.vpheader[i]);
+        std::swap(nHeaders, check.nHeaders);
+    }
+};
+
+static CCheckQueue<CHeaderHashCheck> headerhashcheckqueue(128);
+static CCriticalSection cs_headerhashcheckqueue;
+
+void ThreadHeaderHashCheck()
+{
+    RenameThread("loonie-hdrhash");
+    headerhashcheckqueue.Thread();
+}
+
+void PrecomputeBlockHeaderHashes(const std::vector<CBlockHeader>& vHeaders)
+{
+    // only legacy headers are XEVAN hashed, the others are a single sha256d each;
+    // the legacy ones are grouped so that each check fills every lane of the kernel
+    std::vector<CHeaderHashCheck> vChecks;
+    vChecks.reserve(vHeaders.size() / XevanLanes() + 1);
+    CHeaderHashCheck check;
+    for (const CBlockHeader& header : vHeaders) {
+        if (header.nVersion < 4 && check.Add(&header)) {
+            vChecks.push_back(check);
+            check = CHeaderHashCheck();
+        }
+    }
+    if (!check.IsEmpty())
+        vChecks.push_back(check);
+
+    // like the other queues this one has a single master, a caller that finds it busy hashes inline
+    if (nScriptCheckThreads && vChecks.size() > 1) {
+        TRY_LOCK(cs_headerhashcheckqueue, lockQueue);
+        if (lockQueue) {
+            CCheckQueueControl<CHeaderHashCheck> control(&headerhashcheckqueue);
+            control.Add(vChecks);
+            control.Wait();
+            return;
+        }
+    }
+
+    for (CHeaderHashCheck& check : vChecks)
+        check();
+}
+
+/**
+ * Run a batch of deferred spend proof checks, fanning them out over the -par workers.
+ * The queue only supports one master at a time, so a caller that finds it busy (e.g.
+ * mempool acceptance racing block validation) verifies its own batch inline instead.
+ */
+bool RunZerocoinSpendChecks(std::vector<CZerocoinSpendCheck>& vChecks)
+{
+    if (vChecks.empty())
+        return true;
+
+    if (nScriptCheckThreads && vChecks.size() > 1) {
+        TRY_LOCK(cs_zerocoinspendcheckqueue, lockQueue);
+        if (lockQueue) {
+            CCheckQueueControl<CZerocoinSpendCheck> control(&zerocoinspendcheckqueue);
+            control.Add(vChecks);
+            return control.Wait();
+        }
+    }
+
+    for (CZerocoinSpendCheck& check : vChecks) {
+        if (!check())
+            return false;
+    }
+    return true;
+}
+
+/** Send signal to wallet if the spent serial is one of our mints */
+static void NotifyZerocoinSpent(const CBigNum& bnSerial, const uint256& txid)
+{
+    if (!pwalletMain)
+        return;
+
+    CZerocoinMint mint;
+    if (pwalletMain->GetMintFromSerial(bnSerial, mint) && !mint.IsUsed()) {
+        LogPrintf("%s: %s detected spent zerocoin mint in transaction %s \n", __func__, mint.GetSerialNumber().GetHex(), txid.GetHex());
+        pwalletMain->NotifyZerocoinChanged(pwalletMain, mint.GetSerialNumber().GetHex(), "Used", CT_UPDATED);
+    }
+}
+
+bool CheckZerocoinSpend(const CTransaction tx, bool fVerifySignature, CValidationState& state, std::vector<CZerocoinSpendCheck>* pvChecks)
 {
     //max needed non-mint outputs should be 2 - one for redemption address and a possible 2nd for change
     if (tx.vout.size() > 2) {
@@ -1331,6 +1545,7 @@ bool CheckZerocoinSpend(const CTransaction tx, bool fVerifySignature, CValidatio
     uint256 hashTxOut = txTemp.GetHash();
 
     bool fValidated = false;
+    std::vector<CZerocoinSpendCheck> vChecks;
     set<CBigNum> serials;
     list<CoinSpend> vSpends;
     CAmount nTotalRedeemed = 0;
@@ -1362,11 +1577,8 @@ bool CheckZerocoinSpend(const CTransaction tx, bool fVerifySignature, CValidatio
             if(!zerocoinDB->ReadAccumulatorValue(newSpend.getAccumulatorChecksum(), bnAccumulatorValue))
                 return state.DoS(100, error("Zerocoinspend could not find accumulator associated with checksum"));
 
-            Accumulator accumulator(Params().Zerocoin_Params(), newSpend.getDenomination(), bnAccumulatorValue);
-
-            //Check that the coin is on the accumulator
-            if(!newSpend.Verify(accumulator))
-                return state.DoS(100, error("CheckZerocoinSpend(): zerocoin spend did not verify"));
+            //Check that the coin is on the accumulator - deferred so the proofs can be verified in parallel
+            vChecks.push_back(CZerocoinSpendCheck(newSpend, bnAccumulatorValue));
         }
 
         if (serials.count(newSpend.getCoinSerialNumber()))
@@ -1383,23 +1595,22 @@ bool CheckZerocoinSpend(const CTransaction tx, bool fVerifySignature, CValidatio
         return state.DoS(100, error("Transaction spend more than was redeemed in zerocoins"));
     }
 
-    // Send signal to wallet if this is ours
-    if (pwalletMain) {
-        CWalletDB walletdb(pwalletMain->strWalletFile);
-        list <CBigNum> listMySerials = walletdb.ListMintedCoinsSerial();
-        for (const auto& newSpend : vSpends) {
-            list<CBigNum>::iterator it = find(listMySerials.begin(), listMySerials.end(), newSpend.getCoinSerialNumber());
-            if (it != listMySerials.end()) {
-                LogPrintf("%s: %s detected spent zerocoin mint in transaction %s \n", __func__, it->GetHex(), tx.GetHash().GetHex());
-                pwalletMain->NotifyZerocoinChanged(pwalletMain, it->GetHex(), "Used", CT_UPDATED);
-            }
-        }
+    // Deferred proofs are not verified yet, so the caller tells the wallet once they are
+    if (pvChecks) {
+        pvChecks->insert(pvChecks->end(), vChecks.begin(), vChecks.end());
+        return fValidated;
     }
 
+    if (!RunZerocoinSpendChecks(vChecks))
+        return state.DoS(100, error("CheckZerocoinSpend(): zerocoin spend did not verify"));
+
+    for (const auto& newSpend : vSpends)
+        NotifyZerocoinSpent(newSpend.getCoinSerialNumber(), tx.GetHash());
+
     return fValidated;
 }
 
-bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state)
+bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state, std::vector<CZerocoinSpendCheck>* pvZerocoinChecks)
 {
     // Basic checks that don't depend on any context
     if (tx.vin.empty())
@@ -1457,7 +1668,7 @@ bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fReject
 
             // Do not require signature verification if this is initial sync and a block over 24 hours old
             bool fVerifySignature = !IsInitialBlockDownload() && (GetTime() - chainActive.Tip()->GetBlockTime() < (60*60*24));
-            if (!CheckZerocoinSpend(tx, fVerifySignature, state))
+            if (!CheckZerocoinSpend(tx, fVerifySignature, state, pvZerocoinChecks))
                 return state.DoS(100, error("CheckTransaction() : invalid zerocoin spend"));
         }
     }
@@ -1589,12 +1800,15 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 
     // ----------- swiftTX transaction scanning -----------
 
-    BOOST_FOREACH (const CTxIn& in, tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                return state.DoS(0,
-                    error("AcceptToMemoryPool : conflicts with existing transaction lock: %s", reason),
-                    REJECT_INVALID, "tx-lock-conflict");
+    {
+        LOCK(cs_mapTxLocks);
+        BOOST_FOREACH (const CTxIn& in, tx.vin) {
+            if (mapLockedInputs.count(in.prevout)) {
+                if (mapLockedInputs[in.prevout] != tx.GetHash()) {
+                    return state.DoS(0,
+                        error("AcceptToMemoryPool : conflicts with existing transaction lock: %s", reason),
+                        REJECT_INVALID, "tx-lock-conflict");
+                }
             }
         }
     }
@@ -1809,12 +2023,15 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
 
     // ----------- swiftTX transaction scanning -----------
 
-    BOOST_FOREACH (const CTxIn& in, tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                return state.DoS(0,
-                    error("AcceptableInputs : conflicts with existing transaction lock: %s", reason),
-                    REJECT_INVALID, "tx-lock-conflict");
+    {
+        LOCK(cs_mapTxLocks);
+        BOOST_FOREACH (const CTxIn& in, tx.vin) {
+            if (mapLockedInputs.count(in.prevout)) {
+                if (mapLockedInputs[in.prevout] != tx.GetHash()) {
+                    return state.DoS(0,
+                        error("AcceptableInputs : conflicts with existing transaction lock: %s", reason),
+                        REJECT_INVALID, "tx-lock-conflict");
+                }
             }
         }
     }
@@ -1998,7 +2215,17 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock
                 } catch (std::exception& e) {
                     return error("%s : Deserialize or I/O error - %s", __func__, e.what());
                 }
-                hashBlock = header.GetHash();
+                // Resolve the containing block through the index rather than re-hashing
+                // the header, which is a full XEVAN run for pre-zerocoin blocks.
+                hashBlock = 0;
+                BlockMap::iterator mi = mapBlockIndex.find(header.hashPrevBlock);
+                if (mi != mapBlockIndex.end() && chainActive.Contains(mi->second)) {
+                    CBlockIndex* pindex = chainActive.Next(mi->second);
+                    if (pindex && pindex->GetBlockPos() == postx)
+                        hashBlock = pindex->GetBlockHash();
+                }
+                if (hashBlock == 0)
+                    hashBlock = header.GetHash();
                 if (txOut.GetHash() != hash)
                     return error("%s : txid mismatch", __func__);
                 return true;
@@ -2097,6 +2324,41 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex)
     return true;
 }
 
+bool ReadRawBlockFromDisk(CDataStream& ssBlock, const CDiskBlockPos& pos, const uint256& hashBlock)
+{
+    // WriteBlockToDisk puts the message start and the size of the block in front of it
+    if (pos.nPos < MESSAGE_START_SIZE + sizeof(unsigned int))
+        return error("%s : bad block position %d:%u", __func__, pos.nFile, pos.nPos);
+    CDiskBlockPos posHeader(pos.nFile, pos.nPos - MESSAGE_START_SIZE - sizeof(unsigned int));
+
+    // Open history file to read
+    CAutoFile filein(OpenBlockFile(posHeader, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s : OpenBlockFile failed", __func__);
+
+    try {
+        MessageStartChars pchMessageStart;
+        unsigned int nSize;
+        filein >> FLATDATA(pchMessageStart) >> nSize;
+        if (memcmp(pchMessageStart, Params().MessageStart(), MESSAGE_START_SIZE) != 0 || nSize == 0 || nSize > MAX_BLOCK_SIZE_CURRENT)
+            return error("%s : bad block header at %d:%u", __func__, pos.nFile, pos.nPos);
+
+        ssBlock.resize(nSize);
+        filein.read(&ssBlock[0], nSize);
+
+        // the header is enough to tell it's the block we're after
+        CBlockHeader header;
+        ssBlock >> header;
+        ssBlock.Rewind(nSize - ssBlock.size());
+        if (header.GetHash() != hashBlock)
+            return error("%s : block=%s index=%s", __func__, header.GetHash().ToString(), hashBlock.ToString());
+    } catch (std::exception& e) {
+        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+    }
+
+    return true;
+}
+
 
 double ConvertBitsToDouble(unsigned int nBits)
 {
@@ -2862,6 +3124,23 @@ void ThreadScriptCheck()
     scriptcheckqueue.Thread();
 }
 
+void StartCheckThreads(boost::thread_group& threadGroup)
+{
+    if (!nScriptCheckThreads)
+        return;
+
+    for (int i = 0; i < nScriptCheckThreads - 1; i++)
+        threadGroup.create_thread(&ThreadScriptCheck);
+
+    // the other queues only get busy now and then, a few workers each keep them from idling whole sets of threads
+    int nAuxCheckThreads = std::min(nScriptCheckThreads - 1, MAX_AUX_CHECK_THREADS);
+    for (int i = 0; i < nAuxCheckThreads; i++) {
+        threadGroup.create_thread(&ThreadZerocoinSpendCheck);
+        threadGroup.create_thread(&ThreadMessageSignatureCheck);
+        threadGroup.create_thread(&ThreadHeaderHashCheck);
+    }
+}
+
 void RecalculateZLNIMinted()
 {
     CBlockIndex *pindex = chainActive[Params().Zerocoin_AccumulatorStartHeight()];
@@ -3021,6 +3300,16 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         return state.DoS(100, error("ConnectBlock() : PoW period ended"),
             REJECT_INVALID, "PoW-ended");
 
+    // blocks AcceptBlock took in ahead of the active chain still need their stake kernel checked, as do blocks whose
+    // proof hash was lost across a restart
+    if (!fJustCheck && block.IsProofOfStake() && pindex->hashProofOfStake == 0) {
+        uint256 hashProofOfStake;
+        if (!CheckProofOfStake(block, hashProofOfStake, pindex->pprev))
+            return state.DoS(100, error("ConnectBlock() : check proof-of-stake failed for block %s", block.GetHash().ToString()),
+                REJECT_INVALID, "bad-proofofstake");
+        pindex->hashProofOfStake = hashProofOfStake;
+    }
+
     bool fScriptChecks = pindex->nHeight >= Checkpoints::GetTotalBlocksEstimate();
 
     // Do not allow blocks that contain transactions which 'overwrite' older transactions,
@@ -3808,6 +4097,7 @@ bool ActivateBestChain(CValidationState& state, CBlock* pblock, bool fAlreadyChe
                         pnode->PushInventory(CInv(MSG_BLOCK, hashNewTip));
             }
             // Notify external listeners about the new tip.
+            g_signals.UpdatedBlockTip(pindexNewTip);
             uiInterface.NotifyBlockTip(hashNewTip);
         }
     } while (pindexMostWork != chainActive.Tip());
@@ -3918,6 +4208,11 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
         pindexNew->nHeight = pindexNew->pprev->nHeight + 1;
         pindexNew->BuildSkip();
 
+        // a header alone doesn't show the coinstake, but past the last proof of work block every block is proof of
+        // stake. The stake fields that need the transactions are filled in when the block itself arrives
+        if (block.vtx.empty() && pindexNew->nHeight > Params().LAST_POW_BLOCK())
+            pindexNew->SetProofOfStake();
+
         //update previous block pointer
         pindexNew->pprev->pnext = pindexNew;
 
@@ -3929,7 +4224,7 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
             LogPrintf("AddToBlockIndex() : SetStakeEntropyBit() failed \n");
 
         // ppcoin: record proof-of-stake hash value
-        if (pindexNew->IsProofOfStake()) {
+        if (pindexNew->IsProofOfStake() && !block.vtx.empty()) {
             if (!mapProofOfStake.count(hash))
                 LogPrintf("AddToBlockIndex() : hashProofOfStake not found in map \n");
             pindexNew->hashProofOfStake = mapProofOfStake[hash];
@@ -3947,7 +4242,9 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
     }
     pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
     pindexNew->RaiseValidity(BLOCK_VALID_TREE);
-    if (pindexBestHeader == NULL || pindexBestHeader->nChainWork < pindexNew->nChainWork)
+    // a proof of stake header costs nothing to make, it only counts as best header once its block came in
+    bool fUncheckedStake = block.vtx.empty() && pindexNew->nHeight > Params().LAST_POW_BLOCK();
+    if (!fUncheckedStake && (pindexBestHeader == NULL || pindexBestHeader->nChainWork < pindexNew->nChainWork))
         pindexBestHeader = pindexNew;
 
     //update previous block pointer
@@ -3972,6 +4269,12 @@ bool ReceivedBlockTransactions(const CBlock& block, CValidationState& state, CBl
     pindexNew->nStatus |= BLOCK_HAVE_DATA;
     pindexNew->RaiseValidity(BLOCK_VALID_TRANSACTIONS);
     setDirtyBlockIndex.insert(pindexNew);
+    map<CBlockIndex*, NodeId>::iterator itUnchecked = mapHeadersUnchecked.find(pindexNew);
+    if (itUnchecked != mapHeadersUnchecked.end())
+        EraseUncheckedHeader(itUnchecked);
+    // a proof of stake block indexed as a header first counts as best header from now on
+    if (pindexBestHeader->nChainWork < pindexNew->nChainWork)
+        pindexBestHeader = pindexNew;
 
     if (pindexNew->pprev == NULL || pindexNew->pprev->nChainTx) {
         // If pindexNew is the genesis block or all parents are BLOCK_VALID_TRANSACTIONS.
@@ -4160,6 +4463,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
 
     // ----------- swiftTX transaction scanning -----------
     if (IsSporkActive(SPORK_3_SWIFTTX_BLOCK_FILTERING)) {
+        LOCK(cs_mapTxLocks);
         BOOST_FOREACH (const CTransaction& tx, block.vtx) {
             if (!tx.IsCoinBase()) {
                 //only reject blocks when it's based on complete consensus
@@ -4219,8 +4523,10 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
     // Check transactions
     bool fZerocoinActive = true;
     vector<CBigNum> vBlockSerials;
+    vector<uint256> vBlockSerialTxids;
+    std::vector<CZerocoinSpendCheck> vZerocoinChecks;
     for (const CTransaction& tx : block.vtx) {
-        if (!CheckTransaction(tx, fZerocoinActive, chainActive.Height() + 1 >= Params().Zerocoin_StartHeight(), state))
+        if (!CheckTransaction(tx, fZerocoinActive, chainActive.Height() + 1 >= Params().Zerocoin_StartHeight(), state, &vZerocoinChecks))
             return error("CheckBlock() : CheckTransaction failed");
 
         // double check that there are no double spent zCiv spends in this block
@@ -4232,11 +4538,18 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
                         return state.DoS(100, error("%s : Double spending of zCiv serial %s in block\n Block: %s",
                                                     __func__, spend.getCoinSerialNumber().GetHex(), block.ToString()));
                     vBlockSerials.emplace_back(spend.getCoinSerialNumber());
+                    vBlockSerialTxids.emplace_back(tx.GetHash());
                 }
             }
         }
     }
 
+    // Verify the spend proofs of the whole block in one parallel batch
+    if (!RunZerocoinSpendChecks(vZerocoinChecks))
+        return state.DoS(100, error("CheckBlock() : zerocoin spend did not verify"));
+    for (unsigned int i = 0; i < vBlockSerials.size(); i++)
+        NotifyZerocoinSpent(vBlockSerials[i], vBlockSerialTxids[i]);
+
 
     unsigned int nSigOps = 0;
     BOOST_FOREACH (const CTransaction& tx, block.vtx) {
@@ -4250,14 +4563,11 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
     return true;
 }
 
-bool CheckWork(const CBlock block, CBlockIndex* const pindexPrev)
+static bool CheckWorkRequired(const CBlockHeader& block, CBlockIndex* const pindexPrev, bool fProofOfWork)
 {
-    if (pindexPrev == NULL)
-        return error("%s : null pindexPrev for block %s", __func__, block.GetHash().ToString().c_str());
-
     unsigned int nBitsRequired = GetNextWorkRequired(pindexPrev, &block);
 
-    if (block.IsProofOfWork() && (pindexPrev->nHeight + 1 <= 68589)) {
+    if (fProofOfWork && (pindexPrev->nHeight + 1 <= 68589)) {
         double n1 = ConvertBitsToDouble(block.nBits);
         double n2 = ConvertBitsToDouble(nBitsRequired);
 
@@ -4270,11 +4580,22 @@ bool CheckWork(const CBlock block, CBlockIndex* const pindexPrev)
     if (block.nBits != nBitsRequired)
         return error("%s : incorrect proof of work at %d", __func__, pindexPrev->nHeight + 1);
 
-    if (block.IsProofOfStake()) {
+    return true;
+}
+
+bool CheckWork(const CBlock block, CBlockIndex* const pindexPrev, bool fCheckStake)
+{
+    if (pindexPrev == NULL)
+        return error("%s : null pindexPrev for block %s", __func__, block.GetHash().ToString().c_str());
+
+    if (!CheckWorkRequired(block, pindexPrev, block.IsProofOfWork()))
+        return false;
+
+    if (block.IsProofOfStake() && fCheckStake) {
         uint256 hashProofOfStake;
         uint256 hash = block.GetHash();
 
-        if(!CheckProofOfStake(block, hashProofOfStake)) {
+        if(!CheckProofOfStake(block, hashProofOfStake, pindexPrev)) {
             LogPrintf("WARNING: ProcessBlock(): check proof-of-stake failed for block %s\n", hash.ToString().c_str());
             return false;
         }
@@ -4285,6 +4606,26 @@ bool CheckWork(const CBlock block, CBlockIndex* const pindexPrev)
     return true;
 }
 
+bool CheckHeaderWork(const CBlockHeader& block, CValidationState& state, CBlockIndex* const pindexPrev)
+{
+    int nHeight = pindexPrev->nHeight + 1;
+    bool fProofOfStake = nHeight > Params().LAST_POW_BLOCK();
+
+    if (block.GetBlockTime() > GetAdjustedTime() + (fProofOfStake ? 180 : 7200)) // 3 minute future drift for PoS
+        return state.Invalid(error("%s : block timestamp too far in the future", __func__),
+            REJECT_INVALID, "time-too-new");
+
+    if (!CheckWorkRequired(block, pindexPrev, !fProofOfStake))
+        return state.DoS(50, error("%s : incorrect difficulty at %d", __func__, nHeight),
+            REJECT_INVALID, "bad-diffbits");
+
+    if (!fProofOfStake && !CheckProofOfWork(block.GetHash(), block.nBits))
+        return state.DoS(50, error("%s : proof of work failed at %d", __func__, nHeight),
+            REJECT_INVALID, "high-hash");
+
+    return true;
+}
+
 bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex* const pindexPrev)
 {
     uint256 hash = block.GetHash();
@@ -4357,7 +4698,22 @@ bool ContextualCheckBlock(const CBlock& block, CValidationState& state, CBlockIn
     return true;
 }
 
-bool AcceptBlockHeader(const CBlock& block, CValidationState& state, CBlockIndex** ppindex)
+/** Stop counting the unchecked proof of stake headers of a peer that the active chain went past on another branch,
+ *  their blocks won't be fetched anymore. Returns how many there were. */
+static int PruneUncheckedHeaders(NodeId nodeid)
+{
+    int nPruned = 0;
+    for (map<CBlockIndex*, NodeId>::iterator it = mapHeadersUnchecked.begin(); it != mapHeadersUnchecked.end();) {
+        if (it->second == nodeid && it->first->nHeight <= chainActive.Height() && !chainActive.Contains(it->first)) {
+            EraseUncheckedHeader(it++);
+            nPruned++;
+        } else
+            ++it;
+    }
+    return nPruned;
+}
+
+bool AcceptBlockHeader(const CBlock& block, CValidationState& state, CBlockIndex** ppindex, NodeId nodeid)
 {
     AssertLockHeld(cs_main);
     // Check for duplicate
@@ -4396,9 +4752,36 @@ bool AcceptBlockHeader(const CBlock& block, CValidationState& state, CBlockIndex
     if (!ContextualCheckBlockHeader(block, state, pindexPrev))
         return false;
 
+    if (pindexPrev && !CheckHeaderWork(block, state, pindexPrev))
+        return false;
+
+    // A proof of stake header costs nothing to make, as its stake kernel only shows with the block. So only as many
+    // are indexed ahead of their blocks as block download makes use of: close to the active chain and a bounded number
+    // per peer, so no peer can crowd out the headers of the others
+    bool fUncheckedStake = block.vtx.empty() && pindexPrev && pindexPrev->nHeight >= Params().LAST_POW_BLOCK();
+    CNodeState* nodestate = State(nodeid);
+    if (fUncheckedStake) {
+        if (pindexPrev->nHeight + 1 > chainActive.Height() + MAX_HEADERS_AHEAD)
+            return state.DoS(0, error("%s : header %s too far ahead of the active chain", __func__, hash.ToString()), 0, "headers-ahead");
+        if (nodestate && nodestate->nHeadersUnchecked >= (int)MAX_HEADERS_UNCHECKED) {
+            // Only MAX_HEADERS_AHEAD headers fit above the active chain, the rest of a full allowance is on branches
+            // the active chain went past without their blocks ever coming in
+            if (PruneUncheckedHeaders(nodeid))
+                return state.DoS(20, error("%s : peer=%d sent headers whose blocks never came in", __func__, nodeid), 0, "headers-unchecked");
+            return state.DoS(0, error("%s : peer=%d has too many proof of stake headers without their block", __func__, nodeid), 0, "headers-ahead");
+        }
+    }
+
     if (pindex == NULL)
         pindex = AddToBlockIndex(block);
 
+    if (fUncheckedStake && nodestate) {
+        mapHeadersUnchecked[pindex] = nodeid;
+        nodestate->nHeadersUnchecked++;
+        if (pindexBestHeaderUnchecked == NULL || pindexBestHeaderUnchecked->nChainWork < pindex->nChainWork)
+            pindexBestHeaderUnchecked = pindex;
+    }
+
     if (ppindex)
         *ppindex = pindex;
 
@@ -4423,7 +4806,14 @@ bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex,
                              REJECT_INVALID, "bad-prevblk");
     }
 
-    if (block.GetHash() != Params().HashGenesisBlock() && !CheckWork(block, pindexPrev))
+    // A block whose header came in first may be fetched well ahead of the active chain, before the coin it stakes is
+    // connected. Its kernel is checked by ConnectBlock then, and a bad one counts against the peer that sent the block.
+    // Only headers we took in get this, so they bound how many such blocks are stored
+    BlockMap::iterator miSelf = mapBlockIndex.find(block.GetHash());
+    bool fHeaderOnly = miSelf != mapBlockIndex.end() && !(miSelf->second->nStatus & BLOCK_HAVE_DATA);
+    bool fCheckStake = !fHeaderOnly || chainActive.Tip() == pindexPrev;
+
+    if (block.GetHash() != Params().HashGenesisBlock() && !CheckWork(block, pindexPrev, fCheckStake))
         return false;
 
     if (!AcceptBlockHeader(block, state, &pindex))
@@ -4443,6 +4833,14 @@ bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex,
         return false;
     }
 
+    if (fHeaderOnly && block.IsProofOfStake()) {
+        pindex->prevoutStake = block.vtx[1].vin[0].prevout;
+        pindex->nStakeTime = block.nTime;
+        setStakeSeen.insert(make_pair(pindex->prevoutStake, pindex->nStakeTime));
+        if (mapProofOfStake.count(block.GetHash()))
+            pindex->hashProofOfStake = mapProofOfStake[block.GetHash()];
+    }
+
     int nHeight = pindex->nHeight;
 
     // Write block to history file
@@ -4563,7 +4961,11 @@ bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDis
         //if we get this far, check if the prev block is our prev block, if not then request sync and return false
         BlockMap::iterator mi = mapBlockIndex.find(pblock->hashPrevBlock);
         if (mi == mapBlockIndex.end()) {
-            pfrom->PushMessage("getblocks", chainActive.GetLocator(), uint256(0));
+            LOCK(cs_main);
+            if (IsHeadersFirstPeer(pfrom))
+                pfrom->PushMessage("getheaders", chainActive.GetLocator(GetBestKnownHeader()), pblock->GetHash());
+            else
+                pfrom->PushMessage("getblocks", chainActive.GetLocator(), uint256(0));
             return false;
         }
     }
@@ -4592,6 +4994,8 @@ bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDis
 
     if (!fLiteMode) {
         if (masternodeSync.RequestedMasternodeAssets > MASTERNODE_SYNC_LIST) {
+            // blocks come in on every message handler thread, these belong to the extension handlers
+            LOCK(cs_extensions);
             obfuScationPool.NewBlock();
             masternodePayments.ProcessBlock(GetHeight() + 10);
             budget.NewBlock();
@@ -4760,7 +5164,9 @@ bool static LoadBlockIndexDB()
             pindexBestInvalid = pindex;
         if (pindex->pprev)
             pindex->BuildSkip();
-        if (pindex->IsValid(BLOCK_VALID_TREE) && (pindexBestHeader == NULL || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
+        // a proof of stake header only counts as best header once its block came in
+        bool fUncheckedStake = pindex->nHeight > Params().LAST_POW_BLOCK() && !(pindex->nStatus & BLOCK_HAVE_DATA);
+        if (!fUncheckedStake && pindex->IsValid(BLOCK_VALID_TREE) && (pindexBestHeader == NULL || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
             pindexBestHeader = pindex;
     }
 
@@ -5354,27 +5760,30 @@ string GetWarnings(string strFor)
 // Messages
 //
 
+static bool IsChainMessage(const string& strCommand)
+{
+    return strCommand == "version" || strCommand == "verack" || strCommand == "addr" || strCommand == "inv" ||
+           strCommand == "getdata" || strCommand == "getblocks" || strCommand == "getheaders" || strCommand == "tx" ||
+           strCommand == "headers" || strCommand == "block" || strCommand == "getaddr" || strCommand == "mempool" ||
+           strCommand == "ping" || strCommand == "pong" || strCommand == "alert" || strCommand == "filterload" ||
+           strCommand == "filteradd" || strCommand == "filterclear" || strCommand == "reject";
+}
 
-bool static AlreadyHave(const CInv& inv)
+// requires LOCK(cs_extensions)
+bool static AlreadyHaveExtension(const CInv& inv)
 {
     switch (inv.type) {
-    case MSG_TX: {
-        bool txInMap = false;
-        txInMap = mempool.exists(inv.hash);
-        return txInMap || mapOrphanTransactions.count(inv.hash) ||
-               pcoinsTip->HaveCoins(inv.hash);
-    }
     case MSG_DSTX:
         return mapObfuscationBroadcastTxes.count(inv.hash);
-    case MSG_BLOCK:
-        return mapBlockIndex.count(inv.hash);
     case MSG_TXLOCK_REQUEST:
         return mapTxLockReq.count(inv.hash) ||
                mapTxLockReqRejected.count(inv.hash);
     case MSG_TXLOCK_VOTE:
         return mapTxLockVote.count(inv.hash);
-    case MSG_SPORK:
+    case MSG_SPORK: {
+        LOCK(cs_mapSporks);
         return mapSporks.count(inv.hash);
+    }
     case MSG_MASTERNODE_WINNER:
         if (masternodePayments.mapMasternodePayeeVotes.count(inv.hash)) {
             masternodeSync.AddedMasternodeWinner(inv.hash);
@@ -5418,6 +5827,36 @@ bool static AlreadyHave(const CInv& inv)
     return true;
 }
 
+bool static AlreadyHave(const CInv& inv)
+{
+    if (inv.type != MSG_TX && inv.type != MSG_BLOCK && inv.IsKnownType()) {
+        // Asking for an item we turn out to have does no harm, waiting for the extension handlers would
+        TRY_LOCK(cs_extensions, lockExtensions);
+        if (!lockExtensions)
+            return false;
+        return AlreadyHaveExtension(inv);
+    }
+
+    switch (inv.type) {
+    case MSG_TX: {
+        bool txInMap = false;
+        txInMap = mempool.exists(inv.hash);
+        return txInMap || mapOrphanTransactions.count(inv.hash) ||
+               pcoinsTip->HaveCoins(inv.hash);
+    }
+    case MSG_BLOCK:
+        return mapBlockIndex.count(inv.hash);
+    }
+    // Don't know what it is, just say we already got one
+    return true;
+}
+
+
+// The block message sent last. A new block is asked for by most peers within moments of each other,
+// and they all get this one message instead of a copy each.
+static CCriticalSection cs_lastBlockMessage;
+static uint256 hashLastBlockMessage;
+static CSendBuffer msgLastBlock;
 
 void static ProcessGetData(CNode* pfrom)
 {
@@ -5425,220 +5864,258 @@ void static ProcessGetData(CNode* pfrom)
 
     vector<CInv> vNotFound;
 
-    LOCK(cs_main);
+    // A requested block is found under the locks and read from disk once they are released. The stored bytes are
+    // sent as they are, and block files are only ever appended to, so reading them needs neither lock
+    CInv invBlock;
+    CDiskBlockPos posBlock;
+    uint256 hashContinueTip = 0;
 
-    while (it != pfrom->vRecvGetData.end()) {
-        // Don't bother if send buffer is too full to respond anyway
-        if (pfrom->nSendSize >= SendBufferSize())
-            break;
+    {
+        LOCK(cs_main);
+        // masternode, budget, spork and SwiftTX items come from the maps of the extension handlers
+        TRY_LOCK(cs_extensions, lockExtensions);
 
-        const CInv& inv = *it;
-        {
-            boost::this_thread::interruption_point();
-            it++;
-
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK) {
-                bool send = false;
-                BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
-                if (mi != mapBlockIndex.end()) {
-                    if (chainActive.Contains(mi->second)) {
-                        send = true;
-                    } else {
-                        // To prevent fingerprinting attacks, only send blocks outside of the active
-                        // chain if they are valid, and no more than a max reorg depth than the best header
-                        // chain we know about.
-                        send = mi->second->IsValid(BLOCK_VALID_SCRIPTS) && (pindexBestHeader != NULL) &&
-                               (chainActive.Height() - mi->second->nHeight < Params().MaxReorganizationDepth());
-                        if (!send) {
-                            LogPrintf("ProcessGetData(): ignoring request from peer=%i for old block that isn't in the main chain\n", pfrom->GetId());
+        while (it != pfrom->vRecvGetData.end()) {
+            // Don't bother if send buffer is too full to respond anyway
+            if (pfrom->nSendSize >= SendBufferSize())
+                break;
+
+            const CInv& inv = *it;
+
+            // Another thread is in the extension handlers, answer from here on in a later round
+            if (!lockExtensions && inv.type != MSG_TX && inv.type != MSG_BLOCK && inv.type != MSG_FILTERED_BLOCK && inv.IsKnownType())
+                break;
+
+            {
+                boost::this_thread::interruption_point();
+                it++;
+
+                if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK) {
+                    bool send = false;
+                    BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
+                    if (mi != mapBlockIndex.end()) {
+                        if (chainActive.Contains(mi->second)) {
+                            send = true;
+                        } else {
+                            // To prevent fingerprinting attacks, only send blocks outside of the active
+                            // chain if they are valid, and no more than a max reorg depth than the best header
+                            // chain we know about.
+                            send = mi->second->IsValid(BLOCK_VALID_SCRIPTS) && (pindexBestHeader != NULL) &&
+                                   (chainActive.Height() - mi->second->nHeight < Params().MaxReorganizationDepth());
+                            if (!send) {
+                                LogPrintf("ProcessGetData(): ignoring request from peer=%i for old block that isn't in the main chain\n", pfrom->GetId());
+                            }
                         }
                     }
-                }
-                // Don't send not-validated blocks
-                if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second))
-                        assert(!"cannot load block from disk");
-                    if (inv.type == MSG_BLOCK)
-                        pfrom->PushMessage("block", block);
-                    else // MSG_FILTERED_BLOCK)
-                    {
-                        LOCK(pfrom->cs_filter);
-                        if (pfrom->pfilter) {
-                            CMerkleBlock merkleBlock(block, *pfrom->pfilter);
-                            pfrom->PushMessage("merkleblock", merkleBlock);
-                            // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
-                            // This avoids hurting performance by pointlessly requiring a round-trip
-                            // Note that there is currently no way for a node to request any single transactions we didnt send here -
-                            // they must either disconnect and retry or request the full block.
-                            // Thus, the protocol spec specified allows for us to provide duplicate txn here,
-                            // however we MUST always provide at least what the remote peer needs
-                            typedef std::pair<unsigned int, uint256> PairType;
-                            BOOST_FOREACH (PairType& pair, merkleBlock.vMatchedTxn)
-                                if (!pfrom->setInventoryKnown.count(CInv(MSG_TX, pair.second)))
-                                    pfrom->PushMessage("tx", block.vtx[pair.first]);
+                    // Don't send not-validated blocks
+                    if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
+                        invBlock = inv;
+                        posBlock = mi->second->GetBlockPos();
+
+                        // Trigger them to send a getblocks request for the next batch of inventory
+                        if (inv.hash == pfrom->hashContinue) {
+                            hashContinueTip = chainActive.Tip()->GetBlockHash();
+                            pfrom->hashContinue = 0;
                         }
-                        // else
-                        // no response
                     }
-
-                    // Trigger them to send a getblocks request for the next batch of inventory
-                    if (inv.hash == pfrom->hashContinue) {
-                        // Bypass PushInventory, this must send even if redundant,
-                        // and we want it right after the last block so they don't
-                        // wait for other stuff first.
-                        vector<CInv> vInv;
-                        vInv.push_back(CInv(MSG_BLOCK, chainActive.Tip()->GetBlockHash()));
-                        pfrom->PushMessage("inv", vInv);
-                        pfrom->hashContinue = 0;
-                    }
-                }
-            } else if (inv.IsKnownType()) {
-                // Send stream from relay memory
-                bool pushed = false;
-                {
-                    LOCK(cs_mapRelay);
-                    map<CInv, CDataStream>::iterator mi = mapRelay.find(inv);
-                    if (mi != mapRelay.end()) {
-                        pfrom->PushMessage(inv.GetCommand(), (*mi).second);
-                        pushed = true;
+                } else if (inv.IsKnownType()) {
+                    // Send stream from relay memory
+                    bool pushed = false;
+                    {
+                        LOCK(cs_mapRelay);
+                        map<CInv, CSendBuffer>::iterator mi = mapRelay.find(inv);
+                        if (mi != mapRelay.end()) {
+                            pfrom->PushSendBuffer((*mi).second);
+                            pushed = true;
+                        }
                     }
-                }
 
-                if (!pushed && inv.type == MSG_TX) {
-                    CTransaction tx;
-                    if (mempool.lookup(inv.hash, tx)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << tx;
-                        pfrom->PushMessage("tx", ss);
-                        pushed = true;
+                    if (!pushed && inv.type == MSG_TX) {
+                        CTransaction tx;
+                        if (mempool.lookup(inv.hash, tx)) {
+                            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                            ss.reserve(1000);
+                            ss << tx;
+                            pfrom->PushMessage("tx", ss);
+                            pushed = true;
+                        }
                     }
-                }
-                if (!pushed && inv.type == MSG_TXLOCK_VOTE) {
-                    if (mapTxLockVote.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << mapTxLockVote[inv.hash];
-                        pfrom->PushMessage("txlvote", ss);
-                        pushed = true;
+                    if (!pushed && inv.type == MSG_TXLOCK_VOTE) {
+                        if (mapTxLockVote.count(inv.hash)) {
+                            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                            ss.reserve(1000);
+                            ss << mapTxLockVote[inv.hash];
+                            pfrom->PushMessage("txlvote", ss);
+                            pushed = true;
+                        }
                     }
-                }
-                if (!pushed && inv.type == MSG_TXLOCK_REQUEST) {
-                    if (mapTxLockReq.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << mapTxLockReq[inv.hash];
-                        pfrom->PushMessage("ix", ss);
-                        pushed = true;
+                    if (!pushed && inv.type == MSG_TXLOCK_REQUEST) {
+                        if (mapTxLockReq.count(inv.hash)) {
+                            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                            ss.reserve(1000);
+                            ss << mapTxLockReq[inv.hash];
+                            pfrom->PushMessage("ix", ss);
+                            pushed = true;
+                        }
                     }
-                }
-                if (!pushed && inv.type == MSG_SPORK) {
-                    if (mapSporks.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << mapSporks[inv.hash];
-                        pfrom->PushMessage("spork", ss);
-                        pushed = true;
+                    if (!pushed && inv.type == MSG_SPORK) {
+                        LOCK(cs_mapSporks);
+                        if (mapSporks.count(inv.hash)) {
+                            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                            ss.reserve(1000);
+                            ss << mapSporks[inv.hash];
+                            pfrom->PushMessage("spork", ss);
+                            pushed = true;
+                        }
                     }
-                }
-                if (!pushed && inv.type == MSG_MASTERNODE_WINNER) {
-                    if (masternodePayments.mapMasternodePayeeVotes.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << masternodePayments.mapMasternodePayeeVotes[inv.hash];
-                        pfrom->PushMessage("mnw", ss);
-                        pushed = true;
+                    if (!pushed && inv.type == MSG_MASTERNODE_WINNER) {
+                        if (masternodePayments.mapMasternodePayeeVotes.count(inv.hash)) {
+                            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                            ss.reserve(1000);
+                            ss << masternodePayments.mapMasternodePayeeVotes[inv.hash];
+                            pfrom->PushMessage("mnw", ss);
+                            pushed = true;
+                        }
                     }
-                }
-                if (!pushed && inv.type == MSG_BUDGET_VOTE) {
-                    if (budget.mapSeenMasternodeBudgetVotes.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << budget.mapSeenMasternodeBudgetVotes[inv.hash];
-                        pfrom->PushMessage("mvote", ss);
-                        pushed = true;
+                    if (!pushed && inv.type == MSG_BUDGET_VOTE) {
+                        if (budget.mapSeenMasternodeBudgetVotes.count(inv.hash)) {
+                            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                            ss.reserve(1000);
+                            ss << budget.mapSeenMasternodeBudgetVotes[inv.hash];
+                            pfrom->PushMessage("mvote", ss);
+                            pushed = true;
+                        }
                     }
-                }
 
-                if (!pushed && inv.type == MSG_BUDGET_PROPOSAL) {
-                    if (budget.mapSeenMasternodeBudgetProposals.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << budget.mapSeenMasternodeBudgetProposals[inv.hash];
-                        pfrom->PushMessage("mprop", ss);
-                        pushed = true;
+                    if (!pushed && inv.type == MSG_BUDGET_PROPOSAL) {
+                        if (budget.mapSeenMasternodeBudgetProposals.count(inv.hash)) {
+                            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                            ss.reserve(1000);
+                            ss << budget.mapSeenMasternodeBudgetProposals[inv.hash];
+                            pfrom->PushMessage("mprop", ss);
+                            pushed = true;
+                        }
                     }
-                }
 
-                if (!pushed && inv.type == MSG_BUDGET_FINALIZED_VOTE) {
-                    if (budget.mapSeenFinalizedBudgetVotes.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << budget.mapSeenFinalizedBudgetVotes[inv.hash];
-                        pfrom->PushMessage("fbvote", ss);
-                        pushed = true;
+                    if (!pushed && inv.type == MSG_BUDGET_FINALIZED_VOTE) {
+                        if (budget.mapSeenFinalizedBudgetVotes.count(inv.hash)) {
+                            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                            ss.reserve(1000);
+                            ss << budget.mapSeenFinalizedBudgetVotes[inv.hash];
+                            pfrom->PushMessage("fbvote", ss);
+                            pushed = true;
+                        }
                     }
-                }
 
-                if (!pushed && inv.type == MSG_BUDGET_FINALIZED) {
-                    if (budget.mapSeenFinalizedBudgets.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << budget.mapSeenFinalizedBudgets[inv.hash];
-                        pfrom->PushMessage("fbs", ss);
-                        pushed = true;
+                    if (!pushed && inv.type == MSG_BUDGET_FINALIZED) {
+                        if (budget.mapSeenFinalizedBudgets.count(inv.hash)) {
+                            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                            ss.reserve(1000);
+                            ss << budget.mapSeenFinalizedBudgets[inv.hash];
+                            pfrom->PushMessage("fbs", ss);
+                            pushed = true;
+                        }
                     }
-                }
 
-                if (!pushed && inv.type == MSG_MASTERNODE_ANNOUNCE) {
-                    if (mnodeman.mapSeenMasternodeBroadcast.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << mnodeman.mapSeenMasternodeBroadcast[inv.hash];
-                        pfrom->PushMessage("mnb", ss);
-                        pushed = true;
+                    if (!pushed && inv.type == MSG_MASTERNODE_ANNOUNCE) {
+                        if (mnodeman.mapSeenMasternodeBroadcast.count(inv.hash)) {
+                            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                            ss.reserve(1000);
+                            ss << mnodeman.mapSeenMasternodeBroadcast[inv.hash];
+                            pfrom->PushMessage("mnb", ss);
+                            pushed = true;
+                        }
                     }
-                }
 
-                if (!pushed && inv.type == MSG_MASTERNODE_PING) {
-                    if (mnodeman.mapSeenMasternodePing.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << mnodeman.mapSeenMasternodePing[inv.hash];
-                        pfrom->PushMessage("mnp", ss);
-                        pushed = true;
+                    if (!pushed && inv.type == MSG_MASTERNODE_PING) {
+                        if (mnodeman.mapSeenMasternodePing.count(inv.hash)) {
+                            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                            ss.reserve(1000);
+                            ss << mnodeman.mapSeenMasternodePing[inv.hash];
+                            pfrom->PushMessage("mnp", ss);
+                            pushed = true;
+                        }
                     }
-                }
 
-                if (!pushed && inv.type == MSG_DSTX) {
-                    if (mapObfuscationBroadcastTxes.count(inv.hash)) {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(1000);
-                        ss << mapObfuscationBroadcastTxes[inv.hash].tx << mapObfuscationBroadcastTxes[inv.hash].vin << mapObfuscationBroadcastTxes[inv.hash].vchSig << mapObfuscationBroadcastTxes[inv.hash].sigTime;
+                    if (!pushed && inv.type == MSG_DSTX) {
+                        if (mapObfuscationBroadcastTxes.count(inv.hash)) {
+                            CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+                            ss.reserve(1000);
+                            ss << mapObfuscationBroadcastTxes[inv.hash].tx << mapObfuscationBroadcastTxes[inv.hash].vin << mapObfuscationBroadcastTxes[inv.hash].vchSig << mapObfuscationBroadcastTxes[inv.hash].sigTime;
 
-                        pfrom->PushMessage("dstx", ss);
-                        pushed = true;
+                            pfrom->PushMessage("dstx", ss);
+                            pushed = true;
+                        }
                     }
-                }
 
 
-                if (!pushed) {
-                    vNotFound.push_back(inv);
+                    if (!pushed) {
+                        vNotFound.push_back(inv);
+                    }
                 }
-            }
 
-            // Track requests for our stuff.
-            g_signals.Inventory(inv.hash);
+                // Track requests for our stuff.
+                g_signals.Inventory(inv.hash);
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
-                break;
+                if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
+                    break;
+            }
         }
     }
 
     pfrom->vRecvGetData.erase(pfrom->vRecvGetData.begin(), it);
 
+    if (!posBlock.IsNull()) {
+        CSendBuffer msgBlock;
+        if (invBlock.type == MSG_BLOCK) {
+            LOCK(cs_lastBlockMessage);
+            if (hashLastBlockMessage == invBlock.hash)
+                msgBlock = msgLastBlock;
+        }
+        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+        if (!msgBlock && !ReadRawBlockFromDisk(ssBlock, posBlock, invBlock.hash))
+            assert(!"cannot load block from disk");
+        if (invBlock.type == MSG_BLOCK) {
+            if (!msgBlock) {
+                msgBlock = CreateSendBuffer("block", ssBlock);
+                LOCK(cs_lastBlockMessage);
+                hashLastBlockMessage = invBlock.hash;
+                msgLastBlock = msgBlock;
+            }
+            pfrom->PushSendBuffer(msgBlock);
+        } else // MSG_FILTERED_BLOCK)
+        {
+            CBlock block;
+            ssBlock >> block;
+            LOCK(pfrom->cs_filter);
+            if (pfrom->pfilter) {
+                CMerkleBlock merkleBlock(block, *pfrom->pfilter);
+                pfrom->PushMessage("merkleblock", merkleBlock);
+                // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
+                // This avoids hurting performance by pointlessly requiring a round-trip
+                // Note that there is currently no way for a node to request any single transactions we didnt send here -
+                // they must either disconnect and retry or request the full block.
+                // Thus, the protocol spec specified allows for us to provide duplicate txn here,
+                // however we MUST always provide at least what the remote peer needs
+                typedef std::pair<unsigned int, uint256> PairType;
+                BOOST_FOREACH (PairType& pair, merkleBlock.vMatchedTxn)
+                    if (!pfrom->setInventoryKnown.count(CInv(MSG_TX, pair.second)))
+                        pfrom->PushMessage("tx", block.vtx[pair.first]);
+            }
+            // else
+            // no response
+        }
+
+        if (hashContinueTip != 0) {
+            // Bypass PushInventory, this must send even if redundant,
+            // and we want it right after the last block so they don't
+            // wait for other stuff first.
+            vector<CInv> vInv;
+            vInv.push_back(CInv(MSG_BLOCK, hashContinueTip));
+            pfrom->PushMessage("inv", vInv);
+        }
+    }
+
     if (!vNotFound.empty()) {
         // Let the peer know that we didn't find what it asked for, so it doesn't
         // have to wait around forever. Currently only SPV clients actually care
@@ -5884,9 +6361,25 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             if (inv.type == MSG_BLOCK) {
                 UpdateBlockAvailability(pfrom->GetId(), inv.hash);
                 if (!fAlreadyHave && !fImporting && !fReindex && !mapBlocksInFlight.count(inv.hash)) {
-                    // Add this to the list of blocks to request
-                    vToFetch.push_back(inv);
-                    LogPrint("net", "getblocks (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->id);
+                    if (IsHeadersFirstPeer(pfrom)) {
+                        // First ask for the headers leading up to the announced block, so its parent is known by the
+                        // time it arrives. Once we're nearly synced the block itself is asked for right away too, to
+                        // save a round trip, otherwise the download window picks it up from the headers.
+                        CBlockIndex* pindexBestKnown = GetBestKnownHeader();
+                        pfrom->PushMessage("getheaders", chainActive.GetLocator(pindexBestKnown), inv.hash);
+                        CNodeState* nodestate = State(pfrom->GetId());
+                        if (chainActive.Tip()->GetBlockTime() > GetAdjustedTime() - Params().TargetSpacing() * 20 &&
+                            nodestate->nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+                            vToFetch.push_back(inv);
+                            // the getdata goes out below, still under this cs_main lock
+                            MarkBlockAsInFlight(pfrom->GetId(), inv.hash);
+                        }
+                        LogPrint("net", "getheaders (%d) %s to peer=%d\n", pindexBestKnown->nHeight, inv.hash.ToString(), pfrom->id);
+                    } else {
+                        // Add this to the list of blocks to request
+                        vToFetch.push_back(inv);
+                        LogPrint("net", "getblocks (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->id);
+                    }
                 }
             }
 
@@ -5923,7 +6416,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     }
 
 
-    else if (strCommand == "getblocks" || strCommand == "getheaders") {
+    else if (strCommand == "getblocks") {
         CBlockLocator locator;
         uint256 hashStop;
         vRecv >> locator >> hashStop;
@@ -5955,7 +6448,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     }
 
 
-    else if (strCommand == "headers" && Params().HeadersFirstSyncingActive()) {
+    else if (strCommand == "getheaders") {
         CBlockLocator locator;
         uint256 hashStop;
         vRecv >> locator >> hashStop;
@@ -6167,6 +6660,9 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
         }
 
+        // hash the whole batch up front and outside of cs_main, AcceptBlockHeader then reuses the memoized hashes
+        PrecomputeBlockHeaderHashes(headers);
+
         LOCK(cs_main);
 
         if (nCount == 0) {
@@ -6181,10 +6677,14 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
                 return error("non-continuous headers sequence");
             }
 
-            /*TODO: this has a CBlock cast on it so that it will compile. There should be a solution for this
-             * before headers are reimplemented on mainnet
-             */
-            if (!AcceptBlockHeader((CBlock)header, state, &pindexLast)) {
+            // the cast gives a block without transactions, which AddToBlockIndex indexes as a header only:
+            // proof of stake by height, with the stake kernel checked once the block itself comes in
+            if (!AcceptBlockHeader((CBlock)header, state, &pindexLast, pfrom->GetId())) {
+                if (state.GetRejectReason() == "headers-ahead") {
+                    // no fault of the peer, ask for the rest once the active chain caught up some
+                    State(pfrom->GetId())->nHeadersWaitHeight = chainActive.Height() + MAX_HEADERS_AHEAD / 2;
+                    break;
+                }
                 int nDoS;
                 if (state.IsInvalid(nDoS)) {
                     if (nDoS > 0)
@@ -6198,7 +6698,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         if (pindexLast)
             UpdateBlockAvailability(pfrom->GetId(), pindexLast->GetBlockHash());
 
-        if (nCount == MAX_HEADERS_RESULTS && pindexLast) {
+        if (nCount == MAX_HEADERS_RESULTS && pindexLast && State(pfrom->GetId())->nHeadersWaitHeight == 0) {
             // Headers message had its maximum size; the peer may have more headers.
             // TODO: optimize: if pindexLast is an ancestor of chainActive.Tip or pindexBestHeader, continue
             // from there instead.
@@ -6217,8 +6717,23 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         CInv inv(MSG_BLOCK, hashBlock);
         LogPrint("net", "received block %s peer=%d\n", inv.hash.ToString(), pfrom->id);
 
+        bool fHavePrev, fHaveBlock;
+        {
+            LOCK(cs_main);
+            fHavePrev = mapBlockIndex.count(block.hashPrevBlock);
+            // with headers-first the header is indexed before the block comes in, only its data tells it's been processed
+            BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+            fHaveBlock = mi != mapBlockIndex.end() && (mi->second->nStatus & BLOCK_HAVE_DATA);
+
+            if (!fHavePrev && IsHeadersFirstPeer(pfrom)) {
+                // an unsolicited block off a chain we don't know the headers of, fetch those and the block after them
+                pfrom->PushMessage("getheaders", chainActive.GetLocator(GetBestKnownHeader()), hashBlock);
+                return true;
+            }
+        }
+
         //sometimes we will be sent their most recent block and its not the one we want, in that case tell where we are
-        if (!mapBlockIndex.count(block.hashPrevBlock)) {
+        if (!fHavePrev) {
             if (find(pfrom->vBlockRequested.begin(), pfrom->vBlockRequested.end(), hashBlock) != pfrom->vBlockRequested.end()) {
                 //we already asked for this block, so lets work backwards and ask for the previous block
                 pfrom->PushMessage("getblocks", chainActive.GetLocator(), block.hashPrevBlock);
@@ -6232,7 +6747,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             pfrom->AddInventoryKnown(inv);
 
             CValidationState state;
-            if (!mapBlockIndex.count(block.GetHash())) {
+            if (!fHaveBlock) {
                 ProcessNewBlock(state, pfrom, &block);
                 int nDoS;
                 if(state.IsInvalid(nDoS)) {
@@ -6258,7 +6773,10 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     // Making users (which are behind NAT and can only make outgoing connections) ignore
     // getaddr message mitigates the attack.
     else if ((strCommand == "getaddr") && (pfrom->fInbound)) {
-        pfrom->vAddrToSend.clear();
+        {
+            LOCK(pfrom->cs_addrKnown);
+            pfrom->vAddrToSend.clear();
+        }
         vector<CAddress> vAddr = addrman.GetAddr();
         BOOST_FOREACH (const CAddress& addr, vAddr)
             pfrom->PushAddress(addr);
@@ -6501,6 +7019,100 @@ int ActiveProtocol()
     return MIN_PEER_PROTO_VERSION_BEFORE_ENFORCEMENT;
 }
 
+/**
+ * Recover the signers of the masternode broadcasts, pings, payment and budget votes and SwiftX
+ * votes waiting in a peer's receive queue as one parallel batch. During mnsync these arrive by
+ * the thousand; the handlers still verify every message, but find the key already recovered
+ * instead of doing the curve arithmetic one message at a time on this thread. Only messages
+ * that would survive the handlers' cheap checks (not seen before, sane timestamp, signed by a
+ * masternode we know) are queued, so a peer cannot make us recover keys for free or flush the
+ * recovered key cache. Called from ProcessMessages, which holds cs_vRecvMsg.
+ */
+static void PrecomputeMasternodeSignatures(CNode* pfrom)
+{
+    if (fLiteMode || !masternodeSync.IsBlockchainSynced())
+        return;
+
+    // the seen maps belong to the extension handlers; if they are busy, leave the messages
+    // unflagged and try again on the next round
+    TRY_LOCK(cs_extensions, lockExtensions);
+    if (!lockExtensions)
+        return;
+
+    // messages are flagged in order, so only the tail of the queue can be new
+    std::deque<CNetMessage>::iterator it = pfrom->vRecvMsg.end();
+    while (it != pfrom->vRecvMsg.begin() && !(it - 1)->fSignaturesQueued)
+        --it;
+
+    std::vector<CMessageSignatureCheck> vChecks;
+    for (; it != pfrom->vRecvMsg.end() && it->complete(); ++it) {
+        CNetMessage& msg = *it;
+        msg.fSignaturesQueued = true;
+
+        string strCommand = msg.hdr.GetCommand();
+        try {
+            CDataStream vRecv(msg.vRecv);
+            if (strCommand == "mnb") {
+                CMasternodeBroadcast mnb;
+                vRecv >> mnb;
+                // a broadcast may announce a masternode we do not know yet
+                if (mnodeman.mapSeenMasternodeBroadcast.count(mnb.GetHash()) ||
+                    mnb.sigTime > GetAdjustedTime() + 60 * 60)
+                    continue;
+                vChecks.push_back(CMessageSignatureCheck(mnb.GetStrMessage(), mnb.sig));
+                if (mnb.lastPing != CMasternodePing() && !mnodeman.mapSeenMasternodePing.count(mnb.lastPing.GetHash()))
+                    vChecks.push_back(CMessageSignatureCheck(mnb.lastPing.GetStrMessage(), mnb.lastPing.vchSig));
+            } else if (strCommand == "mnp") {
+                CMasternodePing mnp;
+                vRecv >> mnp;
+                if (mnodeman.mapSeenMasternodePing.count(mnp.GetHash()) ||
+                    mnp.sigTime > GetAdjustedTime() + 60 * 60 ||
+                    mnp.sigTime <= GetAdjustedTime() - 60 * 60 ||
+                    mnodeman.Find(mnp.vin) == NULL)
+                    continue;
+                vChecks.push_back(CMessageSignatureCheck(mnp.GetStrMessage(), mnp.vchSig));
+            } else if (strCommand == "mnw") {
+                CMasternodePaymentWinner winner;
+                vRecv >> winner;
+                {
+                    LOCK(cs_mapMasternodePayeeVotes);
+                    if (masternodePayments.mapMasternodePayeeVotes.count(winner.GetHash()))
+                        continue;
+                }
+                if (mnodeman.Find(winner.vinMasternode) == NULL)
+                    continue;
+                vChecks.push_back(CMessageSignatureCheck(winner.GetStrMessage(), winner.vchSig));
+            } else if (strCommand == "mvote") {
+                CBudgetVote vote;
+                vRecv >> vote;
+                if (budget.mapSeenMasternodeBudgetVotes.count(vote.GetHash()) ||
+                    vote.nTime > GetTime() + 60 * 60 ||
+                    mnodeman.Find(vote.vin) == NULL)
+                    continue;
+                vChecks.push_back(CMessageSignatureCheck(vote.GetStrMessage(), vote.vchSig));
+            } else if (strCommand == "fbvote") {
+                CFinalizedBudgetVote vote;
+                vRecv >> vote;
+                if (budget.mapSeenFinalizedBudgetVotes.count(vote.GetHash()) ||
+                    mnodeman.Find(vote.vin) == NULL)
+                    continue;
+                vChecks.push_back(CMessageSignatureCheck(vote.GetStrMessage(), vote.vchSig));
+            } else if (strCommand == "txlvote") {
+                CConsensusVote vote;
+                vRecv >> vote;
+                if (mapTxLockVote.count(vote.GetHash()) ||
+                    mnodeman.Find(vote.vinMasternode) == NULL)
+                    continue;
+                vChecks.push_back(CMessageSignatureCheck(vote.GetStrMessage(), vote.vchMasterNodeSignature));
+            }
+        } catch (std::exception&) {
+            // malformed messages are reported when ProcessMessage gets to them
+        }
+    }
+
+    obfuScationSigner.PrecomputeSignatures(vChecks);
+}
+
 // requires LOCK(cs_vRecvMsg)
 bool ProcessMessages(CNode* pfrom)
 {
@@ -6523,6 +7135,8 @@ bool ProcessMessages(CNode* pfrom)
     // this maintains the order of responses
     if (!pfrom->vRecvGetData.empty()) return fOk;
 
+    PrecomputeMasternodeSignatures(pfrom);
+
     std::deque<CNetMessage>::iterator it = pfrom->vRecvMsg.begin();
     while (!pfrom->fDisconnect && it != pfrom->vRecvMsg.end()) {
         // Don't bother if send buffer is too full to respond anyway
@@ -6541,6 +7155,15 @@ bool ProcessMessages(CNode* pfrom)
         if (!msg.complete())
             break;
 
+        // Rather than wait while another thread is in the extension handlers, leave this peer's
+        // queue as it is and come back to it on a later round (see cs_extensions)
+        boost::scoped_ptr<CCriticalBlock> plockExtensions;
+        if (!IsChainMessage(msg.hdr.GetCommand())) {
+            plockExtensions.reset(new CCriticalBlock(cs_extensions, "cs_extensions", __FILE__, __LINE__, true));
+            if (!*plockExtensions)
+                break;
+        }
+
         // at this point, any failure means we can delete the current message
         it++;
 
@@ -6657,8 +7280,10 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
             LOCK(cs_vNodes);
             BOOST_FOREACH (CNode* pnode, vNodes) {
                 // Periodically clear setAddrKnown to allow refresh broadcasts
-                if (nLastRebroadcast)
+                if (nLastRebroadcast) {
+                    LOCK(pnode->cs_addrKnown);
                     pnode->setAddrKnown.clear();
+                }
 
                 // Rebroadcast our address
                 AdvertizeLocal(pnode);
@@ -6671,6 +7296,7 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         // Message: addr
         //
         if (fSendTrickle) {
+            LOCK(pto->cs_addrKnown);
             vector<CAddress> vAddr;
             vAddr.reserve(pto->vAddrToSend.size());
             BOOST_FOREACH (const CAddress& addr, pto->vAddrToSend) {
@@ -6717,13 +7343,24 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
             if (nSyncStarted == 0 || pindexBestHeader->GetBlockTime() > GetAdjustedTime() - 6 * 60 * 60) { // NOTE: was "close to today" and 24h in Bitcoin
                 state.fSyncStarted = true;
                 nSyncStarted++;
-                //CBlockIndex *pindexStart = pindexBestHeader->pprev ? pindexBestHeader->pprev : pindexBestHeader;
-                //LogPrint("net", "initial getheaders (%d) to peer=%d (startheight:%d)\n", pindexStart->nHeight, pto->id, pto->nStartingHeight);
-                //pto->PushMessage("getheaders", chainActive.GetLocator(pindexStart), uint256(0));
-                pto->PushMessage("getblocks", chainActive.GetLocator(chainActive.Tip()), uint256(0));
+                if (IsHeadersFirstPeer(pto)) {
+                    CBlockIndex* pindexStart = pindexBestHeader->pprev ? pindexBestHeader->pprev : pindexBestHeader;
+                    LogPrint("net", "initial getheaders (%d) to peer=%d (startheight:%d)\n", pindexStart->nHeight, pto->id, pto->nStartingHeight);
+                    pto->PushMessage("getheaders", chainActive.GetLocator(pindexStart), uint256(0));
+                } else {
+                    pto->PushMessage("getblocks", chainActive.GetLocator(chainActive.Tip()), uint256(0));
+                }
             }
         }
 
+        // Carry on with the headers held back for being too far ahead of the active chain
+        if (state.nHeadersWaitHeight != 0 && chainActive.Height() >= state.nHeadersWaitHeight) {
+            state.nHeadersWaitHeight = 0;
+            CBlockIndex* pindexStart = state.pindexBestKnownBlock ? state.pindexBestKnownBlock : chainActive.Tip();
+            LogPrint("net", "more getheaders (%d) to peer=%d\n", pindexStart->nHeight, pto->id);
+            pto->PushMessage("getheaders", chainActive.GetLocator(pindexStart), uint256(0));
+        }
+
         // Resend wallet transactions that haven't gotten in a block yet
         // Except during reindex, importing and IBD, when old wallet
         // transactions become unconfirmed and spams other nodes.
@@ -11,6 +11,7 @@
 #include "masternode-budget.h"
 #include "masternode-sync.h"
 #include "masternode.h"
+#include "masternodedb.h"
 #include "masternodeman.h"
 #include "obfuscation.h"
 #include "util.h"
@@ -252,39 +253,6 @@ CBudgetDB::CBudgetDB()
     strMagicMessage = "MasternodeBudget";
 }
 
-bool CBudgetDB::Write(const CBudgetManager& objToSave)
-{
-    LOCK(objToSave.cs);
-
-    int64_t nStart = GetTimeMillis();
-
-    // serialize, checksum data up to that point, then append checksum
-    CDataStream ssObj(SER_DISK, CLIENT_VERSION);
-    ssObj << strMagicMessage;                   // masternode cache file specific magic message
-    ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
-    ssObj << objToSave;
-    uint256 hash = Hash(ssObj.begin(), ssObj.end());
-    ssObj << hash;
-
-    // open output file, and associate with CAutoFile
-    FILE* file = fopen(pathDB.string().c_str(), "wb");
-    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathDB.string());
-
-    // Write and commit header, data
-    try {
-        fileout << ssObj;
-    } catch (std::exception& e) {
-        return error("%s : Serialize or I/O error - %s", __func__, e.what());
-    }
-    fileout.fclose();
-
-    LogPrint("masternode","Written info to budget.dat  %dms\n", GetTimeMillis() - nStart);
-
-    return true;
-}
-
 CBudgetDB::ReadResult CBudgetDB::Read(CBudgetManager& objToLoad, bool fDryRun)
 {
     LOCK(objToLoad.cs);
@@ -372,27 +340,18 @@ CBudgetDB::ReadResult CBudgetDB::Read(CBudgetManager& objToLoad, bool fDryRun)
 
 void DumpBudgets()
 {
-    int64_t nStart = GetTimeMillis();
+    if (!pMasternodeStateDB)
+        return;
 
-    CBudgetDB budgetdb;
-    CBudgetManager tempBudget;
-
-    LogPrint("masternode","Verifying budget.dat format...\n");
-    CBudgetDB::ReadResult readResult = budgetdb.Read(tempBudget, true);
-    // there was an error and it was not an error on file opening => do not proceed
-    if (readResult == CBudgetDB::FileError)
-        LogPrint("masternode","Missing budgets file - budget.dat, will try to recreate\n");
-    else if (readResult != CBudgetDB::Ok) {
-        LogPrint("masternode","Error reading budget.dat: ");
-        if (readResult == CBudgetDB::IncorrectFormat)
-            LogPrint("masternode","magic is ok but data has invalid format, will try to recreate\n");
-        else {
-            LogPrint("masternode","file format is unknown or invalid, please fix it manually\n");
-            return;
-        }
+    int64_t nStart = GetTimeMillis();
+    try {
+        if (!budget.WriteState(*pMasternodeStateDB))
+            error("%s : Failed to write the budgets", __func__);
+        else
+            pMasternodeStateDB->MarkWritten(CMasternodeStateDB::STATE_BUDGETS);
+    } catch (std::exception& e) {
+        error("%s : Serialize or I/O error - %s", __func__, e.what());
     }
-    LogPrint("masternode","Writting info to budget.dat...\n");
-    budgetdb.Write(budget);
 
     LogPrint("masternode","Budget dump finished  %dms\n", GetTimeMillis() - nStart);
 }
@@ -1336,6 +1295,7 @@ CBudgetProposal::CBudgetProposal()
     nAmount = 0;
     nTime = 0;
     fValid = true;
+    RecountVotes();
 }
 
 CBudgetProposal::CBudgetProposal(std::string strProposalNameIn, std::string strURLIn, int nBlockStartIn, int nBlockEndIn, CScript addressIn, CAmount nAmountIn, uint256 nFeeTXHashIn)
@@ -1348,6 +1308,7 @@ CBudgetProposal::CBudgetProposal(std::string strProposalNameIn, std::string strU
     nAmount = nAmountIn;
     nFeeTXHash = nFeeTXHashIn;
     fValid = true;
+    RecountVotes();
 }
 
 CBudgetProposal::CBudgetProposal(const CBudgetProposal& other)
@@ -1362,6 +1323,7 @@ CBudgetProposal::CBudgetProposal(const CBudgetProposal& other)
     nFeeTXHash = other.nFeeTXHash;
     mapVotes = other.mapVotes;
     fValid = true;
+    RecountVotes();
 }
 
 bool CBudgetProposal::IsValid(std::string& strError, bool fCheckCollateral)
@@ -1468,36 +1430,74 @@ bool CBudgetProposal::AddOrUpdateVote(CBudgetVote& vote, std::string& strError)
         return false;
     }
 
-    mapVotes[hash] = vote;
+    std::map<uint256, CBudgetVote>::iterator itOld = mapVotes.find(hash);
+    if (itOld != mapVotes.end()) {
+        CountVote(itOld->second, -1);
+        itOld->second = vote;
+    } else {
+        mapVotes.insert(make_pair(hash, vote));
+    }
+    CountVote(vote, 1);
+    // have the next CleanAndRemove(false) look at the votes again if this one wouldn't pass it
+    if (!vote.fValid || mnodeman.Find(vote.vin) == NULL) nVotesCheckedIndexVersion = -1;
     LogPrint("mnbudget", "CBudgetProposal::AddOrUpdateVote - %s %s\n", strAction.c_str(), vote.GetHash().ToString().c_str());
 
     return true;
 }
 
-// If masternode voted for a proposal, but is now invalid -- remove the vote
-void CBudgetProposal::CleanAndRemove(bool fSignatureCheck)
+void CBudgetProposal::CountVote(const CBudgetVote& vote, int nDelta)
 {
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
+    // votes with an unknown nVote are stored but never counted
+    if (vote.nVote < VOTE_ABSTAIN || vote.nVote > VOTE_NO) return;
 
+    nVoteCount[vote.nVote] += nDelta;
+    if (vote.fValid) nValidVoteCount[vote.nVote] += nDelta;
+}
+
+void CBudgetProposal::RecountVotes()
+{
+    for (int i = 0; i < 3; i++) {
+        nVoteCount[i] = 0;
+        nValidVoteCount[i] = 0;
+    }
+    nVotesCheckedIndexVersion = -1;
+
+    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
     while (it != mapVotes.end()) {
-        (*it).second.fValid = (*it).second.SignatureValid(fSignatureCheck);
+        CountVote((*it).second, 1);
         ++it;
     }
 }
 
-double CBudgetProposal::GetRatio()
+// If masternode voted for a proposal, but is now invalid -- remove the vote
+void CBudgetProposal::CleanAndRemove(bool fSignatureCheck)
 {
-    int yeas = 0;
-    int nays = 0;
+    // without signature checks a vote is valid as long as its masternode is known, nothing to
+    // redo when the masternode list didn't change since the last pass. Votes added since were
+    // checked against the same list when they came in
+    int nIndexVersion = mnodeman.GetIndexVersion();
+    if (!fSignatureCheck && nVotesCheckedIndexVersion == nIndexVersion) return;
 
     std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
 
     while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_YES) yeas++;
-        if ((*it).second.nVote == VOTE_NO) nays++;
+        bool fVoteValid = (*it).second.SignatureValid(fSignatureCheck);
+        if (fVoteValid != (*it).second.fValid) {
+            CountVote((*it).second, -1);
+            (*it).second.fValid = fVoteValid;
+            CountVote((*it).second, 1);
+        }
         ++it;
     }
 
+    nVotesCheckedIndexVersion = fSignatureCheck ? -1 : nIndexVersion;
+}
+
+double CBudgetProposal::GetRatio()
+{
+    int yeas = nVoteCount[VOTE_YES];
+    int nays = nVoteCount[VOTE_NO];
+
     if (yeas + nays == 0) return 0.0f;
 
     return ((double)(yeas) / (double)(yeas + nays));
@@ -1505,41 +1505,17 @@ double CBudgetProposal::GetRatio()
 
 int CBudgetProposal::GetYeas()
 {
-    int ret = 0;
-
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_YES && (*it).second.fValid) ret++;
-        ++it;
-    }
-
-    return ret;
+    return nValidVoteCount[VOTE_YES];
 }
 
 int CBudgetProposal::GetNays()
 {
-    int ret = 0;
-
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_NO && (*it).second.fValid) ret++;
-        ++it;
-    }
-
-    return ret;
+    return nValidVoteCount[VOTE_NO];
 }
 
 int CBudgetProposal::GetAbstains()
 {
-    int ret = 0;
-
-    std::map<uint256, CBudgetVote>::iterator it = mapVotes.begin();
-    while (it != mapVotes.end()) {
-        if ((*it).second.nVote == VOTE_ABSTAIN && (*it).second.fValid) ret++;
-        ++it;
-    }
-
-    return ret;
+    return nValidVoteCount[VOTE_ABSTAIN];
 }
 
 int CBudgetProposal::GetBlockStartCycle()
@@ -1639,6 +1615,11 @@ void CBudgetVote::Relay()
     RelayInv(inv);
 }
 
+std::string CBudgetVote::GetStrMessage() const
+{
+    return vin.prevout.ToStringShort() + nProposalHash.ToString() + boost::lexical_cast<std::string>(nVote) + boost::lexical_cast<std::string>(nTime);
+}
+
 bool CBudgetVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
 {
     // Choose coins to use
@@ -1646,7 +1627,7 @@ bool CBudgetVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
     CKey keyCollateralAddress;
 
     std::string errorMessage;
-    std::string strMessage = vin.prevout.ToStringShort() + nProposalHash.ToString() + boost::lexical_cast<std::string>(nVote) + boost::lexical_cast<std::string>(nTime);
+    std::string strMessage = GetStrMessage();
 
     if (!obfuScationSigner.SignMessage(strMessage, errorMessage, vchSig, keyMasternode)) {
         LogPrint("masternode","CBudgetVote::Sign - Error upon calling SignMessage");
@@ -1664,7 +1645,7 @@ bool CBudgetVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
 bool CBudgetVote::SignatureValid(bool fSignatureCheck)
 {
     std::string errorMessage;
-    std::string strMessage = vin.prevout.ToStringShort() + nProposalHash.ToString() + boost::lexical_cast<std::string>(nVote) + boost::lexical_cast<std::string>(nTime);
+    std::string strMessage = GetStrMessage();
 
     CMasternode* pmn = mnodeman.Find(vin);
 
@@ -2083,6 +2064,11 @@ void CFinalizedBudgetVote::Relay()
     RelayInv(inv);
 }
 
+std::string CFinalizedBudgetVote::GetStrMessage() const
+{
+    return vin.prevout.ToStringShort() + nBudgetHash.ToString() + boost::lexical_cast<std::string>(nTime);
+}
+
 bool CFinalizedBudgetVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
 {
     // Choose coins to use
@@ -2090,7 +2076,7 @@ bool CFinalizedBudgetVote::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
     CKey keyCollateralAddress;
 
     std::string errorMessage;
-    std::string strMessage = vin.prevout.ToStringShort() + nBudgetHash.ToString() + boost::lexical_cast<std::string>(nTime);
+    std::string strMessage = GetStrMessage();
 
     if (!obfuScationSigner.SignMessage(strMessage, errorMessage, vchSig, keyMasternode)) {
         LogPrint("masternode","CFinalizedBudgetVote::Sign - Error upon calling SignMessage");
@@ -2109,7 +2095,7 @@ bool CFinalizedBudgetVote::SignatureValid(bool fSignatureCheck)
 {
     std::string errorMessage;
 
-    std::string strMessage = vin.prevout.ToStringShort() + nBudgetHash.ToString() + boost::lexical_cast<std::string>(nTime);
+    std::string strMessage = GetStrMessage();
 
     CMasternode* pmn = mnodeman.Find(vin);
 
@@ -2128,6 +2114,40 @@ bool CFinalizedBudgetVote::SignatureValid(bool fSignatureCheck)
     return true;
 }
 
+bool CBudgetManager::WriteState(CMasternodeStateDB& db)
+{
+    LOCK(cs);
+
+    CLevelDBBatch batch;
+    db.SyncRecords(batch, 'r', mapProposals, false);
+    db.SyncRecords(batch, 'f', mapFinalizedBudgets, false);
+    db.SyncRecords(batch, 'o', mapOrphanMasternodeBudgetVotes, false);
+    db.SyncRecords(batch, 'O', mapOrphanFinalizedBudgetVotes, false);
+    return db.WriteBatch(batch, true);
+}
+
+bool CBudgetManager::ReadState(CMasternodeStateDB& db)
+{
+    int64_t nStart = GetTimeMillis();
+    {
+        LOCK(cs);
+
+        if (!db.ReadRecords('r', mapProposals, false) ||
+            !db.ReadRecords('f', mapFinalizedBudgets, false) ||
+            !db.ReadRecords('o', mapOrphanMasternodeBudgetVotes, false) ||
+            !db.ReadRecords('O', mapOrphanFinalizedBudgetVotes, false))
+            return error("%s : Failed to read the budgets", __func__);
+    }
+
+    LogPrint("masternode","Loaded budgets  %dms\n", GetTimeMillis() - nStart);
+    LogPrint("masternode","  %s\n", ToString());
+    LogPrint("masternode","Budget manager - cleaning....\n");
+    CheckAndRemove();
+    LogPrint("masternode","Budget manager - result:\n");
+    LogPrint("masternode","  %s\n", ToString());
+    return true;
+}
+
 std::string CBudgetManager::ToString() const
 {
     std::ostringstream info;
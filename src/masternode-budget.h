@@ -21,6 +21,7 @@ using namespace std;
 extern CCriticalSection cs_budget;
 
 class CBudgetManager;
+class CMasternodeStateDB;
 class CFinalizedBudgetBroadcast;
 class CFinalizedBudget;
 class CBudgetProposal;
@@ -67,6 +68,7 @@ public:
 
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
     bool SignatureValid(bool fSignatureCheck);
+    std::string GetStrMessage() const;
     void Relay();
 
     std::string GetVoteString()
@@ -119,6 +121,7 @@ public:
 
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
     bool SignatureValid(bool fSignatureCheck);
+    std::string GetStrMessage() const;
     void Relay();
 
     uint256 GetHash()
@@ -142,7 +145,7 @@ public:
     }
 };
 
-/** Save Budget Manager (budget.dat)
+/** Legacy Budget Manager data (budget.dat), only read to import it into the masternode state database
  */
 class CBudgetDB
 {
@@ -162,7 +165,6 @@ public:
     };
 
     CBudgetDB();
-    bool Write(const CBudgetManager& objToSave);
     ReadResult Read(CBudgetManager& objToLoad, bool fDryRun = false);
 };
 
@@ -255,6 +257,11 @@ public:
     void CheckAndRemove();
     std::string ToString() const;
 
+    /// Write what changed since the last dump to the masternode state database
+    bool WriteState(CMasternodeStateDB& db);
+    /// Load the budgets written by WriteState and clean them
+    bool ReadState(CMasternodeStateDB& db);
+
 
     ADD_SERIALIZE_METHODS;
 
@@ -456,6 +463,18 @@ private:
     mutable CCriticalSection cs;
     CAmount nAlloted;
 
+    // votes in mapVotes by nVote, all of them and only the valid ones, kept up to date by
+    // AddOrUpdateVote and CleanAndRemove so the counts don't walk every vote
+    int nVoteCount[3];
+    int nValidVoteCount[3];
+    // masternode index version the votes were last checked against by CleanAndRemove(false), -1 if never
+    int nVotesCheckedIndexVersion;
+
+    void CountVote(const CBudgetVote& vote, int nDelta);
+
+protected:
+    void RecountVotes();
+
 public:
     bool fValid;
     std::string strProposalName;
@@ -547,6 +566,8 @@ public:
 
         //for saving to the serialized db
         READWRITE(mapVotes);
+        if (ser_action.ForRead())
+            RecountVotes();
     }
 };
 
@@ -575,6 +596,8 @@ public:
         swap(first.nTime, second.nTime);
         swap(first.nFeeTXHash, second.nFeeTXHash);
         first.mapVotes.swap(second.mapVotes);
+        first.RecountVotes();
+        second.RecountVotes();
     }
 
     CBudgetProposalBroadcast& operator=(CBudgetProposalBroadcast from)
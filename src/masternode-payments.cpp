@@ -7,6 +7,7 @@
 #include "addrman.h"
 #include "masternode-budget.h"
 #include "masternode-sync.h"
+#include "masternodedb.h"
 #include "masternodeman.h"
 #include "obfuscation.h"
 #include "spork.h"
@@ -33,37 +34,6 @@ CMasternodePaymentDB::CMasternodePaymentDB()
     strMagicMessage = "MasternodePayments";
 }
 
-bool CMasternodePaymentDB::Write(const CMasternodePayments& objToSave)
-{
-    int64_t nStart = GetTimeMillis();
-
-    // serialize, checksum data up to that point, then append checksum
-    CDataStream ssObj(SER_DISK, CLIENT_VERSION);
-    ssObj << strMagicMessage;                   // masternode cache file specific magic message
-    ssObj << FLATDATA(Params().MessageStart()); // network specific magic number
-    ssObj << objToSave;
-    uint256 hash = Hash(ssObj.begin(), ssObj.end());
-    ssObj << hash;
-
-    // open output file, and associate with CAutoFile
-    FILE* file = fopen(pathDB.string().c_str(), "wb");
-    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathDB.string());
-
-    // Write and commit header, data
-    try {
-        fileout << ssObj;
-    } catch (std::exception& e) {
-        return error("%s : Serialize or I/O error - %s", __func__, e.what());
-    }
-    fileout.fclose();
-
-    LogPrint("masternode","Written info to mnpayments.dat  %dms\n", GetTimeMillis() - nStart);
-
-    return true;
-}
-
 CMasternodePaymentDB::ReadResult CMasternodePaymentDB::Read(CMasternodePayments& objToLoad, bool fDryRun)
 {
     int64_t nStart = GetTimeMillis();
@@ -148,29 +118,20 @@ CMasternodePaymentDB::ReadResult CMasternodePaymentDB::Read(CMasternodePayments&
 
 void DumpMasternodePayments()
 {
-    int64_t nStart = GetTimeMillis();
+    if (!pMasternodeStateDB)
+        return;
 
-    CMasternodePaymentDB paymentdb;
-    CMasternodePayments tempPayments;
-
-    LogPrint("masternode","Verifying mnpayments.dat format...\n");
-    CMasternodePaymentDB::ReadResult readResult = paymentdb.Read(tempPayments, true);
-    // there was an error and it was not an error on file opening => do not proceed
-    if (readResult == CMasternodePaymentDB::FileError)
-        LogPrint("masternode","Missing budgets file - mnpayments.dat, will try to recreate\n");
-    else if (readResult != CMasternodePaymentDB::Ok) {
-        LogPrint("masternode","Error reading mnpayments.dat: ");
-        if (readResult == CMasternodePaymentDB::IncorrectFormat)
-            LogPrint("masternode","magic is ok but data has invalid format, will try to recreate\n");
-        else {
-            LogPrint("masternode","file format is unknown or invalid, please fix it manually\n");
-            return;
-        }
+    int64_t nStart = GetTimeMillis();
+    try {
+        if (!masternodePayments.WriteState(*pMasternodeStateDB))
+            error("%s : Failed to write the masternode payment votes", __func__);
+        else
+            pMasternodeStateDB->MarkWritten(CMasternodeStateDB::STATE_PAYMENTS);
+    } catch (std::exception& e) {
+        error("%s : Serialize or I/O error - %s", __func__, e.what());
     }
-    LogPrint("masternode","Writting info to mnpayments.dat...\n");
-    paymentdb.Write(masternodePayments);
 
-    LogPrint("masternode","Budget dump finished  %dms\n", GetTimeMillis() - nStart);
+    LogPrint("masternode","Masternode payments dump finished  %dms\n", GetTimeMillis() - nStart);
 }
 
 bool IsBlockValueValid(const CBlock& block, CAmount nExpectedValue, CAmount nMinted)
@@ -425,14 +386,19 @@ void CMasternodePayments::ProcessMessageMasternodePayments(CNode* pfrom, std::st
     }
 }
 
+std::string CMasternodePaymentWinner::GetStrMessage() const
+{
+    return vinMasternode.prevout.ToStringShort() +
+           boost::lexical_cast<std::string>(nBlockHeight) +
+           payee.ToString();
+}
+
 bool CMasternodePaymentWinner::Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode)
 {
     std::string errorMessage;
     std::string strMasterNodeSignMessage;
 
-    std::string strMessage = vinMasternode.prevout.ToStringShort() +
-                             boost::lexical_cast<std::string>(nBlockHeight) +
-                             payee.ToString();
+    std::string strMessage = GetStrMessage();
 
     if (!obfuScationSigner.SignMessage(strMessage, errorMessage, vchSig, keyMasternode)) {
         LogPrint("masternode","CMasternodePing::Sign() - Error: %s\n", errorMessage.c_str());
@@ -507,13 +473,65 @@ bool CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerI
             CMasternodeBlockPayees blockPayees(winnerIn.nBlockHeight);
             mapMasternodeBlocks[winnerIn.nBlockHeight] = blockPayees;
         }
-    }
 
-    mapMasternodeBlocks[winnerIn.nBlockHeight].AddPayee(winnerIn.payee, 1);
+        mapMasternodeBlocks[winnerIn.nBlockHeight].AddPayee(winnerIn.payee, 1);
+        if (mapMasternodeBlocks[winnerIn.nBlockHeight].HasPayeeWithVotes(winnerIn.payee, 2))
+            IndexBlockPayee(winnerIn.nBlockHeight, winnerIn.payee);
+    }
 
     return true;
 }
 
+void CMasternodePayments::IndexBlockPayee(int nBlockHeight, const CScript& payee)
+{
+    AssertLockHeld(cs_mapMasternodeBlocks);
+    mapPayeePaidHeights[payee].insert(nBlockHeight);
+}
+
+void CMasternodePayments::UnindexBlockPayees(int nBlockHeight)
+{
+    AssertLockHeld(cs_mapMasternodeBlocks);
+    std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.find(nBlockHeight);
+    if (it == mapMasternodeBlocks.end())
+        return;
+
+    LOCK(cs_vecPayments);
+    BOOST_FOREACH (const CMasternodePayee& payee, it->second.vecPayments) {
+        std::map<CScript, std::set<int> >::iterator itPaid = mapPayeePaidHeights.find(payee.scriptPubKey);
+        if (itPaid == mapPayeePaidHeights.end())
+            continue;
+        itPaid->second.erase(nBlockHeight);
+        if (itPaid->second.empty())
+            mapPayeePaidHeights.erase(itPaid);
+    }
+}
+
+void CMasternodePayments::RebuildPaidIndex()
+{
+    LOCK2(cs_mapMasternodeBlocks, cs_vecPayments);
+    mapPayeePaidHeights.clear();
+    for (std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.begin(); it != mapMasternodeBlocks.end(); ++it) {
+        BOOST_FOREACH (const CMasternodePayee& payee, it->second.vecPayments) {
+            if (payee.nVotes >= 2)
+                IndexBlockPayee(it->first, payee.scriptPubKey);
+        }
+    }
+}
+
+int CMasternodePayments::GetLastPaidHeight(const CScript& payee, int nHeightMax)
+{
+    LOCK(cs_mapMasternodeBlocks);
+    std::map<CScript, std::set<int> >::const_iterator it = mapPayeePaidHeights.find(payee);
+    if (it == mapPayeePaidHeights.end())
+        return 0;
+
+    // votes for blocks above the tip are already in, they are not payments yet
+    std::set<int>::const_iterator itHeight = it->second.upper_bound(nHeightMax);
+    if (itHeight == it->second.begin())
+        return 0;
+    return *(--itHeight);
+}
+
 bool CMasternodeBlockPayees::IsTransactionValid(const CTransaction& txNew)
 {
     LOCK(cs_vecPayments);
@@ -641,6 +659,7 @@ void CMasternodePayments::CleanPaymentList()
             LogPrint("mnpayments", "CMasternodePayments::CleanPaymentList - Removing old Masternode payment - block %d\n", winner.nBlockHeight);
             masternodeSync.mapSeenSyncMNW.erase((*it).first);
             mapMasternodePayeeVotes.erase(it++);
+            UnindexBlockPayees(winner.nBlockHeight);
             mapMasternodeBlocks.erase(winner.nBlockHeight);
         } else {
             ++it;
@@ -764,9 +783,7 @@ bool CMasternodePaymentWinner::SignatureValid()
     CMasternode* pmn = mnodeman.Find(vinMasternode);
 
     if (pmn != NULL) {
-        std::string strMessage = vinMasternode.prevout.ToStringShort() +
-                                 boost::lexical_cast<std::string>(nBlockHeight) +
-                                 payee.ToString();
+        std::string strMessage = GetStrMessage();
 
         std::string errorMessage = "";
         if (!obfuScationSigner.VerifyMessage(pmn->pubKeyMasternode, vchSig, strMessage, errorMessage)) {
@@ -806,6 +823,37 @@ void CMasternodePayments::Sync(CNode* node, int nCountNeeded)
     node->PushMessage("ssc", MASTERNODE_SYNC_MNW, nInvCount);
 }
 
+bool CMasternodePayments::WriteState(CMasternodeStateDB& db)
+{
+    LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
+
+    CLevelDBBatch batch;
+    db.SyncRecords(batch, 'w', mapMasternodePayeeVotes, true);
+    db.SyncRecords(batch, 'k', mapMasternodeBlocks, false);
+    return db.WriteBatch(batch, true);
+}
+
+bool CMasternodePayments::ReadState(CMasternodeStateDB& db)
+{
+    int64_t nStart = GetTimeMillis();
+    {
+        LOCK2(cs_mapMasternodePayeeVotes, cs_mapMasternodeBlocks);
+
+        if (!db.ReadRecords('w', mapMasternodePayeeVotes, true) ||
+            !db.ReadRecords('k', mapMasternodeBlocks, false))
+            return error("%s : Failed to read the masternode payment votes", __func__);
+        RebuildPaidIndex();
+    }
+
+    LogPrint("masternode","Loaded masternode payment votes  %dms\n", GetTimeMillis() - nStart);
+    LogPrint("masternode","  %s\n", ToString());
+    LogPrint("masternode","Masternode payments manager - cleaning....\n");
+    CleanPaymentList();
+    LogPrint("masternode","Masternode payments manager - result:\n");
+    LogPrint("masternode","  %s\n", ToString());
+    return true;
+}
+
 std::string CMasternodePayments::ToString() const
 {
     std::ostringstream info;
@@ -18,6 +18,7 @@ extern CCriticalSection cs_mapMasternodeBlocks;
 extern CCriticalSection cs_mapMasternodePayeeVotes;
 
 class CMasternodePayments;
+class CMasternodeStateDB;
 class CMasternodePaymentWinner;
 class CMasternodeBlockPayees;
 
@@ -34,7 +35,7 @@ void FillBlockPayee(CMutableTransaction& txNew, CAmount nFees, bool fProofOfStak
 
 void DumpMasternodePayments();
 
-/** Save Masternode Payment Data (mnpayments.dat)
+/** Legacy Masternode Payment Data (mnpayments.dat), only read to import it into the masternode state database
  */
 class CMasternodePaymentDB
 {
@@ -54,7 +55,6 @@ public:
     };
 
     CMasternodePaymentDB();
-    bool Write(const CMasternodePayments& objToSave);
     ReadResult Read(CMasternodePayments& objToLoad, bool fDryRun = false);
 };
 
@@ -195,6 +195,7 @@ public:
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
     bool IsValid(CNode* pnode, std::string& strError);
     bool SignatureValid();
+    std::string GetStrMessage() const;
     void Relay();
 
     void AddPayee(CScript payeeIn)
@@ -236,6 +237,13 @@ private:
     int nSyncedFromPeer;
     int nLastBlockHeight;
 
+    // payee -> heights in mapMasternodeBlocks where it has the two votes that count as being paid,
+    // heights above the tip are skipped by lookups so blocks connecting or disconnecting need no update
+    std::map<CScript, std::set<int> > mapPayeePaidHeights;
+    void IndexBlockPayee(int nBlockHeight, const CScript& payee);
+    void UnindexBlockPayees(int nBlockHeight);
+    void RebuildPaidIndex();
+
 public:
     std::map<uint256, CMasternodePaymentWinner> mapMasternodePayeeVotes;
     std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
@@ -252,6 +260,7 @@ public:
         LOCK2(cs_mapMasternodeBlocks, cs_mapMasternodePayeeVotes);
         mapMasternodeBlocks.clear();
         mapMasternodePayeeVotes.clear();
+        mapPayeePaidHeights.clear();
     }
 
     bool AddWinningMasternode(CMasternodePaymentWinner& winner);
@@ -261,6 +270,14 @@ public:
     void CleanPaymentList();
     int LastPayment(CMasternode& mn);
 
+    /// Write what changed since the last dump to the masternode state database
+    bool WriteState(CMasternodeStateDB& db);
+    /// Load the votes written by WriteState and clean them
+    bool ReadState(CMasternodeStateDB& db);
+
+    /// Highest block at or below nHeightMax the payee got two payment votes for, 0 if there is none
+    int GetLastPaidHeight(const CScript& payee, int nHeightMax);
+
     bool GetBlockPayee(int nBlockHeight, CScript& payee);
     bool IsTransactionValid(const CTransaction& txNew, int nBlockHeight);
     bool IsScheduled(CMasternode& mn, int nNotBlockHeight);
@@ -295,6 +312,8 @@ public:
     {
         READWRITE(mapMasternodePayeeVotes);
         READWRITE(mapMasternodeBlocks);
+        if (ser_action.ForRead())
+            RebuildPaidIndex();
     }
 };
 
@@ -13,6 +13,7 @@
 #include "sync.h"
 #include "timedata.h"
 #include "util.h"
+#include "validationinterface.h"
 
 #define MASTERNODE_MIN_CONFIRMATIONS 15
 #define MASTERNODE_MIN_MNP_SECONDS (10 * 60)
@@ -26,12 +27,40 @@ using namespace std;
 
 class CMasternode;
 class CMasternodeBroadcast;
+class CMasternodeCollateralWatch;
 class CMasternodePing;
 extern map<int64_t, uint256> mapCacheBlockHashes;
+extern CMasternodeCollateralWatch masternodeCollateralWatch;
 
 bool GetBlockHash(uint256& hash, int nBlockHeight);
 
 
+//
+// Spent state of the masternode collateral outpoints. A collateral is looked up against the UTXO set and
+// mempool when its masternode is checked, until the lookup finds it unspent; from then on the
+// transactions synced by AcceptToMemoryPool, ConnectTip and DisconnectTip keep it current, so checks
+// don't need cs_main. A failed lookup is not remembered, the collateral may just not have arrived yet.
+// A collateral whose funding transaction drops out of the chain and the mempool is unwatched again.
+//
+
+class CMasternodeCollateralWatch : public CValidationInterface
+{
+private:
+    mutable CCriticalSection cs;
+    // watched collateral -> hash of the transaction spending it, or 0 while unspent
+    std::map<COutPoint, uint256> mapWatched;
+
+protected:
+    void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
+
+public:
+    /// Returns false if the outpoint is not watched yet
+    bool GetSpent(const COutPoint& outpoint, bool& fSpentRet) const;
+    /// Start watching an outpoint found unspent; requires cs_main, so no spend is synced between the lookup and this
+    void Watch(const COutPoint& outpoint);
+    void Unwatch(const COutPoint& outpoint);
+};
+
 //
 // The Masternode Ping Class : Contains a different serialize method for sending pings from masternodes throughout the network
 //
@@ -61,6 +90,7 @@ public:
 
     bool CheckAndUpdate(int& nDos, bool fRequireEnabled = true);
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
+    std::string GetStrMessage() const;
     void Relay();
 
     uint256 GetHash()
@@ -217,7 +247,7 @@ public:
         READWRITE(nLastScanningErrorBlockHeight);
     }
 
-    int64_t SecondsSincePayment();
+    int64_t SecondsSincePayment(int nEnabledCount = -1);
 
     bool UpdateFromNewBroadcast(CMasternodeBroadcast& mnb);
 
@@ -280,7 +310,8 @@ public:
         return strStatus;
     }
 
-    int64_t GetLastPaid();
+    /// Time of the last payment, nEnabledCount is CountEnabled() when the caller already has it
+    int64_t GetLastPaid(int nEnabledCount = -1);
     bool IsValidNetAddr();
 };
 
@@ -299,6 +330,7 @@ public:
     bool CheckAndUpdate(int& nDoS);
     bool CheckInputsAndAdd(int& nDos);
     bool Sign(CKey& keyCollateralAddress);
+    std::string GetStrMessage() const;
     void Relay();
 
     ADD_SERIALIZE_METHODS;
@@ -0,0 +1,27 @@
+// Copyright (c) 2026 The Loonie developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternodedb.h"
+
+CMasternodeStateDB* pMasternodeStateDB = NULL;
+
+CMasternodeStateDB::CMasternodeStateDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "mnstate", nCacheSize, fMemory, fWipe), nWritten(0) {}
+
+bool CMasternodeStateDB::ReadVersion(int& nVersion)
+{
+    return Read('V', nVersion);
+}
+
+bool CMasternodeStateDB::WriteVersion()
+{
+    return Write('V', MASTERNODE_STATE_VERSION, true);
+}
+
+bool CMasternodeStateDB::MarkWritten(int nState)
+{
+    int nPrev = nWritten.fetch_or(nState);
+    if (nPrev == STATE_ALL || (nPrev | nState) != STATE_ALL)
+        return true;
+    return WriteVersion();
+}
@@ -0,0 +1,182 @@
+// Copyright (c) 2026 The Loonie developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MASTERNODEDB_H
+#define MASTERNODEDB_H
+
+#include "hash.h"
+#include "leveldbwrapper.h"
+
+#include <atomic>
+#include <map>
+#include <string>
+
+#include <boost/scoped_ptr.hpp>
+
+/** Version of the record layout below, stores written by another version are rebuilt from the .dat files */
+static const int MASTERNODE_STATE_VERSION = 1;
+
+/**
+ * LevelDB store of the masternode list, payment votes and budgets (datadir/mnstate). Every
+ * collection is kept as one record per entry, keyed by (record type, key):
+ *   'm' masternodes, 'b' seen broadcasts, 'p' seen pings, 'M' other masternode manager state
+ *   'w' payment votes, 'k' block payees
+ *   'r' budget proposals, 'f' finalized budgets, 'o'/'O' orphan proposal/finalized budget votes
+ * A dump only writes the records that are new or changed since the last one and erases the
+ * ones that went away, and loading needs no checksum over the whole set.
+ */
+class CMasternodeStateDB : public CLevelDBWrapper
+{
+private:
+    //! hash of each record on disk by record type and serialized key, 0 for immutable records
+    std::map<char, std::map<std::string, uint256> > mapStored;
+    //! records of the type being synced that the current pass hasn't come across yet
+    std::map<std::string, uint256> mapUnseen;
+    //! STATE_* flags of the collections written in full since startup
+    std::atomic<int> nWritten;
+
+    CMasternodeStateDB(const CMasternodeStateDB&);
+    void operator=(const CMasternodeStateDB&);
+
+    template <typename K>
+    static std::string GetKeyString(char chType, const K& key)
+    {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << std::make_pair(chType, key);
+        return ssKey.str();
+    }
+
+public:
+    CMasternodeStateDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+    enum {
+        STATE_MASTERNODES = 1,
+        STATE_PAYMENTS = 2,
+        STATE_BUDGETS = 4,
+        STATE_ALL = STATE_MASTERNODES | STATE_PAYMENTS | STATE_BUDGETS
+    };
+
+    bool ReadVersion(int& nVersion);
+    bool WriteVersion();
+
+    /**
+     * Note that one collection was written in full. Once all of them have been, the version record
+     * is written, so the store is only trusted over the .dat files after everything was moved over.
+     */
+    bool MarkWritten(int nState);
+
+    /**
+     * Sync one record type with what is in memory: BeginSync, SyncRecord for every current entry,
+     * then EndSync queues the erasure of the entries that are gone. An entry is written when it is
+     * new, or when its serialization changed unless fImmutable says its key always maps to the same value.
+     */
+    void BeginSync(char chType)
+    {
+        mapUnseen.clear();
+        mapUnseen.swap(mapStored[chType]);
+    }
+
+    template <typename K, typename V>
+    void SyncRecord(CLevelDBBatch& batch, char chType, const K& key, const V& value, bool fImmutable)
+    {
+        std::string strKey = GetKeyString(chType, key);
+        std::map<std::string, uint256>::iterator it = mapUnseen.find(strKey);
+        if (it != mapUnseen.end() && fImmutable) {
+            mapStored[chType].insert(*it);
+            mapUnseen.erase(it);
+            return;
+        }
+
+        uint256 hashValue = 0;
+        if (!fImmutable) {
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            ssValue << value;
+            hashValue = Hash(ssValue.begin(), ssValue.end());
+        }
+        if (it == mapUnseen.end() || it->second != hashValue)
+            batch.Write(std::make_pair(chType, key), value);
+        if (it != mapUnseen.end())
+            mapUnseen.erase(it);
+        mapStored[chType][strKey] = hashValue;
+    }
+
+    template <typename K>
+    void EndSync(CLevelDBBatch& batch, char chType)
+    {
+        for (std::map<std::string, uint256>::const_iterator it = mapUnseen.begin(); it != mapUnseen.end(); ++it) {
+            CDataStream ssKey(it->first.data(), it->first.data() + it->first.size(), SER_DISK, CLIENT_VERSION);
+            std::pair<char, K> key;
+            ssKey >> key;
+            batch.Erase(key);
+        }
+        mapUnseen.clear();
+    }
+
+    template <typename K, typename V>
+    void SyncRecords(CLevelDBBatch& batch, char chType, const std::map<K, V>& mapRecords, bool fImmutable)
+    {
+        BeginSync(chType);
+        for (typename std::map<K, V>::const_iterator it = mapRecords.begin(); it != mapRecords.end(); ++it)
+            SyncRecord(batch, chType, it->first, it->second, fImmutable);
+        EndSync<K>(batch, chType);
+    }
+
+    /** Load a single record and remember it as stored */
+    template <typename K, typename V>
+    bool ReadRecord(char chType, const K& key, V& value)
+    {
+        if (!Read(std::make_pair(chType, key), value))
+            return false;
+
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        ssValue << value;
+        mapStored[chType][GetKeyString(chType, key)] = Hash(ssValue.begin(), ssValue.end());
+        return true;
+    }
+
+    /** Load all records of one type and remember them as stored */
+    template <typename K, typename V>
+    bool ReadRecords(char chType, std::map<K, V>& mapRecords, bool fImmutable)
+    {
+        boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+        std::map<std::string, uint256>& mapTypeStored = mapStored[chType];
+
+        CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+        ssKeySet << chType;
+        pcursor->Seek(ssKeySet.str());
+
+        for (; pcursor->Valid(); pcursor->Next()) {
+            leveldb::Slice slKey = pcursor->key();
+            if (slKey.size() == 0 || slKey[0] != chType)
+                break;
+
+            leveldb::Slice slValue = pcursor->value();
+            std::pair<char, K> key;
+            try {
+                CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+                ssKey >> key;
+            } catch (std::exception& e) {
+                LogPrint("masternode", "CMasternodeStateDB::ReadRecords - skipping bad '%c' key: %s\n", chType, e.what());
+                continue;
+            }
+
+            // a record that fails to load is remembered as stored, so the next dump erases it
+            mapTypeStored[slKey.ToString()] = fImmutable ? uint256(0) : Hash(slValue.data(), slValue.data() + slValue.size());
+            try {
+                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+                V value;
+                ssValue >> value;
+                mapRecords.insert(std::make_pair(key.second, value));
+            } catch (std::exception& e) {
+                LogPrint("masternode", "CMasternodeStateDB::ReadRecords - skipping bad '%c' record: %s\n", chType, e.what());
+            }
+        }
+
+        return pcursor->status().ok();
+    }
+};
+
+extern CMasternodeStateDB* pMasternodeStateDB;
+
+#endif // MASTERNODEDB_H
@@ -7,6 +7,7 @@
 #include "activemasternode.h"
 #include "addrman.h"
 #include "masternode.h"
+#include "masternodedb.h"
 #include "obfuscation.h"
 #include "spork.h"
 #include "util.h"
@@ -52,39 +53,6 @@ CMasternodeDB::CMasternodeDB()
     strMagicMessage = "MasternodeCache";
 }
 
-bool CMasternodeDB::Write(const CMasternodeMan& mnodemanToSave)
-{
-    int64_t nStart = GetTimeMillis();
-
-    // serialize, checksum data up to that point, then append checksum
-    CDataStream ssMasternodes(SER_DISK, CLIENT_VERSION);
-    ssMasternodes << strMagicMessage;                   // masternode cache file specific magic message
-    ssMasternodes << FLATDATA(Params().MessageStart()); // network specific magic number
-    ssMasternodes << mnodemanToSave;
-    uint256 hash = Hash(ssMasternodes.begin(), ssMasternodes.end());
-    ssMasternodes << hash;
-
-    // open output file, and associate with CAutoFile
-    FILE* file = fopen(pathMN.string().c_str(), "wb");
-    CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathMN.string());
-
-    // Write and commit header, data
-    try {
-        fileout << ssMasternodes;
-    } catch (std::exception& e) {
-        return error("%s : Serialize or I/O error - %s", __func__, e.what());
-    }
-    //    FileCommit(fileout);
-    fileout.fclose();
-
-    LogPrint("masternode","Written info to mncache.dat  %dms\n", GetTimeMillis() - nStart);
-    LogPrint("masternode","  %s\n", mnodemanToSave.ToString());
-
-    return true;
-}
-
 CMasternodeDB::ReadResult CMasternodeDB::Read(CMasternodeMan& mnodemanToLoad, bool fDryRun)
 {
     int64_t nStart = GetTimeMillis();
@@ -168,33 +136,25 @@ CMasternodeDB::ReadResult CMasternodeDB::Read(CMasternodeMan& mnodemanToLoad, bo
 
 void DumpMasternodes()
 {
-    int64_t nStart = GetTimeMillis();
+    if (!pMasternodeStateDB)
+        return;
 
-    CMasternodeDB mndb;
-    CMasternodeMan tempMnodeman;
-
-    LogPrint("masternode","Verifying mncache.dat format...\n");
-    CMasternodeDB::ReadResult readResult = mndb.Read(tempMnodeman, true);
-    // there was an error and it was not an error on file opening => do not proceed
-    if (readResult == CMasternodeDB::FileError)
-        LogPrint("masternode","Missing masternode cache file - mncache.dat, will try to recreate\n");
-    else if (readResult != CMasternodeDB::Ok) {
-        LogPrint("masternode","Error reading mncache.dat: ");
-        if (readResult == CMasternodeDB::IncorrectFormat)
-            LogPrint("masternode","magic is ok but data has invalid format, will try to recreate\n");
-        else {
-            LogPrint("masternode","file format is unknown or invalid, please fix it manually\n");
-            return;
-        }
+    int64_t nStart = GetTimeMillis();
+    try {
+        if (!mnodeman.WriteState(*pMasternodeStateDB))
+            error("%s : Failed to write the masternode list", __func__);
+        else
+            pMasternodeStateDB->MarkWritten(CMasternodeStateDB::STATE_MASTERNODES);
+    } catch (std::exception& e) {
+        error("%s : Serialize or I/O error - %s", __func__, e.what());
     }
-    LogPrint("masternode","Writting info to mncache.dat...\n");
-    mndb.Write(mnodeman);
 
     LogPrint("masternode","Masternode dump finished  %dms\n", GetTimeMillis() - nStart);
 }
 
 CMasternodeMan::CMasternodeMan()
 {
+    nIndexVersion = 0;
     nDsqCount = 0;
 }
 
@@ -209,6 +169,7 @@ bool CMasternodeMan::Add(CMasternode& mn)
     if (pmn == NULL) {
         LogPrint("masternode", "CMasternodeMan: Adding new Masternode %s - %i now\n", mn.vin.prevout.hash.ToString(), size() + 1);
         vMasternodes.push_back(mn);
+        IndexMasternode(vMasternodes.size() - 1);
         return true;
     }
 
@@ -247,6 +208,7 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
     LOCK(cs);
 
     //remove inactive and outdated
+    bool fRemoved = false;
     vector<CMasternode>::iterator it = vMasternodes.begin();
     while (it != vMasternodes.end()) {
         if ((*it).activeState == CMasternode::MASTERNODE_REMOVE ||
@@ -278,11 +240,15 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
                 }
             }
 
+            masternodeCollateralWatch.Unwatch((*it).vin.prevout);
             it = vMasternodes.erase(it);
+            fRemoved = true;
         } else {
             ++it;
         }
     }
+    if (fRemoved)
+        RebuildIndexes();
 
     // check who's asked for the Masternode list
     map<CNetAddr, int64_t>::iterator it1 = mAskedUsForMasternodeList.begin();
@@ -336,10 +302,89 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
     }
 }
 
+bool CMasternodeMan::WriteState(CMasternodeStateDB& db)
+{
+    LOCK(cs);
+
+    CLevelDBBatch batch;
+    db.BeginSync('m');
+    BOOST_FOREACH (const CMasternode& mn, vMasternodes)
+        db.SyncRecord(batch, 'm', mn.vin.prevout, mn, false);
+    db.EndSync<COutPoint>(batch, 'm');
+
+    db.SyncRecords(batch, 'b', mapSeenMasternodeBroadcast, false);
+    db.SyncRecords(batch, 'p', mapSeenMasternodePing, true);
+
+    db.BeginSync('M');
+    db.SyncRecord(batch, 'M', std::string("askedus"), mAskedUsForMasternodeList, false);
+    db.SyncRecord(batch, 'M', std::string("weasked"), mWeAskedForMasternodeList, false);
+    db.SyncRecord(batch, 'M', std::string("weaskedentry"), mWeAskedForMasternodeListEntry, false);
+    db.SyncRecord(batch, 'M', std::string("dsqcount"), nDsqCount, false);
+
+    // the 'm' records come back sorted by collateral, the list order itself is kept separately
+    std::vector<COutPoint> vOrder;
+    vOrder.reserve(vMasternodes.size());
+    BOOST_FOREACH (const CMasternode& mn, vMasternodes)
+        vOrder.push_back(mn.vin.prevout);
+    db.SyncRecord(batch, 'M', std::string("order"), vOrder, false);
+    db.EndSync<std::string>(batch, 'M');
+
+    return db.WriteBatch(batch, true);
+}
+
+bool CMasternodeMan::ReadState(CMasternodeStateDB& db)
+{
+    int64_t nStart = GetTimeMillis();
+    {
+        LOCK(cs);
+
+        std::map<COutPoint, CMasternode> mapMasternodes;
+        if (!db.ReadRecords('m', mapMasternodes, false) ||
+            !db.ReadRecords('b', mapSeenMasternodeBroadcast, false) ||
+            !db.ReadRecords('p', mapSeenMasternodePing, true))
+            return error("%s : Failed to read the masternode list", __func__);
+
+        BOOST_FOREACH (const CMasternode& mn, vMasternodes)
+            masternodeCollateralWatch.Unwatch(mn.vin.prevout);
+        vMasternodes.clear();
+        vMasternodes.reserve(mapMasternodes.size());
+
+        // restore the list order, entries missing from the order record (older stores) go at the end
+        std::vector<COutPoint> vOrder;
+        db.ReadRecord('M', std::string("order"), vOrder);
+        BOOST_FOREACH (const COutPoint& outpoint, vOrder) {
+            std::map<COutPoint, CMasternode>::iterator it = mapMasternodes.find(outpoint);
+            if (it == mapMasternodes.end())
+                continue;
+            vMasternodes.push_back(it->second);
+            mapMasternodes.erase(it);
+        }
+        for (std::map<COutPoint, CMasternode>::iterator it = mapMasternodes.begin(); it != mapMasternodes.end(); ++it)
+            vMasternodes.push_back(it->second);
+        RebuildIndexes();
+
+        db.ReadRecord('M', std::string("askedus"), mAskedUsForMasternodeList);
+        db.ReadRecord('M', std::string("weasked"), mWeAskedForMasternodeList);
+        db.ReadRecord('M', std::string("weaskedentry"), mWeAskedForMasternodeListEntry);
+        db.ReadRecord('M', std::string("dsqcount"), nDsqCount);
+    }
+
+    LogPrint("masternode","Loaded masternode list  %dms\n", GetTimeMillis() - nStart);
+    LogPrint("masternode","  %s\n", ToString());
+    LogPrint("masternode","Masternode manager - cleaning....\n");
+    CheckAndRemove(true);
+    LogPrint("masternode","Masternode manager - result:\n");
+    LogPrint("masternode","  %s\n", ToString());
+    return true;
+}
+
 void CMasternodeMan::Clear()
 {
     LOCK(cs);
+    BOOST_FOREACH (const CMasternode& mn, vMasternodes)
+        masternodeCollateralWatch.Unwatch(mn.vin.prevout);
     vMasternodes.clear();
+    RebuildIndexes();
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
@@ -435,28 +480,60 @@ void CMasternodeMan::DsegUpdate(CNode* pnode)
     mWeAskedForMasternodeList[pnode->addr] = askAgain;
 }
 
+void CMasternodeMan::IndexMasternode(size_t nIndex)
+{
+    AssertLockHeld(cs);
+    mapRankTables.clear();
+    nIndexVersion++;
+    const CMasternode& mn = vMasternodes[nIndex];
+    // insert() keeps an existing entry, which is the earlier one in vMasternodes
+    mapIndexVin.insert(std::make_pair(mn.vin.prevout, nIndex));
+    mapIndexPayee.insert(std::make_pair(mn.pubKeyCollateralAddress.GetID(), nIndex));
+    mapIndexPubKey.insert(std::make_pair(mn.pubKeyMasternode.GetID(), nIndex));
+}
+
+void CMasternodeMan::RebuildIndexes()
+{
+    LOCK(cs);
+    mapRankTables.clear();
+    nIndexVersion++;
+    mapIndexVin.clear();
+    mapIndexPayee.clear();
+    mapIndexPubKey.clear();
+    for (size_t i = 0; i < vMasternodes.size(); i++)
+        IndexMasternode(i);
+}
+
 CMasternode* CMasternodeMan::Find(const CScript& payee)
 {
     LOCK(cs);
-    CScript payee2;
 
-    BOOST_FOREACH (CMasternode& mn, vMasternodes) {
-        payee2 = GetScriptForDestination(mn.pubKeyCollateralAddress.GetID());
-        if (payee2 == payee)
-            return &mn;
-    }
-    return NULL;
+    // payees are the pay-to-pubkey-hash scripts of the collateral keys
+    CTxDestination dest;
+    if (!ExtractDestination(payee, dest))
+        return NULL;
+    const CKeyID* keyID = boost::get<CKeyID>(&dest);
+    if (keyID == NULL)
+        return NULL;
+
+    boost::unordered_map<CKeyID, size_t, MasternodeKeyIDHasher>::const_iterator it = mapIndexPayee.find(*keyID);
+    if (it == mapIndexPayee.end())
+        return NULL;
+
+    CMasternode& mn = vMasternodes[it->second];
+    if (GetScriptForDestination(mn.pubKeyCollateralAddress.GetID()) != payee)
+        return NULL;
+    return &mn;
 }
 
 CMasternode* CMasternodeMan::Find(const CTxIn& vin)
 {
     LOCK(cs);
 
-    BOOST_FOREACH (CMasternode& mn, vMasternodes) {
-        if (mn.vin.prevout == vin.prevout)
-            return &mn;
-    }
-    return NULL;
+    boost::unordered_map<COutPoint, size_t, MasternodeOutPointHasher>::const_iterator it = mapIndexVin.find(vin.prevout);
+    if (it == mapIndexVin.end())
+        return NULL;
+    return &vMasternodes[it->second];
 }
 
 
@@ -464,11 +541,10 @@ CMasternode* CMasternodeMan::Find(const CPubKey& pubKeyMasternode)
 {
     LOCK(cs);
 
-    BOOST_FOREACH (CMasternode& mn, vMasternodes) {
-        if (mn.pubKeyMasternode == pubKeyMasternode)
-            return &mn;
-    }
-    return NULL;
+    boost::unordered_map<CKeyID, size_t, MasternodeKeyIDHasher>::const_iterator it = mapIndexPubKey.find(pubKeyMasternode.GetID());
+    if (it == mapIndexPubKey.end() || vMasternodes[it->second].pubKeyMasternode != pubKeyMasternode)
+        return NULL;
+    return &vMasternodes[it->second];
 }
 
 //
@@ -502,7 +578,7 @@ CMasternode* CMasternodeMan::GetNextMasternodeInQueueForPayment(int nBlockHeight
         //make sure it has as many confirmations as there are masternodes
         if (mn.GetMasternodeInputAge() < nMnCount) continue;
 
-        vecMasternodeLastPaid.push_back(make_pair(mn.SecondsSincePayment(), mn.vin));
+        vecMasternodeLastPaid.push_back(make_pair(mn.SecondsSincePayment(nMnCount), mn.vin));
     }
 
     nCount = (int)vecMasternodeLastPaid.size();
@@ -591,16 +667,26 @@ CMasternode* CMasternodeMan::GetCurrentMasterNode(int mod, int64_t nBlockHeight,
     return winner;
 }
 
-int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
+const CMasternodeMan::CMasternodeRankTable& CMasternodeMan::GetRankTable(int64_t nBlockHeight, int minProtocol, bool fOnlyActive, bool fMinAge)
 {
+    AssertLockHeld(cs);
+
+    // every call scores a whole list again otherwise, don't let tables for old heights pile up
+    if (mapRankTables.size() > 100)
+        mapRankTables.clear();
+
+    uint256 hash = 0;
+    GetBlockHash(hash, nBlockHeight);
+
+    int nFilter = (fOnlyActive ? 1 : 0) | (fMinAge ? 2 : 0);
+    CMasternodeRankTable& table = mapRankTables[std::make_pair(nBlockHeight, std::make_pair(minProtocol, nFilter))];
+    if (!table.vecRanked.empty() && table.hashBlock == hash && GetTime() - table.nTimeBuilt < MASTERNODE_CHECK_SECONDS)
+        return table;
+
     std::vector<pair<int64_t, CTxIn> > vecMasternodeScores;
     int64_t nMasternode_Min_Age = MN_WINNER_MINIMUM_AGE;
     int64_t nMasternode_Age = 0;
 
-    //make sure we know about this block
-    uint256 hash = 0;
-    if (!GetBlockHash(hash, nBlockHeight)) return -1;
-
     // scan for winner
     BOOST_FOREACH (CMasternode& mn, vMasternodes) {
         if (mn.protocolVersion < minProtocol) {
@@ -608,7 +694,7 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, in
             continue;                                                       // Skip obsolete versions
         }
 
-        if (IsSporkActive(SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT)) {
+        if (fMinAge) {
             nMasternode_Age = GetAdjustedTime() - mn.sigTime;
             if ((nMasternode_Age) < nMasternode_Min_Age) {
                 if (fDebug) LogPrint("masternode","Skipping just activated Masternode. Age: %ld\n", nMasternode_Age);
@@ -627,15 +713,34 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, in
 
     sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreTxIn());
 
+    table.hashBlock = hash;
+    table.nTimeBuilt = GetTime();
+    table.vecRanked.clear();
+    table.mapRanks.clear();
     int rank = 0;
     BOOST_FOREACH (PAIRTYPE(int64_t, CTxIn) & s, vecMasternodeScores) {
         rank++;
-        if (s.second.prevout == vin.prevout) {
-            return rank;
-        }
+        table.vecRanked.push_back(s.second);
+        table.mapRanks.insert(make_pair(s.second.prevout, rank));
     }
 
-    return -1;
+    return table;
+}
+
+int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
+{
+    LOCK(cs);
+
+    //make sure we know about this block
+    uint256 hash = 0;
+    if (!GetBlockHash(hash, nBlockHeight)) return -1;
+
+    const CMasternodeRankTable& table = GetRankTable(nBlockHeight, minProtocol, fOnlyActive, IsSporkActive(SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT));
+    boost::unordered_map<COutPoint, int, MasternodeOutPointHasher>::const_iterator it = table.mapRanks.find(vin.prevout);
+    if (it == table.mapRanks.end())
+        return -1;
+
+    return it->second;
 }
 
 std::vector<pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int64_t nBlockHeight, int minProtocol)
@@ -677,33 +782,13 @@ std::vector<pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int64_t
 
 CMasternode* CMasternodeMan::GetMasternodeByRank(int nRank, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
 {
-    std::vector<pair<int64_t, CTxIn> > vecMasternodeScores;
-
-    // scan for winner
-    BOOST_FOREACH (CMasternode& mn, vMasternodes) {
-        if (mn.protocolVersion < minProtocol) continue;
-        if (fOnlyActive) {
-            mn.Check();
-            if (!mn.IsEnabled()) continue;
-        }
-
-        uint256 n = mn.CalculateScore(1, nBlockHeight);
-        int64_t n2 = n.GetCompact(false);
-
-        vecMasternodeScores.push_back(make_pair(n2, mn.vin));
-    }
+    LOCK(cs);
 
-    sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreTxIn());
+    const CMasternodeRankTable& table = GetRankTable(nBlockHeight, minProtocol, fOnlyActive, false);
+    if (nRank < 1 || nRank > (int)table.vecRanked.size())
+        return NULL;
 
-    int rank = 0;
-    BOOST_FOREACH (PAIRTYPE(int64_t, CTxIn) & s, vecMasternodeScores) {
-        rank++;
-        if (rank == nRank) {
-            return Find(s.second);
-        }
-    }
-
-    return NULL;
+    return Find(table.vecRanked[nRank - 1]);
 }
 
 void CMasternodeMan::ProcessMasternodeConnections()
@@ -941,7 +1026,11 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
                 if (pmn->nLastDsee < sigTime) { //take the newest entry
                     LogPrint("masternode", "dsee - Got updated entry for %s\n", vin.prevout.hash.ToString());
                     if (pmn->protocolVersion < GETHEADERS_VERSION) {
-                        pmn->pubKeyMasternode = pubkey2;
+                        mapRankTables.clear();
+                        if (pmn->pubKeyMasternode != pubkey2) {
+                            pmn->pubKeyMasternode = pubkey2;
+                            RebuildIndexes();
+                        }
                         pmn->sigTime = sigTime;
                         pmn->sig = vchSig;
                         pmn->protocolVersion = protocolVersion;
@@ -1139,7 +1228,9 @@ void CMasternodeMan::Remove(CTxIn vin)
     while (it != vMasternodes.end()) {
         if ((*it).vin == vin) {
             LogPrint("masternode", "CMasternodeMan: Removing Masternode %s - %i now\n", (*it).vin.prevout.hash.ToString(), size() - 1);
+            masternodeCollateralWatch.Unwatch((*it).vin.prevout);
             vMasternodes.erase(it);
+            RebuildIndexes();
             break;
         }
         ++it;
@@ -1160,11 +1251,26 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb)
         if (Add(mn)) {
             masternodeSync.AddedMasternodeList(mnb.GetHash());
         }
-    } else if (pmn->UpdateFromNewBroadcast(mnb)) {
+    } else if (UpdateFromNewBroadcast(*pmn, mnb)) {
         masternodeSync.AddedMasternodeList(mnb.GetHash());
     }
 }
 
+bool CMasternodeMan::UpdateFromNewBroadcast(CMasternode& mn, CMasternodeBroadcast& mnb)
+{
+    LOCK(cs);
+    CPubKey pubKeyCollateralAddressOld = mn.pubKeyCollateralAddress;
+    CPubKey pubKeyMasternodeOld = mn.pubKeyMasternode;
+    if (!mn.UpdateFromNewBroadcast(mnb))
+        return false;
+    mapRankTables.clear();
+
+    // the old keys may still be indexed for this entry or shared with a later one, key changes are rare enough to rebuild
+    if (mn.pubKeyCollateralAddress != pubKeyCollateralAddressOld || mn.pubKeyMasternode != pubKeyMasternodeOld)
+        RebuildIndexes();
+    return true;
+}
+
 std::string CMasternodeMan::ToString() const
 {
     std::ostringstream info;
@@ -14,17 +14,20 @@
 #include "sync.h"
 #include "util.h"
 
+#include <boost/unordered_map.hpp>
+
 #define MASTERNODES_DUMP_SECONDS (15 * 60)
 #define MASTERNODES_DSEG_SECONDS (3 * 60 * 60)
 
 using namespace std;
 
 class CMasternodeMan;
+class CMasternodeStateDB;
 
 extern CMasternodeMan mnodeman;
 void DumpMasternodes();
 
-/** Access to the MN database (mncache.dat)
+/** Access to the legacy MN database (mncache.dat), only read to import it into the masternode state database
  */
 class CMasternodeDB
 {
@@ -44,10 +47,17 @@ public:
     };
 
     CMasternodeDB();
-    bool Write(const CMasternodeMan& mnodemanToSave);
     ReadResult Read(CMasternodeMan& mnodemanToLoad, bool fDryRun = false);
 };
 
+struct MasternodeOutPointHasher {
+    size_t operator()(const COutPoint& outpoint) const { return outpoint.hash.GetLow64() ^ outpoint.n; }
+};
+
+struct MasternodeKeyIDHasher {
+    size_t operator()(const CKeyID& keyID) const { return keyID.GetLow64(); }
+};
+
 class CMasternodeMan
 {
 private:
@@ -66,6 +76,30 @@ private:
     // which Masternodes we've asked for
     std::map<COutPoint, int64_t> mWeAskedForMasternodeListEntry;
 
+    // positions in vMasternodes by collateral outpoint, collateral (payee) key id and masternode key id;
+    // where entries share a key the first one is indexed, as the linear search found it
+    boost::unordered_map<COutPoint, size_t, MasternodeOutPointHasher> mapIndexVin;
+    boost::unordered_map<CKeyID, size_t, MasternodeKeyIDHasher> mapIndexPayee;
+    boost::unordered_map<CKeyID, size_t, MasternodeKeyIDHasher> mapIndexPubKey;
+    // bumped whenever the indexes change, so results that only depend on which masternodes are known can be kept
+    int nIndexVersion;
+
+    void IndexMasternode(size_t nIndex);
+    void RebuildIndexes();
+
+    // masternodes ordered by score for one block, filtered like the rank lookups that use it
+    struct CMasternodeRankTable {
+        uint256 hashBlock;
+        int64_t nTimeBuilt;
+        std::vector<CTxIn> vecRanked;
+        boost::unordered_map<COutPoint, int, MasternodeOutPointHasher> mapRanks;
+    };
+    // rank tables by (block height, (minimum protocol, filter)). Entries are only valid for the block they
+    // were scored on and for MASTERNODE_CHECK_SECONDS, the interval enabled states are rechecked at, and
+    // all are dropped when the list changes
+    std::map<std::pair<int64_t, std::pair<int, int> >, CMasternodeRankTable> mapRankTables;
+    const CMasternodeRankTable& GetRankTable(int64_t nBlockHeight, int minProtocol, bool fOnlyActive, bool fMinAge);
+
 public:
     // Keep track of all broadcasts I've seen
     map<uint256, CMasternodeBroadcast> mapSeenMasternodeBroadcast;
@@ -82,6 +116,8 @@ public:
     {
         LOCK(cs);
         READWRITE(vMasternodes);
+        if (ser_action.ForRead())
+            RebuildIndexes();
         READWRITE(mAskedUsForMasternodeList);
         READWRITE(mWeAskedForMasternodeList);
         READWRITE(mWeAskedForMasternodeListEntry);
@@ -109,6 +145,11 @@ public:
     /// Clear Masternode vector
     void Clear();
 
+    /// Write what changed since the last dump to the masternode state database
+    bool WriteState(CMasternodeStateDB& db);
+    /// Load the list written by WriteState and clean it
+    bool ReadState(CMasternodeStateDB& db);
+
     int CountEnabled(int protocolVersion = -1);
 
     void CountNetworks(int protocolVersion, int& ipv4, int& ipv6, int& onion);
@@ -120,6 +161,13 @@ public:
     CMasternode* Find(const CTxIn& vin);
     CMasternode* Find(const CPubKey& pubKeyMasternode);
 
+    /// Changes whenever a masternode is added, removed or re-keyed
+    int GetIndexVersion()
+    {
+        LOCK(cs);
+        return nIndexVersion;
+    }
+
     /// Find an entry in the masternode list that is next to be paid
     CMasternode* GetNextMasternodeInQueueForPayment(int nBlockHeight, bool fFilterSigTime, int& nCount);
 
@@ -155,6 +203,9 @@ public:
 
     /// Update masternode list and maps using provided CMasternodeBroadcast
     void UpdateMasternodeList(CMasternodeBroadcast mnb);
+
+    /// Update an entry from a newer broadcast, keeping the lookup indexes in step with its keys
+    bool UpdateFromNewBroadcast(CMasternode& mn, CMasternodeBroadcast& mnb);
 };
 
 #endif
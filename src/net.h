@@ -21,6 +21,7 @@
 #include "utilstrencodings.h"
 
 #include <deque>
+#include <memory>
 #include <stdint.h>
 
 #ifndef WIN32
@@ -60,10 +61,25 @@ static const bool DEFAULT_UPNP = false;
 #endif
 /** The maximum number of entries in mapAskFor */
 static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
+/** -msghandthreads default, each message handler thread serves a fixed share of the peers */
+static const int DEFAULT_MSGHAND_THREADS = 4;
+/** Maximum number of message handler threads */
+static const int MAX_MSGHAND_THREADS = 16;
+/** How often, in milliseconds, one peer is picked to get trickled inventory and addresses */
+static const int64_t TRICKLE_INTERVAL = 100;
 
 unsigned int ReceiveFloodSize();
 unsigned int SendBufferSize();
 
+/**
+ * A complete serialized message, header included, waiting in the send queues of peers. It is never
+ * changed once built, so the same message can be queued for any number of peers without copying it.
+ */
+typedef std::shared_ptr<const CSerializeData> CSendBuffer;
+
+/** Build a message around an already serialized payload, to be queued with CNode::PushSendBuffer */
+CSendBuffer CreateSendBuffer(const char* pszCommand, const CDataStream& ssPayload);
+
 void AddOneShot(std::string strDest);
 bool RecvLine(SOCKET hSocket, std::string& strLine);
 void AddressCurrentlyConnected(const CService& addr);
@@ -93,6 +109,27 @@ struct CNodeSignals {
 
 CNodeSignals& GetNodeSignals();
 
+/** Shares the peers out over the message handler threads by node id, so a peer's messages are always
+ *  handled in order by the same thread. Once every TRICKLE_INTERVAL it picks one peer among all of them
+ *  to get trickled inventory and addresses, and hands it to the thread serving that peer. */
+class CMessageHandlerSchedule
+{
+public:
+    CMessageHandlerSchedule(int nThreadsIn = 1) : nThreads(nThreadsIn), nTrickleNode(-1), nNextTrickle(0) {}
+
+    int GetThreads() const { return nThreads; }
+    int GetThread(NodeId id) const { return id % nThreads; }
+
+    /** The peer of vNodes that thread nThread trickles to this round, or NULL. Each pick is handed out
+     *  once, to the thread serving the peer. Requires cs_vNodes. */
+    CNode* TakeTrickleNode(const std::vector<CNode*>& vNodes, int nThread, int64_t nNow);
+
+private:
+    int nThreads;
+    NodeId nTrickleNode;
+    int64_t nNextTrickle;
+};
+
 
 enum {
     LOCAL_NONE,   // unknown
@@ -130,7 +167,7 @@ extern int nMaxConnections;
 
 extern std::vector<CNode*> vNodes;
 extern CCriticalSection cs_vNodes;
-extern std::map<CInv, CDataStream> mapRelay;
+extern std::map<CInv, CSendBuffer> mapRelay;
 extern std::deque<std::pair<int64_t, CInv> > vRelayExpiration;
 extern CCriticalSection cs_mapRelay;
 extern limitedmap<CInv, int64_t> mapAlreadyAskedFor;
@@ -185,6 +222,8 @@ public:
 
     int64_t nTime; // time (in microseconds) of message receipt.
 
+    bool fSignaturesQueued; // masternode message signatures already handed to the recovery queue
+
     CNetMessage(int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), vRecv(nTypeIn, nVersionIn)
     {
         hdrbuf.resize(24);
@@ -192,6 +231,7 @@ public:
         nHdrPos = 0;
         nDataPos = 0;
         nTime = 0;
+        fSignaturesQueued = false;
     }
 
     bool complete() const
@@ -223,7 +263,7 @@ public:
     size_t nSendSize;   // total size of all vSendMsg entries
     size_t nSendOffset; // offset inside the first vSendMsg already sent
     uint64_t nSendBytes;
-    std::deque<CSerializeData> vSendMsg;
+    std::deque<CSendBuffer> vSendMsg;
     CCriticalSection cs_vSend;
 
     std::deque<CInv> vRecvGetData;
@@ -251,6 +291,10 @@ public:
     bool fNetworkNode;
     bool fSuccessfullyConnected;
     bool fDisconnect;
+    // Readiness of the socket reported by the socket handler and not used up by a recv/send yet.
+    // Only ThreadSocketHandler touches these.
+    bool fSocketReadable;
+    bool fSocketWritable;
     // We use fRelayTxes for two purposes -
     // a) it allows us to not relay tx invs before receiving the peer's version message
     // b) the peer may tell us in their version message that we should not relay tx invs
@@ -284,6 +328,9 @@ protected:
     // Basic fuzz-testing
     void Fuzz(int nChance); // modifies ssSend
 
+    // requires LOCK(cs_vSend)
+    void QueueSendBuffer(const CSendBuffer& msg);
+
 public:
     uint256 hashContinue;
     int nStartingHeight;
@@ -291,6 +338,7 @@ public:
     // flood relay
     std::vector<CAddress> vAddrToSend;
     mruset<CAddress> setAddrKnown;
+    CCriticalSection cs_addrKnown; // addresses are pushed by the handlers of other peers, which may run on another thread
     bool fGetAddr;
     std::set<uint256> setKnown;
 
@@ -370,6 +418,7 @@ public:
 
     void AddAddressKnown(const CAddress& addr)
     {
+        LOCK(cs_addrKnown);
         setAddrKnown.insert(addr);
     }
 
@@ -378,6 +427,7 @@ public:
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
+        LOCK(cs_addrKnown);
         if (addr.IsValid() && !setAddrKnown.count(addr)) {
             if (vAddrToSend.size() >= MAX_ADDR_TO_SEND) {
                 vAddrToSend[insecure_rand() % vAddrToSend.size()] = addr;
@@ -416,6 +466,9 @@ public:
     // TODO: Document the precondition of this function.  Is cs_vSend locked?
     void EndMessage() UNLOCK_FUNCTION(cs_vSend);
 
+    /** Queue a message built by CreateSendBuffer, sharing it with the other peers it goes to */
+    void PushSendBuffer(const CSendBuffer& msg);
+
     void PushVersion();
 
 
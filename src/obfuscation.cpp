@@ -4,9 +4,11 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "obfuscation.h"
+#include "checkqueue.h"
 #include "coincontrol.h"
 #include "init.h"
 #include "main.h"
+#include "masternode-budget.h"
 #include "masternodeman.h"
 #include "script/sign.h"
 #include "swifttx.h"
@@ -16,6 +18,7 @@
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/thread.hpp>
 
 #include <algorithm>
 #include <boost/assign/list_of.hpp>
@@ -2148,6 +2151,110 @@ bool CObfuScationSigner::GetKeysFromSecret(std::string strSecret, CKey& keyRet,
     return true;
 }
 
+namespace
+{
+/**
+ * Signers recovered from masternode message signatures, keyed by the hash of the signed
+ * message and the signature. Key recovery is the expensive part of VerifyMessage, and the
+ * same ping, vote or broadcast is relayed to us by every peer and checked on several paths.
+ */
+class CRecoveredKeyCache
+{
+private:
+    std::map<uint256, CKeyID> mapKeys;
+    boost::shared_mutex cs_keycache;
+
+    static uint256 GetEntryHash(const uint256& hashMessage, const std::vector<unsigned char>& vchSig)
+    {
+        CHashWriter ss(SER_GETHASH, 0);
+        ss << hashMessage;
+        ss << vchSig;
+        return ss.GetHash();
+    }
+
+public:
+    bool Get(const uint256& hashMessage, const std::vector<unsigned char>& vchSig, CKeyID& keyIDRet)
+    {
+        uint256 hashEntry = GetEntryHash(hashMessage, vchSig);
+        boost::shared_lock<boost::shared_mutex> lock(cs_keycache);
+
+        std::map<uint256, CKeyID>::const_iterator mi = mapKeys.find(hashEntry);
+        if (mi == mapKeys.end())
+            return false;
+        keyIDRet = mi->second;
+        return true;
+    }
+
+    void Set(const uint256& hashMessage, const std::vector<unsigned char>& vchSig, const CKeyID& keyID)
+    {
+        // same bound as the script signature cache; an entry is a fraction of the size
+        int64_t nMaxCacheSize = GetArg("-maxsigcachesize", 50000);
+        if (nMaxCacheSize <= 0) return;
+
+        uint256 hashEntry = GetEntryHash(hashMessage, vchSig);
+        boost::unique_lock<boost::shared_mutex> lock(cs_keycache);
+
+        while (static_cast<int64_t>(mapKeys.size()) > nMaxCacheSize) {
+            // evict a random entry, so a peer can't flush the keys of the real masternodes
+            // by replaying a fixed set of signatures just larger than the cache
+            std::map<uint256, CKeyID>::iterator it = mapKeys.lower_bound(GetRandHash());
+            if (it == mapKeys.end())
+                it = mapKeys.begin();
+            mapKeys.erase(it);
+        }
+
+        mapKeys[hashEntry] = keyID;
+    }
+};
+
+CRecoveredKeyCache recoveredKeyCache;
+
+uint256 GetSignedMessageHash(const std::string& strMessage)
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << strMessageMagic;
+    ss << strMessage;
+    return ss.GetHash();
+}
+
+bool RecoverMessageSigner(const uint256& hashMessage, const std::vector<unsigned char>& vchSig, CKeyID& keyIDRet)
+{
+    if (recoveredKeyCache.Get(hashMessage, vchSig, keyIDRet))
+        return true;
+
+    CPubKey pubkey;
+    if (!pubkey.RecoverCompact(hashMessage, vchSig))
+        return false;
+
+    keyIDRet = pubkey.GetID();
+    recoveredKeyCache.Set(hashMessage, vchSig, keyIDRet);
+    return true;
+}
+}
+
+CMessageSignatureCheck::CMessageSignatureCheck(const std::string& strMessage, const std::vector<unsigned char>& vchSigIn) : hashMessage(GetSignedMessageHash(strMessage)),
+                                                                                                                           vchSig(vchSigIn)
+{
+}
+
+bool CMessageSignatureCheck::operator()()
+{
+    // a bad signature is reported by the message handler, not here; failing would make
+    // the queue skip the rest of the batch
+    CKeyID keyID;
+    RecoverMessageSigner(hashMessage, vchSig, keyID);
+    return true;
+}
+
+static CCheckQueue<CMessageSignatureCheck> messagesigcheckqueue(128);
+static CCriticalSection cs_messagesigcheckqueue;
+
+void ThreadMessageSignatureCheck()
+{
+    RenameThread("loonie-mnsigch");
+    messagesigcheckqueue.Thread();
+}
+
 bool CObfuScationSigner::SignMessage(std::string strMessage, std::string& errorMessage, vector<unsigned char>& vchSig, CKey key)
 {
     CHashWriter ss(SER_GETHASH, 0);
@@ -2164,20 +2271,36 @@ bool CObfuScationSigner::SignMessage(std::string strMessage, std::string& errorM
 
 bool CObfuScationSigner::VerifyMessage(CPubKey pubkey, vector<unsigned char>& vchSig, std::string strMessage, std::string& errorMessage)
 {
-    CHashWriter ss(SER_GETHASH, 0);
-    ss << strMessageMagic;
-    ss << strMessage;
-
-    CPubKey pubkey2;
-    if (!pubkey2.RecoverCompact(ss.GetHash(), vchSig)) {
+    CKeyID keyID;
+    if (!RecoverMessageSigner(GetSignedMessageHash(strMessage), vchSig, keyID)) {
         errorMessage = _("Error recovering public key.");
         return false;
     }
 
-    if (fDebug && pubkey2.GetID() != pubkey.GetID())
-        LogPrintf("CObfuScationSigner::VerifyMessage -- keys don't match: %s %s\n", pubkey2.GetID().ToString(), pubkey.GetID().ToString());
+    if (fDebug && keyID != pubkey.GetID())
+        LogPrintf("CObfuScationSigner::VerifyMessage -- keys don't match: %s %s\n", keyID.ToString(), pubkey.GetID().ToString());
+
+    return (keyID == pubkey.GetID());
+}
+
+/**
+ * Fan the key recovery for a batch of messages out over the -par workers. One message handler
+ * thread queues a batch at a time; while the queue is busy the checks are simply left to the
+ * handlers, which verify every message anyway.
+ */
+void CObfuScationSigner::PrecomputeSignatures(std::vector<CMessageSignatureCheck>& vChecks)
+{
+    if (vChecks.empty())
+        return;
 
-    return (pubkey2.GetID() == pubkey.GetID());
+    if (nScriptCheckThreads && vChecks.size() > 1) {
+        TRY_LOCK(cs_messagesigcheckqueue, lockQueue);
+        if (lockQueue) {
+            CCheckQueueControl<CMessageSignatureCheck> control(&messagesigcheckqueue);
+            control.Add(vChecks);
+            control.Wait();
+        }
+    }
 }
 
 bool CObfuscationQueue::Sign()
@@ -2311,7 +2434,12 @@ void ThreadCheckObfuScationPool()
                 CleanTransactionLocksList();
             }
 
-            //if(c % MASTERNODES_DUMP_SECONDS == 0) DumpMasternodes();
+            // dumps only write what changed, so they are cheap enough to keep the store current
+            if (c % MASTERNODES_DUMP_SECONDS == 0) {
+                DumpMasternodes();
+                DumpBudgets();
+                DumpMasternodePayments();
+            }
 
             obfuScationPool.CheckTimeout();
             obfuScationPool.CheckForCompleteQueue();
@@ -242,6 +242,29 @@ public:
     int64_t sigTime;
 };
 
+/**
+ * Closure recovering the signer of one masternode network message into the recovered key
+ * cache, so that the later VerifyMessage call for the same message only has to look it up
+ */
+class CMessageSignatureCheck
+{
+private:
+    uint256 hashMessage;
+    std::vector<unsigned char> vchSig;
+
+public:
+    CMessageSignatureCheck() {}
+    CMessageSignatureCheck(const std::string& strMessage, const std::vector<unsigned char>& vchSigIn);
+
+    bool operator()();
+
+    void swap(CMessageSignatureCheck& check)
+    {
+        std::swap(hashMessage, check.hashMessage);
+        vchSig.swap(check.vchSig);
+    }
+};
+
 /** Helper object for signing and checking signatures
  */
 class CObfuScationSigner
@@ -257,6 +280,8 @@ public:
     bool SignMessage(std::string strMessage, std::string& errorMessage, std::vector<unsigned char>& vchSig, CKey key);
     /// Verify the message, returns true if succcessful
     bool VerifyMessage(CPubKey pubkey, std::vector<unsigned char>& vchSig, std::string strMessage, std::string& errorMessage);
+    /// Recover the signers of a batch of messages in parallel ahead of their VerifyMessage calls
+    void PrecomputeSignatures(std::vector<CMessageSignatureCheck>& vChecks);
 };
 
 /** Used to keep track of current status of Obfuscation pool
@@ -512,5 +537,6 @@ public:
 };
 
 void ThreadCheckObfuScationPool();
+void ThreadMessageSignatureCheck();
 
 #endif
@@ -13,10 +13,58 @@
 #include "utilstrencodings.h"
 #include "util.h"
 
+#include <cstddef>
+
+static_assert(offsetof(CBlockHeader, nNonce) + sizeof(uint32_t) - offsetof(CBlockHeader, nVersion) == CBlockHeader::LEGACY_HEADER_SIZE,
+              "legacy header fields must be contiguous");
+
+bool CHeaderHashMemo::Get(const unsigned char* pkey, uint256& hashOut) const
+{
+    int nExpected = READY;
+    if (!nState.compare_exchange_strong(nExpected, BUSY, std::memory_order_acquire))
+        return false;
+    bool fHit = memcmp(vchKey, pkey, KEY_SIZE) == 0;
+    if (fHit)
+        hashOut = hash;
+    nState.store(READY, std::memory_order_release);
+    return fHit;
+}
+
+void CHeaderHashMemo::Set(const unsigned char* pkey, const uint256& hashIn) const
+{
+    int nExpected = nState.load(std::memory_order_relaxed);
+    if (nExpected == BUSY || !nState.compare_exchange_strong(nExpected, BUSY, std::memory_order_acquire))
+        return;
+    memcpy(vchKey, pkey, KEY_SIZE);
+    hash = hashIn;
+    nState.store(READY, std::memory_order_release);
+}
+
+void CHeaderHashMemo::CopyFrom(const CHeaderHashMemo& other)
+{
+    int nExpected = READY;
+    if (!other.nState.compare_exchange_strong(nExpected, BUSY, std::memory_order_acquire))
+        return;
+    memcpy(vchKey, other.vchKey, KEY_SIZE);
+    hash = other.hash;
+    other.nState.store(READY, std::memory_order_release);
+    nState.store(READY, std::memory_order_release);
+}
+
 uint256 CBlockHeader::GetHash() const
 {
-	if(nVersion < 4)
-        return XEVAN(BEGIN(nVersion), END(nNonce));
+    if (nVersion < 4) {
+        // XEVAN is expensive, so remember the last result and reuse it for as long as
+        // the hashed header bytes are unchanged (the miner mutates nTime/nNonce in place)
+        const unsigned char* pbegin = (const unsigned char*)BEGIN(nVersion);
+        uint256 hash;
+        if (hashMemo.Get(pbegin, hash))
+            return hash;
+
+        hash = XEVAN(BEGIN(nVersion), END(nNonce));
+        hashMemo.Set(pbegin, hash);
+        return hash;
+    }
 
     return Hash(BEGIN(nVersion), END(nAccumulatorCheckpoint));
 }
@@ -12,10 +12,45 @@
 #include "serialize.h"
 #include "uint256.h"
 
+#include <atomic>
+
 /** The maximum allowed size for a serialized block, in bytes (network rule) */
 static const unsigned int MAX_BLOCK_SIZE_CURRENT = 2000000;
 static const unsigned int MAX_BLOCK_SIZE_LEGACY = 1000000;
 
+/** Last XEVAN result of a header together with the legacy header bytes it was computed from.
+ * Headers are hashed from several threads at once (header batches, message handlers), so the
+ * memo is only touched by whoever wins the busy state; a thread that loses simply recomputes.
+ */
+class CHeaderHashMemo
+{
+public:
+    static const size_t KEY_SIZE = 80;
+
+    CHeaderHashMemo() : nState(EMPTY) {}
+    CHeaderHashMemo(const CHeaderHashMemo& other) : nState(EMPTY) { CopyFrom(other); }
+    CHeaderHashMemo& operator=(const CHeaderHashMemo& other)
+    {
+        if (this != &other) {
+            nState.store(EMPTY, std::memory_order_release);
+            CopyFrom(other);
+        }
+        return *this;
+    }
+
+    void Clear() { nState.store(EMPTY, std::memory_order_release); }
+    bool Get(const unsigned char* pkey, uint256& hashOut) const;
+    void Set(const unsigned char* pkey, const uint256& hashIn) const;
+
+private:
+    enum { EMPTY, BUSY, READY };
+    mutable std::atomic<int> nState;
+    mutable uint256 hash;
+    mutable unsigned char vchKey[KEY_SIZE];
+
+    void CopyFrom(const CHeaderHashMemo& other);
+};
+
 /** Nodes collect new transactions into a block, hash them into a hash tree,
  * and scan through nonce values to make the block's hash satisfy proof-of-work
  * requirements.  When they solve the proof-of-work, they broadcast the block
@@ -36,6 +71,10 @@ public:
     uint32_t nNonce;
     uint256 nAccumulatorCheckpoint;
 
+    // memory only
+    static const size_t LEGACY_HEADER_SIZE = CHeaderHashMemo::KEY_SIZE;
+    CHeaderHashMemo hashMemo;
+
     CBlockHeader()
     {
         SetNull();
@@ -67,6 +106,7 @@ public:
         nBits = 0;
         nNonce = 0;
         nAccumulatorCheckpoint = 0;
+        hashMemo.Clear();
     }
 
     bool IsNull() const
@@ -3,6 +3,15 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "primitives/zerocoin.h"
+#include "hash.h"
+#include "streams.h"
+
+uint256 GetBigNumHash(const CBigNum& bn)
+{
+    CDataStream ss(SER_GETHASH, 0);
+    ss << bn;
+    return Hash(ss.begin(), ss.end());
+}
 
 void CZerocoinSpendReceipt::AddSpend(const CZerocoinSpend& spend)
 {
@@ -10,6 +10,9 @@
 #include "libzerocoin/Denominations.h"
 #include "serialize.h"
 
+/** Hash of a zerocoin serial number or public coin value, used as a compact lookup key */
+uint256 GetBigNumHash(const CBigNum& bn);
+
 class CZerocoinMint
 {
 private:
@@ -172,6 +175,48 @@ public:
     };
 };
 
+/** A partially computed accumulator witness of a wallet mint. The witness covers the pubcoins of the blocks in
+ *  [nHeightAccStart, nHeightAccEnd) so that spending the mint only has to add the blocks accepted since then. */
+class CZerocoinWitness
+{
+public:
+    CBigNum bnPubcoin;
+    int nHeightAccStart;
+    int nHeightAccEnd;
+    uint256 hashBlockEnd; //hash of the last block added, used to detect reorgs
+    CBigNum bnWitness;
+    int nMintsAdded;
+
+    CZerocoinWitness()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        bnPubcoin = 0;
+        nHeightAccStart = 0;
+        nHeightAccEnd = 0;
+        hashBlockEnd = 0;
+        bnWitness = 0;
+        nMintsAdded = 0;
+    }
+
+    bool IsNull() const { return nHeightAccEnd == 0; }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(bnPubcoin);
+        READWRITE(nHeightAccStart);
+        READWRITE(nHeightAccEnd);
+        READWRITE(hashBlockEnd);
+        READWRITE(bnWitness);
+        READWRITE(nMintsAdded);
+    };
+};
+
 class CZerocoinSpendReceipt
 {
 private:
@@ -2330,8 +2330,7 @@ Value listmintedzerocoins(const Array& params, bool fHelp)
     if (pwalletMain->IsLocked())
         throw JSONRPCError(RPC_WALLET_UNLOCK_NEEDED, "Error: Please enter the wallet passphrase with walletpassphrase first.");
     
-    CWalletDB walletdb(pwalletMain->strWalletFile);
-    list<CZerocoinMint> listPubCoin = walletdb.ListMintedCoins(true, false, true);
+    list<CZerocoinMint> listPubCoin = pwalletMain->ListMintedCoins(true, false, true);
     
     Array jsonList;
     for (const CZerocoinMint& pubCoinItem : listPubCoin) {
@@ -2352,13 +2351,7 @@ Value listzerocoinamounts(const Array& params, bool fHelp)
     if (pwalletMain->IsLocked())
         throw JSONRPCError(RPC_WALLET_UNLOCK_NEEDED, "Error: Please enter the wallet passphrase with walletpassphrase first.");
 
-    CWalletDB walletdb(pwalletMain->strWalletFile);
-    list<CZerocoinMint> listPubCoin = walletdb.ListMintedCoins(true, true, true);
- 
-    std::map<libzerocoin::CoinDenomination, CAmount> spread;
-    for (const auto& denom : libzerocoin::zerocoinDenomList)
-        spread.insert(std::pair<libzerocoin::CoinDenomination, CAmount>(denom, 0));
-    for (auto& mint : listPubCoin) spread.at(mint.GetDenomination())++;
+    std::map<libzerocoin::CoinDenomination, CAmount> spread = pwalletMain->GetMyZerocoinDistribution();
 
 
     Array jsonList;
@@ -2544,7 +2537,7 @@ Value resetmintzerocoin(const Array& params, bool fHelp)
         fExtendedSearch = params[0].get_bool();
 
     CWalletDB walletdb(pwalletMain->strWalletFile);
-    list<CZerocoinMint> listMints = walletdb.ListMintedCoins(false, false, true);
+    list<CZerocoinMint> listMints = pwalletMain->ListMintedCoins(false, false, true);
     vector<CZerocoinMint> vMintsToFind{ std::make_move_iterator(std::begin(listMints)), std::make_move_iterator(std::end(listMints)) };
     vector<CZerocoinMint> vMintsMissing;
     vector<CZerocoinMint> vMintsToUpdate;
@@ -2555,7 +2548,7 @@ Value resetmintzerocoin(const Array& params, bool fHelp)
     // update the meta data of mints that were marked for updating
     Array arrUpdated;
     for (CZerocoinMint mint : vMintsToUpdate) {
-        walletdb.WriteZerocoinMint(mint);
+        pwalletMain->WriteZerocoinMint(walletdb, mint);
         arrUpdated.push_back(mint.GetValue().GetHex());
     }
 
@@ -2563,7 +2556,7 @@ Value resetmintzerocoin(const Array& params, bool fHelp)
     Array arrDeleted;
     for (CZerocoinMint mint : vMintsMissing) {
         arrDeleted.push_back(mint.GetValue().GetHex());
-        walletdb.ArchiveMintOrphan(mint);
+        pwalletMain->ArchiveMintOrphan(walletdb, mint);
     }
 
     Object obj;
@@ -2581,7 +2574,7 @@ Value resetspentzerocoin(const Array& params, bool fHelp)
             + HelpRequiringPassphrase());
 
     CWalletDB walletdb(pwalletMain->strWalletFile);
-    list<CZerocoinMint> listMints = walletdb.ListMintedCoins(false, false, false);
+    list<CZerocoinMint> listMints = pwalletMain->ListMintedCoins(false, false, false);
     list<CZerocoinSpend> listSpends = walletdb.ListSpentCoins();
     list<CZerocoinSpend> listUnconfirmedSpends;
 
@@ -2604,8 +2597,8 @@ Value resetspentzerocoin(const Array& params, bool fHelp)
         for (CZerocoinMint mint : listMints) {
             if (mint.GetSerialNumber() == spend.GetSerial()) {
                 mint.SetUsed(false);
-                walletdb.WriteZerocoinMint(mint);
-                walletdb.EraseZerocoinSpendSerialEntry(spend.GetSerial());
+                pwalletMain->WriteZerocoinMint(walletdb, mint);
+                pwalletMain->EraseZerocoinSpendSerialEntry(walletdb, spend.GetSerial());
                 RemoveSerialFromDB(spend.GetSerial());
                 Object obj;
                 obj.push_back(Pair("serial", spend.GetSerial().GetHex()));
@@ -2676,19 +2669,14 @@ Value exportzerocoins(const Array& params, bool fHelp)
     if (pwalletMain->IsLocked())
         throw JSONRPCError(RPC_WALLET_UNLOCK_NEEDED, "Error: Please enter the wallet passphrase with walletpassphrase first.");
 
-    CWalletDB walletdb(pwalletMain->strWalletFile);
-
     bool fIncludeSpent = params[0].get_bool();
     libzerocoin::CoinDenomination denomination = libzerocoin::ZQ_ERROR;
     if (params.size() == 2)
         denomination = libzerocoin::IntToZerocoinDenomination(params[1].get_int());
-    list<CZerocoinMint> listMints = walletdb.ListMintedCoins(!fIncludeSpent, false, false);
+    list<CZerocoinMint> listMints = pwalletMain->ListMintedCoins(!fIncludeSpent, false, false, denomination);
 
     Array jsonList;
     for (const CZerocoinMint mint : listMints) {
-        if (denomination != libzerocoin::ZQ_ERROR && denomination != mint.GetDenomination())
-            continue;
-
         Object objMint;
         objMint.emplace_back(Pair("d", mint.GetDenomination()));
         objMint.emplace_back(Pair("p", mint.GetValue().GetHex()));
@@ -2754,7 +2742,7 @@ Value importzerocoins(const Array& params, bool fHelp)
         CZerocoinMint mint(denom, bnValue, bnRandom, bnSerial, fUsed);
         mint.SetTxHash(txid);
         mint.SetHeight(nHeight);
-        walletdb.WriteZerocoinMint(mint);
+        pwalletMain->WriteZerocoinMint(walletdb, mint);
         count++;
         nValue += libzerocoin::ZerocoinDenominationToAmount(denom);
     }
@@ -61,6 +61,8 @@ class CSporkManager;
 
 extern std::map<uint256, CSporkMessage> mapSporks;
 extern std::map<int, CSporkMessage> mapSporksActive;
+/** Guards mapSporks and mapSporksActive, which are read from any thread through GetSporkValue() */
+extern CCriticalSection cs_mapSporks;
 extern CSporkManager sporkManager;
 
 void LoadSporksFromDB();
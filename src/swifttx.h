@@ -40,6 +40,8 @@ extern map<uint256, CTransaction> mapTxLockReqRejected;
 extern map<uint256, CConsensusVote> mapTxLockVote;
 extern map<uint256, CTransactionLock> mapTxLocks;
 extern std::map<COutPoint, uint256> mapLockedInputs;
+/** Guards mapTxLocks and mapLockedInputs. Block and mempool checks read them under cs_main, so no other lock is taken inside it */
+extern CCriticalSection cs_mapTxLocks;
 extern int nCompleteTXLocks;
 
 
@@ -47,7 +49,7 @@ int64_t CreateNewLock(CTransaction tx);
 
 bool IsIXTXValid(const CTransaction& txCollateral);
 
-// if two conflicting locks are approved by the network, they will cancel out
+// if two conflicting locks are approved by the network, they will cancel out, requires cs_mapTxLocks
 bool CheckForConflictingLocks(CTransaction& tx);
 
 void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
@@ -75,6 +77,7 @@ public:
 
     bool SignatureValid();
     bool Sign();
+    std::string GetStrMessage() const;
 
     ADD_SERIALIZE_METHODS;
 
@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "hash.h"
+#include "crypto/xevan.h"
 #include "utilstrencodings.h"
 
 #include <vector>
@@ -46,4 +47,31 @@ BOOST_AUTO_TEST_CASE(murmurhash3)
 #undef T
 }
 
+BOOST_AUTO_TEST_CASE(xevan_multi_lane)
+{
+    // every lane of the selected kernel must agree with the reference XEVAN, also for
+    // lengths that need a second blake block and for counts that leave lanes idle
+    const size_t vLengths[] = {0, 80, 112, 128, 200};
+    for (size_t nLen : vLengths) {
+        for (size_t nCount = 1; nCount <= 2 * XEVAN_MAX_LANES + 1; nCount++) {
+            vector<vector<unsigned char> > vInput(nCount, vector<unsigned char>(nLen + 1));
+            vector<vector<unsigned char> > vOutput(nCount, vector<unsigned char>(32));
+            vector<const unsigned char*> vpInput;
+            vector<unsigned char*> vpOutput;
+            for (size_t i = 0; i < nCount; i++) {
+                for (size_t j = 0; j < nLen; j++)
+                    vInput[i][j] = (unsigned char)(i * 31 + j * 7);
+                vpInput.push_back(&vInput[i][0]);
+                vpOutput.push_back(&vOutput[i][0]);
+            }
+
+            XevanMulti(&vpOutput[0], &vpInput[0], nLen, nCount);
+            for (size_t i = 0; i < nCount; i++) {
+                uint256 hash = XEVAN(vInput[i].begin(), vInput[i].begin() + nLen);
+                BOOST_CHECK(vector<unsigned char>(hash.begin(), hash.end()) == vOutput[i]);
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,30 @@
+// Copyright (c) 2026 The Loonie developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "kernel.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(kernel_tests)
+
+BOOST_AUTO_TEST_CASE(stake_kernel_hasher)
+{
+    uint64_t nStakeModifier = 0x0123456789abcdefULL;
+    unsigned int nTimeBlockFrom = 1500000000;
+    COutPoint prevout(uint256("0xa1b2c3d4e5f60718293a4b5c6d7e8f90a1b2c3d4e5f60718293a4b5c6d7e8f90"), 3);
+
+    CStakeKernelHasher hasher(nStakeModifier, nTimeBlockFrom, prevout);
+    for (unsigned int nTimeTx = nTimeBlockFrom + 3600; nTimeTx < nTimeBlockFrom + 3700; nTimeTx++) {
+        CDataStream ss(SER_GETHASH, 0);
+        ss << nStakeModifier;
+        BOOST_CHECK(hasher.GetHash(nTimeTx) == stakeHash(nTimeTx, ss, prevout.n, prevout.hash, nTimeBlockFrom));
+    }
+
+    // the hasher can be reused, earlier tries do not leak into later ones
+    CDataStream ss(SER_GETHASH, 0);
+    ss << nStakeModifier;
+    BOOST_CHECK(hasher.GetHash(nTimeBlockFrom) == stakeHash(nTimeBlockFrom, ss, prevout.n, prevout.hash, nTimeBlockFrom));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -5,8 +5,13 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "primitives/transaction.h"
+#include "chainparams.h"
+#include "coins.h"
 #include "main.h"
 
+#include <atomic>
+#include <thread>
+
 #include <boost/test/unit_test.hpp>
 
 BOOST_AUTO_TEST_SUITE(main_tests)
@@ -48,4 +53,173 @@ BOOST_AUTO_TEST_CASE(subsidy_limit_test)
     BOOST_CHECK(nSum == 4109975100000000ULL);
 }
 
+BOOST_AUTO_TEST_CASE(block_header_hash_cache)
+{
+    CBlockHeader header;
+    header.nVersion = 3;
+    header.nTime = 1500000000;
+    header.nBits = 0x1e0ffff0;
+    header.nNonce = 1;
+
+    uint256 hash = header.GetHash();
+    BOOST_CHECK(header.GetHash() == hash);
+
+    // mutating a hashed field must invalidate the cached result
+    header.nNonce++;
+    uint256 hashNext = header.GetHash();
+    BOOST_CHECK(hashNext != hash);
+
+    CBlockHeader fresh;
+    fresh.nVersion = header.nVersion;
+    fresh.nTime = header.nTime;
+    fresh.nBits = header.nBits;
+    fresh.nNonce = header.nNonce;
+    BOOST_CHECK(fresh.GetHash() == hashNext);
+
+    // copies carry a cache that is still valid for their own fields
+    CBlock block(header);
+    BOOST_CHECK(block.GetHash() == hashNext);
+    block.nNonce--;
+    BOOST_CHECK(block.GetHash() == hash);
+}
+
+BOOST_AUTO_TEST_CASE(block_header_batch_hashes)
+{
+    std::vector<CBlockHeader> vHeaders(100);
+    for (size_t i = 0; i < vHeaders.size(); i++) {
+        vHeaders[i].nVersion = i % 10 == 0 ? 4 : 3;
+        vHeaders[i].nTime = 1500000000 + i;
+        vHeaders[i].nBits = 0x1e0ffff0;
+        vHeaders[i].nNonce = i;
+    }
+
+    PrecomputeBlockHeaderHashes(vHeaders);
+    for (const CBlockHeader& header : vHeaders) {
+        CBlockHeader fresh;
+        fresh.nVersion = header.nVersion;
+        fresh.nTime = header.nTime;
+        fresh.nBits = header.nBits;
+        fresh.nNonce = header.nNonce;
+        BOOST_CHECK(header.GetHash() == fresh.GetHash());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(block_header_hash_shared)
+{
+    CBlockHeader header;
+    header.nVersion = 3;
+    header.nTime = 1500000000;
+    header.nBits = 0x1e0ffff0;
+    CBlockHeader fresh(header);
+    uint256 hashExpected = fresh.GetHash();
+
+    // threads racing on one shared header must all see the right hash
+    std::vector<std::thread> vThreads;
+    std::atomic<int> nMismatches(0);
+    for (int i = 0; i < 4; i++) {
+        vThreads.emplace_back([&header, &hashExpected, &nMismatches]() {
+            for (int j = 0; j < 50; j++) {
+                if (header.GetHash() != hashExpected)
+                    nMismatches++;
+                CBlockHeader copy(header);
+                if (copy.GetHash() != hashExpected)
+                    nMismatches++;
+            }
+        });
+    }
+    for (std::thread& t : vThreads)
+        t.join();
+    BOOST_CHECK_EQUAL(nMismatches.load(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(read_raw_block)
+{
+    CBlock block = Params().GenesisBlock();
+    CDiskBlockPos pos(1000, 0);
+    BOOST_CHECK(WriteBlockToDisk(block, pos));
+
+    // the bytes on disk are what the block serializes to on the network
+    CDataStream ssRaw(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK(ReadRawBlockFromDisk(ssRaw, pos, block.GetHash()));
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    ssBlock << block;
+    BOOST_CHECK(ssRaw.str() == ssBlock.str());
+
+    CDataStream ssOther(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK(!ReadRawBlockFromDisk(ssOther, pos, uint256(1)));
+}
+
+BOOST_AUTO_TEST_CASE(header_only_proof_of_stake)
+{
+    LOCK(cs_main);
+    CBlockIndex* pindexTipOld = chainActive.Tip();
+    CBlockIndex* pindexBestHeaderOld = pindexBestHeader;
+    ModifiableParams()->setSkipProofOfWorkCheck(true);
+
+    // headers up to the last proof of work block go in whatever the active chain
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    CValidationState state;
+    CBlock header;
+    while (pindexPrev->nHeight < Params().LAST_POW_BLOCK()) {
+        header = CBlock();
+        header.hashPrevBlock = pindexPrev->GetBlockHash();
+        header.nTime = pindexPrev->nTime + Params().TargetSpacing();
+        header.nBits = GetNextWorkRequired(pindexPrev, &header);
+        BOOST_REQUIRE(AcceptBlockHeader(header, state, &pindexPrev));
+    }
+    BOOST_CHECK(pindexBestHeader == pindexPrev);
+
+    // a proof of stake header further ahead of the active chain than block download goes is left for later
+    chainActive.SetTip(pindexPrev->GetAncestor(Params().LAST_POW_BLOCK() - MAX_HEADERS_AHEAD));
+    header = CBlock();
+    header.hashPrevBlock = pindexPrev->GetBlockHash();
+    header.nTime = pindexPrev->nTime + Params().TargetSpacing();
+    header.nBits = GetNextWorkRequired(pindexPrev, &header);
+    int nDoS = -1;
+    BOOST_CHECK(!AcceptBlockHeader(header, state, NULL));
+    BOOST_CHECK(state.IsInvalid(nDoS) && nDoS == 0);
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "headers-ahead");
+    BOOST_CHECK(!mapBlockIndex.count(header.GetHash()));
+
+    // closer to the active chain it is indexed as proof of stake, without a proof hash and not as the best header
+    chainActive.SetTip(pindexPrev->GetAncestor(Params().LAST_POW_BLOCK() - MAX_HEADERS_AHEAD + 10));
+    CValidationState stateAhead;
+    CBlockIndex* pindex = NULL;
+    BOOST_CHECK(AcceptBlockHeader(header, stateAhead, &pindex));
+    BOOST_REQUIRE(pindex != NULL);
+    BOOST_CHECK(pindex->IsProofOfStake());
+    BOOST_CHECK(pindex->hashProofOfStake == 0);
+    BOOST_CHECK(!(pindex->nStatus & BLOCK_HAVE_DATA));
+    BOOST_CHECK(pindexBestHeader == pindexPrev);
+
+    // a block without a proof hash has its stake kernel checked when it is connected
+    CMutableTransaction txCoinBase;
+    txCoinBase.vin.resize(1);
+    txCoinBase.vin[0].prevout.SetNull();
+    txCoinBase.vout.resize(1);
+    txCoinBase.vout[0].SetEmpty();
+    CMutableTransaction txCoinStake;
+    txCoinStake.vin.resize(1);
+    txCoinStake.vin[0].prevout = COutPoint(uint256(12345), 0);
+    txCoinStake.vout.resize(2);
+    txCoinStake.vout[0].SetEmpty();
+    txCoinStake.vout[1].nValue = COIN;
+    txCoinStake.vout[1].scriptPubKey = CScript() << OP_TRUE;
+    CBlock block(header);
+    block.vtx.push_back(CTransaction(txCoinBase));
+    block.vtx.push_back(CTransaction(txCoinStake));
+    BOOST_CHECK(block.IsProofOfStake());
+
+    CCoinsView viewDummy;
+    CCoinsViewCache view(&viewDummy);
+    view.SetBestBlock(pindexPrev->GetBlockHash());
+    CValidationState stateConnect;
+    BOOST_CHECK(!ConnectBlock(block, stateConnect, pindex, view, false, true));
+    BOOST_CHECK_EQUAL(stateConnect.GetRejectReason(), "bad-proofofstake");
+
+    chainActive.SetTip(pindexTipOld);
+    pindexBestHeader = pindexBestHeaderOld;
+    ModifiableParams()->setSkipProofOfWorkCheck(false);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
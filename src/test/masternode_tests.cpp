@@ -0,0 +1,335 @@
+// Copyright (c) 2026 The Loonie developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "clientversion.h"
+#include "masternode-budget.h"
+#include "masternode-payments.h"
+#include "masternodedb.h"
+#include "masternodeman.h"
+#include "obfuscation.h"
+#include "script/standard.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(masternode_tests)
+
+static CMasternode MakeMasternode(unsigned int n, CKey& keyCollateral, CKey& keyMasternode)
+{
+    keyCollateral.MakeNewKey(true);
+    keyMasternode.MakeNewKey(true);
+
+    CMasternode mn;
+    mn.vin = CTxIn(GetRandHash(), n);
+    mn.pubKeyCollateralAddress = keyCollateral.GetPubKey();
+    mn.pubKeyMasternode = keyMasternode.GetPubKey();
+    return mn;
+}
+
+BOOST_AUTO_TEST_CASE(masternodeman_find_indexes)
+{
+    CMasternodeMan man;
+    std::vector<CMasternode> vMasternodes;
+    for (unsigned int i = 0; i < 5; i++) {
+        CKey keyCollateral, keyMasternode;
+        vMasternodes.push_back(MakeMasternode(i, keyCollateral, keyMasternode));
+        BOOST_CHECK(man.Add(vMasternodes.back()));
+    }
+    // an entry for the same collateral is not added twice
+    BOOST_CHECK(!man.Add(vMasternodes[2]));
+    BOOST_CHECK_EQUAL(man.size(), 5);
+
+    for (const CMasternode& mn : vMasternodes) {
+        CScript payee = GetScriptForDestination(mn.pubKeyCollateralAddress.GetID());
+        BOOST_CHECK(man.Find(mn.vin) && man.Find(mn.vin)->vin == mn.vin);
+        BOOST_CHECK(man.Find(payee) && man.Find(payee)->vin == mn.vin);
+        BOOST_CHECK(man.Find(mn.pubKeyMasternode) && man.Find(mn.pubKeyMasternode)->vin == mn.vin);
+
+        // only the pay-to-pubkey-hash script of the collateral key is its payee
+        BOOST_CHECK(man.Find(CScript() << ToByteVector(mn.pubKeyCollateralAddress) << OP_CHECKSIG) == NULL);
+    }
+
+    // removing an entry moves the later ones in the list, they are still found
+    man.Remove(vMasternodes[1].vin);
+    BOOST_CHECK(man.Find(vMasternodes[1].vin) == NULL);
+    BOOST_CHECK(man.Find(vMasternodes[1].pubKeyMasternode) == NULL);
+    BOOST_CHECK(man.Find(GetScriptForDestination(vMasternodes[1].pubKeyCollateralAddress.GetID())) == NULL);
+    for (unsigned int i = 2; i < vMasternodes.size(); i++) {
+        BOOST_CHECK(man.Find(vMasternodes[i].vin)->vin == vMasternodes[i].vin);
+        BOOST_CHECK(man.Find(vMasternodes[i].pubKeyMasternode)->vin == vMasternodes[i].vin);
+    }
+
+    man.Clear();
+    BOOST_CHECK(man.Find(vMasternodes[0].vin) == NULL);
+}
+
+BOOST_AUTO_TEST_CASE(masternodeman_shared_collateral_key)
+{
+    // several masternodes can be paid to the same collateral address, the first one is found
+    CMasternodeMan man;
+    CKey keyCollateral, keyMasternode, keyCollateral2, keyMasternode2;
+    CMasternode mn1 = MakeMasternode(0, keyCollateral, keyMasternode);
+    CMasternode mn2 = MakeMasternode(1, keyCollateral2, keyMasternode2);
+    mn2.pubKeyCollateralAddress = mn1.pubKeyCollateralAddress;
+    BOOST_CHECK(man.Add(mn1));
+    BOOST_CHECK(man.Add(mn2));
+
+    CScript payee = GetScriptForDestination(mn1.pubKeyCollateralAddress.GetID());
+    BOOST_CHECK(man.Find(payee)->vin == mn1.vin);
+    man.Remove(mn1.vin);
+    BOOST_CHECK(man.Find(payee)->vin == mn2.vin);
+}
+
+BOOST_AUTO_TEST_CASE(masternodeman_rank_table)
+{
+    CMasternodeMan man;
+    for (unsigned int i = 0; i < 3; i++) {
+        CKey keyCollateral, keyMasternode;
+        CMasternode mn = MakeMasternode(i, keyCollateral, keyMasternode);
+        BOOST_CHECK(man.Add(mn));
+    }
+
+    std::set<COutPoint> setRanked;
+    for (int nRank = 1; nRank <= 3; nRank++) {
+        CMasternode* pmn = man.GetMasternodeByRank(nRank, 0, 0, false);
+        BOOST_CHECK(pmn != NULL);
+        if (pmn)
+            setRanked.insert(pmn->vin.prevout);
+    }
+    BOOST_CHECK_EQUAL(setRanked.size(), 3U);
+    BOOST_CHECK(man.GetMasternodeByRank(0, 0, 0, false) == NULL);
+    BOOST_CHECK(man.GetMasternodeByRank(4, 0, 0, false) == NULL);
+
+    // the cached table is dropped when the list changes
+    CTxIn vinFirst = man.GetMasternodeByRank(1, 0, 0, false)->vin;
+    man.Remove(vinFirst);
+    BOOST_CHECK(man.GetMasternodeByRank(3, 0, 0, false) == NULL);
+    BOOST_CHECK(man.GetMasternodeByRank(1, 0, 0, false)->vin != vinFirst);
+}
+
+BOOST_AUTO_TEST_CASE(masternode_payments_last_paid)
+{
+    CKey key1, key2;
+    key1.MakeNewKey(true);
+    key2.MakeNewKey(true);
+    CScript payee1 = GetScriptForDestination(key1.GetPubKey().GetID());
+    CScript payee2 = GetScriptForDestination(key2.GetPubKey().GetID());
+
+    CMasternodePayments payments;
+    for (int nHeight = 100; nHeight <= 130; nHeight += 10) {
+        CMasternodeBlockPayees blockPayees(nHeight);
+        blockPayees.AddPayee(payee1, 2);
+        blockPayees.AddPayee(payee2, 1); // a single vote is not a payment
+        payments.mapMasternodeBlocks[nHeight] = blockPayees;
+    }
+
+    // the index is rebuilt when the payment votes are read back from mnpayments.dat
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << payments;
+    CMasternodePayments paymentsLoaded;
+    ss >> paymentsLoaded;
+
+    BOOST_CHECK_EQUAL(paymentsLoaded.GetLastPaidHeight(payee1, 200), 130);
+    BOOST_CHECK_EQUAL(paymentsLoaded.GetLastPaidHeight(payee1, 125), 120);
+    BOOST_CHECK_EQUAL(paymentsLoaded.GetLastPaidHeight(payee1, 100), 100);
+    BOOST_CHECK_EQUAL(paymentsLoaded.GetLastPaidHeight(payee1, 99), 0);
+    BOOST_CHECK_EQUAL(paymentsLoaded.GetLastPaidHeight(payee2, 200), 0);
+}
+
+BOOST_AUTO_TEST_CASE(masternode_ping_signature_precompute)
+{
+    CKey keyCollateral, keyMasternode;
+    CMasternode mn = MakeMasternode(0, keyCollateral, keyMasternode);
+
+    CMasternodePing mnp;
+    mnp.vin = mn.vin;
+    mnp.blockHash = GetRandHash();
+    BOOST_CHECK(mnp.Sign(keyMasternode, mn.pubKeyMasternode));
+
+    CMasternodePing mnpOther;
+    mnpOther.vin = mn.vin;
+    mnpOther.blockHash = GetRandHash();
+    BOOST_CHECK(mnpOther.Sign(keyCollateral, mn.pubKeyCollateralAddress));
+
+    std::vector<CMessageSignatureCheck> vChecks;
+    vChecks.push_back(CMessageSignatureCheck(mnp.GetStrMessage(), mnp.vchSig));
+    vChecks.push_back(CMessageSignatureCheck(mnpOther.GetStrMessage(), mnpOther.vchSig));
+    obfuScationSigner.PrecomputeSignatures(vChecks);
+
+    // a recovered key is only reused for the message and signature it was recovered from
+    std::string strError;
+    BOOST_CHECK(obfuScationSigner.VerifyMessage(mn.pubKeyMasternode, mnp.vchSig, mnp.GetStrMessage(), strError));
+    BOOST_CHECK(!obfuScationSigner.VerifyMessage(mn.pubKeyMasternode, mnpOther.vchSig, mnpOther.GetStrMessage(), strError));
+    BOOST_CHECK(!obfuScationSigner.VerifyMessage(mn.pubKeyMasternode, mnpOther.vchSig, mnp.GetStrMessage(), strError));
+    BOOST_CHECK(obfuScationSigner.VerifyMessage(mn.pubKeyCollateralAddress, mnpOther.vchSig, mnpOther.GetStrMessage(), strError));
+}
+
+BOOST_AUTO_TEST_CASE(masternode_collateral_watch)
+{
+    CMasternodeCollateralWatch watch;
+    RegisterValidationInterface(&watch);
+
+    COutPoint collateral(GetRandHash(), 0);
+    bool fSpent = true;
+    BOOST_CHECK(!watch.GetSpent(collateral, fSpent));
+    {
+        LOCK(cs_main);
+        watch.Watch(collateral);
+    }
+    BOOST_CHECK(watch.GetSpent(collateral, fSpent) && !fSpent);
+
+    CMutableTransaction tx;
+    tx.vin.push_back(CTxIn(collateral));
+    tx.vout.push_back(CTxOut(1 * COIN, CScript() << OP_TRUE));
+    CBlock block;
+    block.vtx.push_back(CTransaction(tx));
+
+    // confirmed in a block, then the block is disconnected and the spend doesn't make it back
+    // into the mempool
+    SyncWithWallets(block.vtx[0], &block);
+    BOOST_CHECK(watch.GetSpent(collateral, fSpent) && fSpent);
+    SyncWithWallets(block.vtx[0], NULL);
+    BOOST_CHECK(watch.GetSpent(collateral, fSpent) && !fSpent);
+
+    watch.Unwatch(collateral);
+    BOOST_CHECK(!watch.GetSpent(collateral, fSpent));
+    UnregisterValidationInterface(&watch);
+}
+
+BOOST_AUTO_TEST_CASE(masternode_collateral_watch_funding_disconnected)
+{
+    CMasternodeCollateralWatch watch;
+    RegisterValidationInterface(&watch);
+
+    CMutableTransaction txFunding;
+    txFunding.vin.push_back(CTxIn(COutPoint(GetRandHash(), 0)));
+    txFunding.vout.push_back(CTxOut(1 * COIN, CScript() << OP_TRUE));
+    txFunding.vout.push_back(CTxOut(10000 * COIN, CScript() << OP_TRUE));
+    CBlock block;
+    block.vtx.push_back(CTransaction(txFunding));
+    SyncWithWallets(block.vtx[0], &block);
+
+    COutPoint collateral(block.vtx[0].GetHash(), 1);
+    COutPoint other(GetRandHash(), 0);
+    {
+        LOCK(cs_main);
+        watch.Watch(collateral);
+        watch.Watch(other);
+    }
+    bool fSpent = true;
+    BOOST_CHECK(watch.GetSpent(collateral, fSpent) && !fSpent);
+
+    // the funding transaction is disconnected and conflicted out of the mempool: nothing ever spends
+    // the collateral, but it no longer exists, so it must be looked up again instead of reported unspent
+    SyncWithWallets(block.vtx[0], NULL);
+    BOOST_CHECK(!watch.GetSpent(collateral, fSpent));
+    BOOST_CHECK(watch.GetSpent(other, fSpent) && !fSpent);
+
+    watch.Unwatch(other);
+    UnregisterValidationInterface(&watch);
+}
+
+BOOST_AUTO_TEST_CASE(masternodeman_clear_unwatches_collateral)
+{
+    CMasternodeMan man;
+    CKey keyCollateral, keyMasternode;
+    CMasternode mn = MakeMasternode(0, keyCollateral, keyMasternode);
+    BOOST_CHECK(man.Add(mn));
+    {
+        LOCK(cs_main);
+        masternodeCollateralWatch.Watch(mn.vin.prevout);
+    }
+    bool fSpent = true;
+    BOOST_CHECK(masternodeCollateralWatch.GetSpent(mn.vin.prevout, fSpent) && !fSpent);
+
+    // dropping the whole list stops watching its collaterals like removing single entries does
+    man.Clear();
+    BOOST_CHECK(!masternodeCollateralWatch.GetSpent(mn.vin.prevout, fSpent));
+}
+
+BOOST_AUTO_TEST_CASE(masternode_state_db_sync)
+{
+    CMasternodeStateDB db(1 << 20, true);
+
+    std::map<uint256, int> mapRecords;
+    for (int i = 0; i < 10; i++)
+        mapRecords[GetRandHash()] = i;
+
+    CLevelDBBatch batch;
+    db.SyncRecords(batch, 'x', mapRecords, false);
+    BOOST_CHECK(db.WriteBatch(batch));
+
+    // drop one record, change another, then sync again
+    uint256 hashErased = mapRecords.begin()->first;
+    mapRecords.erase(mapRecords.begin());
+    mapRecords.begin()->second = 100;
+    CLevelDBBatch batch2;
+    db.SyncRecords(batch2, 'x', mapRecords, false);
+    BOOST_CHECK(db.WriteBatch(batch2));
+
+    std::map<uint256, int> mapRead;
+    BOOST_CHECK(db.ReadRecords('x', mapRead, false));
+    BOOST_CHECK(mapRead == mapRecords);
+    BOOST_CHECK(!db.Exists(std::make_pair('x', hashErased)));
+}
+
+BOOST_AUTO_TEST_CASE(masternode_state_db_version)
+{
+    CMasternodeStateDB db(1 << 20, true);
+    int nVersion = 0;
+
+    // the store is only marked current once every collection was written in full
+    BOOST_CHECK(db.MarkWritten(CMasternodeStateDB::STATE_MASTERNODES));
+    BOOST_CHECK(db.MarkWritten(CMasternodeStateDB::STATE_BUDGETS));
+    BOOST_CHECK(!db.ReadVersion(nVersion));
+    BOOST_CHECK(db.MarkWritten(CMasternodeStateDB::STATE_PAYMENTS));
+    BOOST_CHECK(db.ReadVersion(nVersion) && nVersion == MASTERNODE_STATE_VERSION);
+}
+
+BOOST_AUTO_TEST_CASE(budget_proposal_vote_tally)
+{
+    CBudgetProposal proposal("test", "http://test", 0, 100, CScript(), 100 * COIN, 0);
+    uint256 hashProposal = proposal.GetHash();
+    std::string strError;
+
+    std::vector<CBudgetVote> vVotes;
+    vVotes.push_back(CBudgetVote(CTxIn(GetRandHash(), 0), hashProposal, VOTE_YES));
+    vVotes.push_back(CBudgetVote(CTxIn(GetRandHash(), 0), hashProposal, VOTE_YES));
+    vVotes.push_back(CBudgetVote(CTxIn(GetRandHash(), 0), hashProposal, VOTE_NO));
+    vVotes.push_back(CBudgetVote(CTxIn(GetRandHash(), 0), hashProposal, VOTE_ABSTAIN));
+    BOOST_FOREACH (CBudgetVote& vote, vVotes) {
+        vote.nTime -= BUDGET_VOTE_UPDATE_MIN;
+        BOOST_CHECK(proposal.AddOrUpdateVote(vote, strError));
+    }
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), 2);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), 1);
+    BOOST_CHECK_EQUAL(proposal.GetAbstains(), 1);
+
+    // a changed vote moves between the counts
+    CBudgetVote voteChanged(vVotes[0].vin, hashProposal, VOTE_NO);
+    BOOST_CHECK(proposal.AddOrUpdateVote(voteChanged, strError));
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), 1);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), 2);
+    BOOST_CHECK_EQUAL(proposal.GetRatio(), 1.0 / 3.0);
+
+    CBudgetProposal proposalCopy(proposal);
+    BOOST_CHECK_EQUAL(proposalCopy.GetYeas(), 1);
+    BOOST_CHECK_EQUAL(proposalCopy.GetNays(), 2);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << proposal;
+    CBudgetProposal proposalRead;
+    ss >> proposalRead;
+    BOOST_CHECK_EQUAL(proposalRead.GetYeas(), 1);
+    BOOST_CHECK_EQUAL(proposalRead.GetNays(), 2);
+    BOOST_CHECK_EQUAL(proposalRead.GetAbstains(), 1);
+
+    // none of the voters is a known masternode, so cleaning leaves no valid votes, the ratio counts them all
+    proposal.CleanAndRemove(false);
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), 0);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), 0);
+    BOOST_CHECK_EQUAL(proposal.GetAbstains(), 0);
+    BOOST_CHECK_EQUAL(proposal.GetRatio(), 1.0 / 3.0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
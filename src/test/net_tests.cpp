@@ -0,0 +1,209 @@
+// Copyright (c) 2026 The Loonie developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "net.h"
+
+#include <boost/foreach.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(net_tests)
+
+#ifndef WIN32
+/** Connected sockets with a small send buffer, so big messages only go out in parts. Returns the send buffer size. */
+static int CreateSocketPair(SOCKET sockets[2])
+{
+    int fds[2];
+    BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    sockets[0] = fds[0];
+    sockets[1] = fds[1];
+    int nSendBuffer = 8192;
+    setsockopt(sockets[0], SOL_SOCKET, SO_SNDBUF, &nSendBuffer, sizeof(nSendBuffer));
+    socklen_t nLen = sizeof(nSendBuffer);
+    BOOST_REQUIRE_EQUAL(getsockopt(sockets[0], SOL_SOCKET, SO_SNDBUF, &nSendBuffer, &nLen), 0);
+    return nSendBuffer;
+}
+
+static CSendBuffer CreateLargeSendBuffer(size_t nSize, unsigned char chFill)
+{
+    CDataStream ssPayload(SER_NETWORK, PROTOCOL_VERSION);
+    ssPayload << std::vector<unsigned char>(nSize, chFill);
+    return CreateSendBuffer("block", ssPayload);
+}
+
+static void ReadAvailable(SOCKET hSocket, std::vector<unsigned char>& vRecv)
+{
+    char pchBuf[0x10000];
+    while (true) {
+        ssize_t nBytes = recv(hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+        if (nBytes <= 0)
+            break;
+        vRecv.insert(vRecv.end(), pchBuf, pchBuf + nBytes);
+    }
+}
+
+/** Keep the peer reading until the node has sent everything it queued */
+static void SendAll(CNode& node, SOCKET hPeer, std::vector<unsigned char>& vRecv)
+{
+    for (int i = 0; i < 1000 && !node.vSendMsg.empty(); i++) {
+        ReadAvailable(hPeer, vRecv);
+        LOCK(node.cs_vSend);
+        SocketSendData(&node);
+    }
+    ReadAvailable(hPeer, vRecv);
+    BOOST_CHECK(node.vSendMsg.empty());
+    BOOST_CHECK(!node.fDisconnect);
+}
+
+BOOST_AUTO_TEST_CASE(send_buffer_shared)
+{
+    CDataStream ssPayload(SER_NETWORK, PROTOCOL_VERSION);
+    ssPayload << std::string("shared payload") << uint256(42);
+
+    SOCKET sockets1[2], sockets2[2], sockets3[2];
+    int nSendBuffer = CreateSocketPair(sockets1);
+    CreateSocketPair(sockets2);
+    CreateSocketPair(sockets3);
+    CNode node1(sockets1[0], CAddress(CService("127.0.0.1", 0)), "", true);
+    CNode node2(sockets2[0], CAddress(CService("127.0.0.2", 0)), "", true);
+    CNode node3(sockets3[0], CAddress(CService("127.0.0.3", 0)), "", true);
+
+    // a small message goes out at once
+    node1.PushMessage("tx", ssPayload);
+    BOOST_CHECK(node1.vSendMsg.empty());
+    BOOST_CHECK_EQUAL(node1.nSendSize, 0U);
+
+    // keep the other two busy with a message too big for one write, so the shared one has to queue
+    CSendBuffer msgLarge = CreateLargeSendBuffer(4 * nSendBuffer, 0x55);
+    CSendBuffer msg = CreateSendBuffer("tx", ssPayload);
+    node2.PushSendBuffer(msgLarge);
+    node3.PushSendBuffer(msgLarge);
+    node2.PushSendBuffer(msg);
+    node3.PushSendBuffer(msg);
+
+    // both peers queue the very same buffer
+    BOOST_REQUIRE_EQUAL(node2.vSendMsg.size(), 2U);
+    BOOST_REQUIRE_EQUAL(node3.vSendMsg.size(), 2U);
+    BOOST_CHECK(node2.vSendMsg[1] == msg);
+    BOOST_CHECK(node3.vSendMsg[1] == msg);
+    BOOST_CHECK_EQUAL(node3.nSendSize, msgLarge->size() + msg->size());
+    BOOST_CHECK_EQUAL(msg.use_count(), 3);
+
+    // and each gets out exactly what a message serialized for a single peer does
+    std::vector<unsigned char> vRecv1, vRecv2, vRecv3;
+    SendAll(node1, sockets1[1], vRecv1);
+    SendAll(node2, sockets2[1], vRecv2);
+    SendAll(node3, sockets3[1], vRecv3);
+    std::vector<unsigned char> vExpected(msgLarge->begin(), msgLarge->end());
+    vExpected.insert(vExpected.end(), msg->begin(), msg->end());
+    BOOST_CHECK(vRecv1 == std::vector<unsigned char>(msg->begin(), msg->end()));
+    BOOST_CHECK(vRecv2 == vExpected);
+    BOOST_CHECK(vRecv3 == vExpected);
+
+    // the peers let go of the buffer once it is sent
+    BOOST_CHECK_EQUAL(msg.use_count(), 1);
+
+    CloseSocket(sockets1[1]);
+    CloseSocket(sockets2[1]);
+    CloseSocket(sockets3[1]);
+}
+
+BOOST_AUTO_TEST_CASE(send_buffer_partial_write)
+{
+    SOCKET sockets[2];
+    int nSendBuffer = CreateSocketPair(sockets);
+    CNode node(sockets[0], CAddress(CService("127.0.0.1", 0)), "", true);
+
+    // messages several times the socket buffer, so every write stops part way into one of them
+    std::vector<CSendBuffer> vMsgs;
+    std::vector<unsigned char> vExpected;
+    for (int i = 0; i < 3; i++) {
+        vMsgs.push_back(CreateLargeSendBuffer(4 * nSendBuffer + 7 * i, i + 1));
+        vExpected.insert(vExpected.end(), vMsgs.back()->begin(), vMsgs.back()->end());
+        node.PushSendBuffer(vMsgs.back());
+    }
+
+    // only the first one was tried right away, and it did not fit
+    BOOST_REQUIRE_EQUAL(node.vSendMsg.size(), 3U);
+    BOOST_CHECK(node.nSendOffset > 0);
+    BOOST_CHECK_EQUAL(node.nSendSize, vExpected.size());
+
+    std::vector<unsigned char> vRecv;
+    bool fCrossed = false;
+    for (int i = 0; i < 1000 && !node.vSendMsg.empty(); i++) {
+        ReadAvailable(sockets[1], vRecv);
+        LOCK(node.cs_vSend);
+        size_t nQueued = node.vSendMsg.size();
+        SocketSendData(&node);
+
+        // a write that finished a message and went on into the next one carries its offset over
+        if (node.vSendMsg.size() < nQueued && node.nSendOffset > 0)
+            fCrossed = true;
+
+        size_t nQueuedSize = 0;
+        BOOST_FOREACH (const CSendBuffer& msg, node.vSendMsg)
+            nQueuedSize += msg->size();
+        BOOST_CHECK_EQUAL(node.nSendSize, nQueuedSize);
+        if (!node.vSendMsg.empty())
+            BOOST_CHECK(node.nSendOffset < node.vSendMsg.front()->size());
+        BOOST_CHECK_EQUAL(node.nSendBytes + node.nSendSize - node.nSendOffset, vExpected.size());
+    }
+    ReadAvailable(sockets[1], vRecv);
+
+    BOOST_CHECK(fCrossed);
+    BOOST_CHECK(node.vSendMsg.empty());
+    BOOST_CHECK_EQUAL(node.nSendOffset, 0U);
+    BOOST_CHECK_EQUAL(node.nSendSize, 0U);
+    BOOST_CHECK(!node.fDisconnect);
+
+    // nothing went out twice or got skipped at the message boundaries
+    BOOST_CHECK(vRecv == vExpected);
+    BOOST_FOREACH (const CSendBuffer& msg, vMsgs)
+        BOOST_CHECK_EQUAL(msg.use_count(), 1);
+
+    CloseSocket(sockets[1]);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(message_handler_schedule)
+{
+    std::vector<CNode*> vNodes;
+    for (int i = 0; i < 8; i++)
+        vNodes.push_back(new CNode(INVALID_SOCKET, CAddress(CService("127.0.0.1", 0)), "", true));
+
+    // every peer is served by one of the threads, and all of them get peers
+    CMessageHandlerSchedule schedule(4);
+    std::set<int> setThreads;
+    BOOST_FOREACH (CNode* pnode, vNodes) {
+        int nThread = schedule.GetThread(pnode->GetId());
+        BOOST_CHECK(nThread >= 0 && nThread < 4);
+        BOOST_CHECK_EQUAL(schedule.GetThread(pnode->GetId()), nThread);
+        setThreads.insert(nThread);
+    }
+    BOOST_CHECK_EQUAL(setThreads.size(), 4U);
+
+    // however often the threads come round, one peer gets trickled per interval
+    for (int64_t nNow = 1000; nNow < 2000; nNow += TRICKLE_INTERVAL) {
+        int nTrickles = 0;
+        for (int nRound = 0; nRound < 3; nRound++) {
+            for (int nThread = 0; nThread < 4; nThread++) {
+                CNode* pnodeTrickle = schedule.TakeTrickleNode(vNodes, nThread, nNow + nRound);
+                if (pnodeTrickle == NULL)
+                    continue;
+                BOOST_CHECK_EQUAL(schedule.GetThread(pnodeTrickle->GetId()), nThread);
+                nTrickles++;
+            }
+        }
+        BOOST_CHECK_EQUAL(nTrickles, 1);
+    }
+
+    // without peers there is nobody to trickle to
+    CMessageHandlerSchedule scheduleEmpty(4);
+    for (int nThread = 0; nThread < 4; nThread++)
+        BOOST_CHECK(scheduleEmpty.TakeTrickleNode(std::vector<CNode*>(), nThread, 1000) == NULL);
+
+    BOOST_FOREACH (CNode* pnode, vNodes)
+        delete pnode;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -52,8 +52,7 @@ struct TestingSetup {
         RegisterValidationInterface(pwalletMain);
 #endif
         nScriptCheckThreads = 3;
-        for (int i=0; i < nScriptCheckThreads-1; i++)
-            threadGroup.create_thread(&ThreadScriptCheck);
+        StartCheckThreads(threadGroup);
         RegisterNodeSignals(GetNodeSignals());
     }
     ~TestingSetup()
@@ -305,4 +305,210 @@ BOOST_AUTO_TEST_CASE(coin_selection_tests)
     empty_wallet();
 }
 
+//! The spendable unspent outputs of the wallet, found by looking at every output of every wallet transaction
+static set<COutPoint> ScanUnspentOutputs(CWallet& wallet, AvailableCoinsType nCoinType)
+{
+    set<COutPoint> setOutputs;
+    LOCK2(cs_main, wallet.cs_wallet);
+    BOOST_FOREACH (const PAIRTYPE(const uint256, CWalletTx) & item, wallet.mapWallet) {
+        const CWalletTx& wtx = item.second;
+        if (!CheckFinalTx(wtx) || (wtx.GetDepthInMainChain(false) == 0 && !wtx.InMempool()))
+            continue;
+        for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+            if (wallet.IsMine(wtx.vout[i]) != ISMINE_SPENDABLE || wallet.IsSpent(item.first, i))
+                continue;
+            if (nCoinType == ONLY_10000 && wtx.vout[i].nValue != 50000 * COIN)
+                continue;
+            setOutputs.insert(COutPoint(item.first, i));
+        }
+    }
+    return setOutputs;
+}
+
+static set<COutPoint> AvailableOutputs(CWallet& wallet, AvailableCoinsType nCoinType)
+{
+    vector<COutput> vAvailable;
+    wallet.AvailableCoins(vAvailable, false, NULL, false, nCoinType);
+    set<COutPoint> setOutputs;
+    BOOST_FOREACH (const COutput& out, vAvailable)
+        setOutputs.insert(COutPoint(out.tx->GetHash(), out.i));
+    return setOutputs;
+}
+
+static void CheckUnspentIndex(CWallet& wallet, size_t nExpected)
+{
+    BOOST_CHECK_EQUAL(AvailableOutputs(wallet, ALL_COINS).size(), nExpected);
+    BOOST_CHECK(AvailableOutputs(wallet, ALL_COINS) == ScanUnspentOutputs(wallet, ALL_COINS));
+    BOOST_CHECK(AvailableOutputs(wallet, ONLY_10000) == ScanUnspentOutputs(wallet, ONLY_10000));
+}
+
+BOOST_AUTO_TEST_CASE(unspent_output_index_tests)
+{
+    CWallet wallet;
+    CKey key;
+    key.MakeNewKey(true);
+    CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+    CKey keyOther;
+    keyOther.MakeNewKey(true);
+    CScript scriptOther = GetScriptForDestination(keyOther.GetPubKey().GetID());
+    {
+        LOCK(wallet.cs_wallet);
+        wallet.AddKeyPubKey(key, key.GetPubKey());
+    }
+    CheckUnspentIndex(wallet, 0);
+
+    // payments to us, one of them a masternode collateral, and an output that isn't ours
+    CMutableTransaction txPay;
+    txPay.vin.resize(1);
+    txPay.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    txPay.vout.push_back(CTxOut(10 * COIN, scriptPubKey));
+    txPay.vout.push_back(CTxOut(50000 * COIN, scriptPubKey));
+    txPay.vout.push_back(CTxOut(3 * COIN, scriptOther));
+    CTransaction tx(txPay);
+    {
+        LOCK(cs_main);
+        mempool.addUnchecked(tx.GetHash(), CTxMemPoolEntry(tx, 0, GetTime(), 0.0, chainActive.Height()));
+    }
+    wallet.SyncTransaction(tx, NULL);
+    CheckUnspentIndex(wallet, 2);
+
+    // spending one of them pays change back to us
+    CMutableTransaction txSpend;
+    txSpend.vin.resize(1);
+    txSpend.vin[0].prevout = COutPoint(tx.GetHash(), 0);
+    txSpend.vout.push_back(CTxOut(4 * COIN, scriptOther));
+    txSpend.vout.push_back(CTxOut(5 * COIN, scriptPubKey));
+    CTransaction txSpent(txSpend);
+    {
+        LOCK(cs_main);
+        mempool.addUnchecked(txSpent.GetHash(), CTxMemPoolEntry(txSpent, 0, GetTime(), 0.0, chainActive.Height()));
+    }
+    wallet.SyncTransaction(txSpent, NULL);
+    CheckUnspentIndex(wallet, 2);
+
+    // spending the collateral leaves only the change
+    CMutableTransaction txSpendCollateral;
+    txSpendCollateral.vin.resize(1);
+    txSpendCollateral.vin[0].prevout = COutPoint(tx.GetHash(), 1);
+    txSpendCollateral.vout.push_back(CTxOut(49999 * COIN, scriptOther));
+    CTransaction txCollateralSpent(txSpendCollateral);
+    {
+        LOCK(cs_main);
+        mempool.addUnchecked(txCollateralSpent.GetHash(), CTxMemPoolEntry(txCollateralSpent, 0, GetTime(), 0.0, chainActive.Height()));
+    }
+    wallet.SyncTransaction(txCollateralSpent, NULL);
+    CheckUnspentIndex(wallet, 1);
+    BOOST_CHECK(AvailableOutputs(wallet, ONLY_10000).empty());
+
+    // a rebuilt index agrees with the one kept up to date along the way
+    wallet.MarkDirty();
+    CheckUnspentIndex(wallet, 1);
+
+    mempool.clear();
+}
+
+BOOST_AUTO_TEST_CASE(zerocoin_serial_index_tests)
+{
+    CWallet wallet;
+    CZerocoinMint mint(libzerocoin::ZQ_ONE, CBigNum(11), CBigNum(22), CBigNum(33), false);
+    CZerocoinMint mintRet;
+
+    BOOST_CHECK(!wallet.GetMintFromSerial(CBigNum(33), mintRet));
+
+    wallet.AddToZerocoinSerialIndex(mint);
+    BOOST_CHECK(wallet.GetMintFromSerial(CBigNum(33), mintRet));
+    BOOST_CHECK(mintRet == mint);
+    BOOST_CHECK(!mintRet.IsUsed());
+    BOOST_CHECK(!wallet.GetMintFromSerial(CBigNum(11), mintRet));
+
+    // rewriting the mint updates the indexed copy in place
+    mint.SetUsed(true);
+    wallet.AddToZerocoinSerialIndex(mint);
+    BOOST_CHECK(wallet.GetMintFromSerial(CBigNum(33), mintRet));
+    BOOST_CHECK(mintRet.IsUsed());
+
+    wallet.RemoveFromZerocoinSerialIndex(mint);
+    BOOST_CHECK(!wallet.GetMintFromSerial(CBigNum(33), mintRet));
+}
+
+BOOST_AUTO_TEST_CASE(zerocoin_serial_index_write_through)
+{
+    CWallet wallet("wallet_zerocoin_index.dat");
+    CWalletDB walletdb(wallet.strWalletFile);
+    CZerocoinMint mint(libzerocoin::ZQ_FIVE, CBigNum(44), CBigNum(55), CBigNum(66), false);
+    CZerocoinMint mintRet;
+
+    // the database layer alone leaves the wallet's index alone
+    BOOST_CHECK(walletdb.WriteZerocoinMint(mint));
+    BOOST_CHECK(!wallet.GetMintFromSerial(CBigNum(66), mintRet));
+
+    BOOST_CHECK(wallet.WriteZerocoinMint(walletdb, mint));
+    BOOST_CHECK(wallet.GetMintFromSerial(CBigNum(66), mintRet));
+
+    BOOST_CHECK(wallet.ArchiveMintOrphan(walletdb, mint));
+    BOOST_CHECK(!wallet.GetMintFromSerial(CBigNum(66), mintRet));
+
+    BOOST_CHECK(wallet.UnarchiveZerocoin(walletdb, mint));
+    BOOST_CHECK(wallet.GetMintFromSerial(CBigNum(66), mintRet));
+
+    BOOST_CHECK(wallet.EraseZerocoinMint(walletdb, mint));
+    BOOST_CHECK(!wallet.GetMintFromSerial(CBigNum(66), mintRet));
+    BOOST_CHECK(!walletdb.ReadZerocoinMint(mint.GetValue(), mintRet));
+}
+
+BOOST_AUTO_TEST_CASE(balances_follow_mempool_and_clock)
+{
+    CWallet wallet;
+    CKey key;
+    key.MakeNewKey(true);
+    CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+    {
+        LOCK(wallet.cs_wallet);
+        wallet.AddKeyPubKey(key, key.GetPubKey());
+    }
+
+    // an unconfirmed payment counts while it is in the mempool
+    CMutableTransaction txPay;
+    txPay.vin.resize(1);
+    txPay.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    txPay.vout.push_back(CTxOut(10 * COIN, scriptPubKey));
+    CTransaction tx(txPay);
+    {
+        LOCK2(cs_main, wallet.cs_wallet);
+        mempool.addUnchecked(tx.GetHash(), CTxMemPoolEntry(tx, 0, GetTime(), 0.0, chainActive.Height()));
+        wallet.AddToWallet(CWalletTx(&wallet, tx), true);
+    }
+    BOOST_CHECK_EQUAL(wallet.GetUnconfirmedBalance(), 10 * COIN);
+
+    // eviction or a conflict does not notify the wallet, the totals still have to drop it
+    list<CTransaction> removed;
+    mempool.remove(tx, removed, false);
+    BOOST_CHECK_EQUAL(wallet.GetUnconfirmedBalance(), 0);
+
+    // a confirmed payment under a time lock becomes trusted once the clock passes the lock, without a new block
+    int64_t nNow = GetTime();
+    SetMockTime(nNow);
+    CMutableTransaction txLocked;
+    txLocked.vin.resize(1);
+    txLocked.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    txLocked.vin[0].nSequence = 0;
+    txLocked.nLockTime = nNow + 100;
+    txLocked.vout.push_back(CTxOut(5 * COIN, scriptPubKey));
+    {
+        LOCK2(cs_main, wallet.cs_wallet);
+        CWalletTx wtx(&wallet, txLocked);
+        wtx.hashBlock = chainActive.Tip()->GetBlockHash();
+        wtx.nIndex = 0;
+        wtx.fMerkleVerified = true;
+        wallet.AddToWallet(wtx, true);
+    }
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 0);
+    BOOST_CHECK_EQUAL(wallet.GetUnconfirmedBalance(), 5 * COIN);
+
+    SetMockTime(nNow + 200);
+    BOOST_CHECK_EQUAL(wallet.GetBalance(), 5 * COIN);
+    BOOST_CHECK_EQUAL(wallet.GetUnconfirmedBalance(), 0);
+    SetMockTime(0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -4,16 +4,24 @@
 
 #include "libzerocoin/Denominations.h"
 #include "amount.h"
+#include "chain.h"
 #include "chainparams.h"
 #include "main.h"
 #include "txdb.h"
+#ifdef ENABLE_WALLET
+#include "wallet.h"
+#endif
 #include <boost/test/unit_test.hpp>
 #include <iostream>
 #include <accumulators.h>
+#include <accumulatormap.h>
 
 using namespace libzerocoin;
 
 extern bool DecodeHexTx(CTransaction& tx, const std::string& strHexTx);
+#ifdef ENABLE_WALLET
+extern CWallet* pwalletMain;
+#endif
 
 BOOST_AUTO_TEST_SUITE(zerocoin_implementation_tests)
 
@@ -261,9 +269,149 @@ BOOST_AUTO_TEST_CASE(checkzerocoinspend_test)
     CheckZerocoinSpendNoDB(txOverSpend, strError);
     string str = "Failed to detect overspend. Error Message: " + strError;
     BOOST_CHECK_MESSAGE(strError == "Transaction spend more than was redeemed in zerocoins", str);
+
+    /** check the deferred proof verification */
+    Accumulator accumulatorEmpty(Params().Zerocoin_Params(), CoinDenomination::ZQ_ONE);
+    CZerocoinSpendCheck checkValid(coinSpend, accumulator.getValue());
+    CZerocoinSpendCheck checkWrongAccumulator(coinSpend, accumulatorEmpty.getValue());
+    BOOST_CHECK(checkValid());
+    BOOST_CHECK(!checkWrongAccumulator());
+    BOOST_CHECK(!CZerocoinSpendCheck()());
+
+    // the queue swaps the checks out, so every batch is built fresh
+    std::vector<CZerocoinSpendCheck> vChecks(6, checkValid);
+    BOOST_CHECK(RunZerocoinSpendChecks(vChecks));
+    vChecks.assign(6, checkValid);
+    vChecks[4] = checkWrongAccumulator;
+    BOOST_CHECK(!RunZerocoinSpendChecks(vChecks));
+
+    /** a queued spend must not reach the wallet before its proof is verified */
+    CMutableTransaction txBound;
+    txBound.vout.push_back(txOut);
+    CoinSpend coinSpendBound(Params().Zerocoin_Params(), privateCoin, accumulator, nChecksum, witness, txBound.GetHash());
+    CDataStream serializedCoinSpendBound(SER_NETWORK, PROTOCOL_VERSION);
+    serializedCoinSpendBound << coinSpendBound;
+    std::vector<unsigned char> dataBound(serializedCoinSpendBound.begin(), serializedCoinSpendBound.end());
+    CTxIn txInBound;
+    txInBound.nSequence = 1;
+    txInBound.scriptSig = CScript() << OP_ZEROCOINSPEND << dataBound.size();
+    txInBound.scriptSig.insert(txInBound.scriptSig.end(), dataBound.begin(), dataBound.end());
+    txInBound.prevout.SetNull();
+    txBound.vin.push_back(txInBound);
+
+    CZerocoinDB* zerocoinDBPrev = zerocoinDB;
+    zerocoinDB = new CZerocoinDB(0, true);
+    BOOST_CHECK(zerocoinDB->WriteAccumulatorValue(nChecksum, accumulator.getValue()));
+
+    int nNotified = 0;
+#ifdef ENABLE_WALLET
+    CZerocoinMint mint(pubCoin.getDenomination(), pubCoin.getValue(), zerocoinMint.GetRandomness(), zerocoinMint.GetSerialNumber(), false);
+    pwalletMain->AddToZerocoinSerialIndex(mint);
+    boost::signals2::scoped_connection connNotify = pwalletMain->NotifyZerocoinChanged.connect(
+        [&nNotified](CWallet*, const std::string&, const std::string&, ChangeType) { nNotified++; });
+#endif
+
+    vChecks.clear();
+    BOOST_CHECK(CheckZerocoinSpend(txBound, true, state, &vChecks));
+    BOOST_CHECK_EQUAL(vChecks.size(), 1);
+    BOOST_CHECK_EQUAL(nNotified, 0);
+    BOOST_CHECK(RunZerocoinSpendChecks(vChecks));
+
+    // verified inline, the wallet hears about it right away
+    BOOST_CHECK(CheckZerocoinSpend(txBound, true, state));
+#ifdef ENABLE_WALLET
+    BOOST_CHECK_EQUAL(nNotified, 1);
+    pwalletMain->RemoveFromZerocoinSerialIndex(mint);
+#endif
+
+    delete zerocoinDB;
+    zerocoinDB = zerocoinDBPrev;
 }
 
 
+BOOST_AUTO_TEST_CASE(block_pubcoin_index_tests)
+{
+    CZerocoinDB* zerocoinDBPrev = zerocoinDB;
+    zerocoinDB = new CZerocoinDB(0, true);
+
+    CTransaction txMint;
+    BOOST_CHECK(DecodeHexTx(txMint, rawTx1));
+    CValidationState state;
+    PublicCoin pubCoin(Params().Zerocoin_Params());
+    BOOST_CHECK(TxOutToPublicCoin(txMint.vout[0], pubCoin, state));
+
+    // a coinstake in the second slot keeps ReadBlockFromDisk from checking proof of work
+    CMutableTransaction txCoinBase;
+    txCoinBase.vin.resize(1);
+    txCoinBase.vin[0].prevout.SetNull();
+    txCoinBase.vout.resize(1);
+    txCoinBase.vout[0].SetEmpty();
+    CMutableTransaction txCoinStake;
+    txCoinStake.vin.resize(1);
+    txCoinStake.vin[0].prevout = COutPoint(uint256(1), 0);
+    txCoinStake.vout.resize(2);
+    txCoinStake.vout[0].SetEmpty();
+    txCoinStake.vout[1].nValue = COIN;
+
+    CBlock block;
+    block.vtx.push_back(txCoinBase);
+    block.vtx.push_back(txCoinStake);
+    block.vtx.push_back(txMint);
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    CDiskBlockPos pos(1001, 0);
+    BOOST_CHECK(WriteBlockToDisk(block, pos));
+
+    uint256 hashBlock = block.GetHash();
+    CBlockIndex index(block);
+    index.phashBlock = &hashBlock;
+    index.nHeight = 500;
+    index.nFile = pos.nFile;
+    index.nDataPos = pos.nPos;
+    index.nStatus |= BLOCK_HAVE_DATA;
+
+    int nMints = 0;
+    std::map<CoinDenomination, std::vector<CBigNum> > mapPubcoins;
+    BOOST_CHECK(!zerocoinDB->ReadBlockPubcoins(index.nHeight, hashBlock, nMints, mapPubcoins));
+
+    // the first lookup reads the block and fills the index
+    BOOST_CHECK(GetBlockPubcoins(&index, nMints, mapPubcoins));
+    BOOST_CHECK_EQUAL(nMints, 1);
+    BOOST_CHECK_EQUAL(mapPubcoins.size(), 1);
+    BOOST_CHECK(mapPubcoins[pubCoin.getDenomination()] == std::vector<CBigNum>(1, pubCoin.getValue()));
+
+    mapPubcoins.clear();
+    BOOST_CHECK(zerocoinDB->ReadBlockPubcoins(index.nHeight, hashBlock, nMints, mapPubcoins));
+    BOOST_CHECK_EQUAL(nMints, 1);
+    BOOST_CHECK(mapPubcoins[pubCoin.getDenomination()] == std::vector<CBigNum>(1, pubCoin.getValue()));
+
+    // rewriting a height drops the denominations the new block does not mint
+    std::map<CoinDenomination, std::vector<CBigNum> > mapOther;
+    mapOther[CoinDenomination::ZQ_ONE_HUNDRED].push_back(CBigNum(12345));
+    BOOST_CHECK(zerocoinDB->WriteBlockPubcoins(index.nHeight, uint256(7), 3, mapOther));
+    BOOST_CHECK(!zerocoinDB->ReadBlockPubcoins(index.nHeight, hashBlock, nMints, mapPubcoins));
+    BOOST_CHECK(zerocoinDB->ReadBlockPubcoins(index.nHeight, uint256(7), nMints, mapPubcoins));
+    BOOST_CHECK_EQUAL(nMints, 3);
+    BOOST_CHECK(mapPubcoins == mapOther);
+
+    // a height indexed for another block falls back to the block on disk and reindexes it
+    BOOST_CHECK(GetBlockPubcoins(&index, nMints, mapPubcoins));
+    BOOST_CHECK_EQUAL(nMints, 1);
+    BOOST_CHECK(mapPubcoins[pubCoin.getDenomination()] == std::vector<CBigNum>(1, pubCoin.getValue()));
+    BOOST_CHECK_EQUAL(mapPubcoins.size(), 1);
+    BOOST_CHECK(zerocoinDB->ReadBlockPubcoins(index.nHeight, hashBlock, nMints, mapPubcoins));
+
+    // without an index entry and without the block data there is nothing to fall back to
+    CBlockIndex indexMissing(block);
+    indexMissing.phashBlock = &hashBlock;
+    indexMissing.nHeight = index.nHeight + 1;
+    indexMissing.nFile = 1002;
+    indexMissing.nDataPos = 8;
+    BOOST_CHECK(!GetBlockPubcoins(&indexMissing, nMints, mapPubcoins));
+
+    delete zerocoinDB;
+    zerocoinDB = zerocoinDBPrev;
+}
+
 BOOST_AUTO_TEST_CASE(setup_exceptions_test)
 {
     cout << "Running check_unitialized parameters,etc for setup exceptions...\n";
@@ -349,4 +497,145 @@ BOOST_AUTO_TEST_CASE(checksum_tests)
 }
 
 
+BOOST_AUTO_TEST_CASE(witness_cache_serialization_tests)
+{
+    CZerocoinWitness witnessCache;
+    BOOST_CHECK(witnessCache.IsNull());
+
+    witnessCache.bnPubcoin = CBigNum(12345);
+    witnessCache.nHeightAccStart = 100;
+    witnessCache.nHeightAccEnd = 180;
+    witnessCache.hashBlockEnd = uint256("0x1234");
+    witnessCache.bnWitness = CBigNum(67890);
+    witnessCache.nMintsAdded = 7;
+    BOOST_CHECK(!witnessCache.IsNull());
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << witnessCache;
+    CZerocoinWitness witnessRead;
+    ss >> witnessRead;
+    BOOST_CHECK(witnessRead.bnPubcoin == witnessCache.bnPubcoin);
+    BOOST_CHECK_EQUAL(witnessRead.nHeightAccStart, 100);
+    BOOST_CHECK_EQUAL(witnessRead.nHeightAccEnd, 180);
+    BOOST_CHECK(witnessRead.hashBlockEnd == witnessCache.hashBlockEnd);
+    BOOST_CHECK(witnessRead.bnWitness == witnessCache.bnWitness);
+    BOOST_CHECK_EQUAL(witnessRead.nMintsAdded, 7);
+
+    witnessRead.SetNull();
+    BOOST_CHECK(witnessRead.IsNull());
+}
+
+BOOST_AUTO_TEST_CASE(witness_cache_resume_tests)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    libzerocoin::ZerocoinParams* params = Params().Zerocoin_Params();
+    PublicCoin coin(params, CBigNum::randBignum(params->accumulatorParams.accumulatorModulus), libzerocoin::ZQ_ONE);
+
+    std::vector<CBigNum> vValues;
+    for (int i = 0; i < 30; i++)
+        vValues.push_back(CBigNum::randBignum(params->accumulatorParams.accumulatorModulus));
+
+    libzerocoin::Accumulator accumulator(params, libzerocoin::ZQ_ONE);
+    libzerocoin::AccumulatorWitness witnessFull(params, accumulator, coin);
+    for (const CBigNum& bnValue : vValues)
+        witnessFull.addRawValue(bnValue);
+
+    // cache the witness part way, the way GenerateAccumulatorWitness stores it
+    std::vector<CBigNum> vFirst(vValues.begin(), vValues.begin() + 12);
+    std::vector<CBigNum> vRest(vValues.begin() + 12, vValues.end());
+    libzerocoin::AccumulatorWitness witnessPartial(params, accumulator, coin);
+    for (const CBigNum& bnValue : vFirst)
+        witnessPartial.addRawValue(bnValue);
+    CZerocoinWitness witnessCache;
+    witnessCache.bnPubcoin = coin.getValue();
+    witnessCache.bnWitness = witnessPartial.getValue();
+    witnessCache.nMintsAdded = vFirst.size();
+
+    // resuming from the cache and adding only the remaining blocks gives the same witness
+    libzerocoin::Accumulator accumulatorCached(params, libzerocoin::ZQ_ONE, witnessCache.bnWitness);
+    libzerocoin::AccumulatorWitness witnessResumed(params, accumulator, coin);
+    witnessResumed.resetValue(accumulatorCached, coin);
+    for (const CBigNum& bnValue : vRest)
+        witnessResumed.addRawValue(bnValue);
+    BOOST_CHECK(witnessResumed.getValue() == witnessFull.getValue());
+}
+
+BOOST_AUTO_TEST_CASE(witness_cache_reorg_tests)
+{
+    // a main chain of 200 blocks and a branch off it at height 150
+    std::vector<uint256> vHashMain(200);
+    std::vector<CBlockIndex> vBlocksMain(200);
+    for (unsigned int i = 0; i < vBlocksMain.size(); i++) {
+        vHashMain[i] = i;
+        vBlocksMain[i].nHeight = i;
+        vBlocksMain[i].pprev = i ? &vBlocksMain[i - 1] : NULL;
+        vBlocksMain[i].phashBlock = &vHashMain[i];
+        vBlocksMain[i].BuildSkip();
+    }
+    std::vector<uint256> vHashSide(60);
+    std::vector<CBlockIndex> vBlocksSide(60);
+    for (unsigned int i = 0; i < vBlocksSide.size(); i++) {
+        vHashSide[i] = i + 151 + (uint256(1) << 128);
+        vBlocksSide[i].nHeight = i + 151;
+        vBlocksSide[i].pprev = i ? &vBlocksSide[i - 1] : &vBlocksMain[150];
+        vBlocksSide[i].phashBlock = &vHashSide[i];
+        vBlocksSide[i].BuildSkip();
+    }
+
+    CBigNum bnPubcoin(12345);
+    CZerocoinWitness witnessCache;
+    BOOST_CHECK(!IsWitnessCacheValid(witnessCache, bnPubcoin, 100, &vBlocksMain.back()));
+
+    witnessCache.bnPubcoin = bnPubcoin;
+    witnessCache.nHeightAccStart = 100;
+    witnessCache.nHeightAccEnd = 180;
+    witnessCache.hashBlockEnd = vHashMain[179];
+    witnessCache.bnWitness = CBigNum(67890);
+    BOOST_CHECK(IsWitnessCacheValid(witnessCache, bnPubcoin, 100, &vBlocksMain.back()));
+    BOOST_CHECK(IsWitnessCacheValid(witnessCache, bnPubcoin, 100, &vBlocksMain[179]));
+
+    // another mint, another start height or a tip the cache already goes past cannot resume it
+    BOOST_CHECK(!IsWitnessCacheValid(witnessCache, CBigNum(54321), 100, &vBlocksMain.back()));
+    BOOST_CHECK(!IsWitnessCacheValid(witnessCache, bnPubcoin, 90, &vBlocksMain.back()));
+    BOOST_CHECK(!IsWitnessCacheValid(witnessCache, bnPubcoin, 100, &vBlocksMain[170]));
+
+    // after a reorg to the branch the last cached block is gone and the witness has to be rebuilt
+    BOOST_CHECK(!IsWitnessCacheValid(witnessCache, bnPubcoin, 100, &vBlocksSide.back()));
+
+    // a cache that ends below the fork point is still good on the branch
+    witnessCache.nHeightAccEnd = 140;
+    witnessCache.hashBlockEnd = vHashMain[139];
+    BOOST_CHECK(IsWitnessCacheValid(witnessCache, bnPubcoin, 100, &vBlocksSide.back()));
+}
+
+BOOST_AUTO_TEST_CASE(accumulator_denominations_tests)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    libzerocoin::ZerocoinParams* params = Params().Zerocoin_Params();
+
+    // a few values for every denomination but one, which is left untouched
+    std::map<libzerocoin::CoinDenomination, std::vector<CBigNum> > mapValues;
+    for (auto& denom : libzerocoin::zerocoinDenomList) {
+        if (denom == libzerocoin::ZQ_ONE)
+            continue;
+        for (int i = 0; i < 5; i++)
+            mapValues[denom].push_back(CBigNum::randBignum(params->accumulatorParams.accumulatorModulus));
+    }
+
+    AccumulatorMap mapAccumulators;
+    BOOST_CHECK(mapAccumulators.AccumulateDenominations(mapValues));
+
+    // every accumulator ends up where adding its values one by one on this thread gets it
+    for (auto& denom : libzerocoin::zerocoinDenomList) {
+        libzerocoin::Accumulator accSequential(params, denom);
+        for (const CBigNum& bnValue : mapValues[denom])
+            accSequential.increment(bnValue);
+        BOOST_CHECK(mapAccumulators.GetValue(denom) == accSequential.getValue());
+    }
+
+    std::map<libzerocoin::CoinDenomination, std::vector<CBigNum> > mapError;
+    mapError[libzerocoin::ZQ_ERROR].push_back(CBigNum(3));
+    BOOST_CHECK(!mapAccumulators.AccumulateDenominations(mapError));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -89,6 +89,8 @@ public:
     bool WriteAccumulatorValue(const uint32_t& nChecksum, const CBigNum& bnValue);
     bool ReadAccumulatorValue(const uint32_t& nChecksum, CBigNum& bnValue);
     bool EraseAccumulatorValue(const uint32_t& nChecksum);
+    bool WriteBlockPubcoins(int nHeight, const uint256& hashBlock, int nMints, const std::map<libzerocoin::CoinDenomination, std::vector<CBigNum> >& mapPubcoins);
+    bool ReadBlockPubcoins(int nHeight, const uint256& hashBlock, int& nMints, std::map<libzerocoin::CoinDenomination, std::vector<CBigNum> >& mapPubcoins);
 };
 
 #endif // BITCOIN_TXDB_H
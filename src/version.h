@@ -12,7 +12,7 @@
  * network protocol versioning
  */
 
-static const int PROTOCOL_VERSION = 70022;
+static const int PROTOCOL_VERSION = 70023;
 
 //! initial proto version, to be increased after version/verack negotiation
 static const int INIT_PROTO_VERSION = 209;
@@ -20,6 +20,9 @@ static const int INIT_PROTO_VERSION = 209;
 //! In this version, 'getheaders' was introduced.
 static const int GETHEADERS_VERSION = 70000;
 
+//! In this version, 'getheaders' is answered with 'headers' and blocks are downloaded headers-first.
+static const int HEADERS_FIRST_VERSION = 70023;
+
 //! disconnect from peers older than this proto version
 static const int MIN_PEER_PROTO_VERSION_BEFORE_ENFORCEMENT = 70002;
 static const int MIN_PEER_PROTO_VERSION_AFTER_ENFORCEMENT = 70022;
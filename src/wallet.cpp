@@ -26,6 +26,7 @@
 #include "denomination_functions.h"
 #include "libzerocoin/Denominations.h"
 #include <assert.h>
+#include <atomic>
 
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/thread.hpp>
@@ -165,6 +166,11 @@ bool CWallet::AddCScript(const CScript& redeemScript)
 {
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
+    {
+        LOCK(cs_wallet);
+        fUnspentOutputsDirty = true; // outputs already in the wallet may have become ours
+        fBalancesDirty = true;
+    }
     if (!fFileBacked)
         return true;
     return CWalletDB(strWalletFile).WriteCScript(Hash160(redeemScript), redeemScript);
@@ -190,6 +196,10 @@ bool CWallet::AddWatchOnly(const CScript& dest)
     if (!CCryptoKeyStore::AddWatchOnly(dest))
         return false;
     nTimeFirstKey = 1; // No birthday information for watch-only keys.
+    {
+        LOCK(cs_wallet);
+        fBalancesDirty = true; // outputs already in the wallet may have become watch-only
+    }
     NotifyWatchonlyChanged(true);
     if (!fFileBacked)
         return true;
@@ -201,6 +211,7 @@ bool CWallet::RemoveWatchOnly(const CScript& dest)
     AssertLockHeld(cs_wallet);
     if (!CCryptoKeyStore::RemoveWatchOnly(dest))
         return false;
+    fBalancesDirty = true;
     if (!HaveWatchOnly())
         NotifyWatchonlyChanged(false);
     if (fFileBacked)
@@ -452,6 +463,7 @@ void CWallet::AddToSpends(const uint256& wtxid)
 {
     assert(mapWallet.count(wtxid));
     CWalletTx& thisTx = mapWallet[wtxid];
+    QueueUnspentUpdate(thisTx);
     if (thisTx.IsCoinBase()) // Coinbases don't spend anything!
         return;
 
@@ -651,6 +663,8 @@ void CWallet::MarkDirty()
 {
     {
         LOCK(cs_wallet);
+        fUnspentOutputsDirty = true;
+        fBalancesDirty = true;
         BOOST_FOREACH (PAIRTYPE(const uint256, CWalletTx) & item, mapWallet)
             item.second.MarkDirty();
     }
@@ -784,6 +798,16 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pbl
 void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
 {
     LOCK2(cs_main, cs_wallet);
+    // connecting or disconnecting tx changes whether the wallet outputs it spends are spent
+    if (mapWallet.count(tx.GetHash()))
+        QueueUnspentUpdate(tx);
+
+    // every connected or disconnected block syncs its coinbase, depth and maturity of wallet transactions moved
+    if (tx.IsCoinBase()) {
+        fBalanceTipChanged = true;
+        fZerocoinBalancesDirty = true;
+    }
+
     if (!AddToWalletIfInvolvingMe(tx, pblock, true))
         return; // Not one of ours
 
@@ -804,6 +828,8 @@ void CWallet::EraseFromWallet(const uint256& hash)
         LOCK(cs_wallet);
         if (mapWallet.erase(hash))
             CWalletDB(strWalletFile).EraseTx(hash);
+        fUnspentOutputsDirty = true;
+        fBalancesDirty = true;
     }
     return;
 }
@@ -823,9 +849,300 @@ isminetype CWallet::IsMine(const CTxIn& txin) const
     return ISMINE_NO;
 }
 
+void CWallet::AddToZerocoinSerialIndex(const CZerocoinMint& mint)
+{
+    LOCK(cs_wallet);
+    uint256 hashSerial = GetBigNumHash(mint.GetSerialNumber());
+    mapZerocoinSerials[hashSerial] = mint;
+    mapZerocoinDenominations[mint.GetDenomination()].insert(hashSerial);
+    fZerocoinBalancesDirty = true;
+}
+
+void CWallet::RemoveFromZerocoinSerialIndex(const CZerocoinMint& mint)
+{
+    LOCK(cs_wallet);
+    uint256 hashSerial = GetBigNumHash(mint.GetSerialNumber());
+    ZerocoinSerialMap::iterator it = mapZerocoinSerials.find(hashSerial);
+    if (it != mapZerocoinSerials.end()) {
+        mapZerocoinDenominations[it->second.GetDenomination()].erase(hashSerial);
+        mapZerocoinSerials.erase(it);
+    }
+    fZerocoinBalancesDirty = true;
+}
+
+void CWallet::AddToZerocoinSpendIndex(const CBigNum& bnSerial)
+{
+    LOCK(cs_wallet);
+    setZerocoinSpendSerials.insert(GetBigNumHash(bnSerial));
+    fZerocoinBalancesDirty = true;
+}
+
+void CWallet::RemoveFromZerocoinSpendIndex(const CBigNum& bnSerial)
+{
+    LOCK(cs_wallet);
+    setZerocoinSpendSerials.erase(GetBigNumHash(bnSerial));
+    fZerocoinBalancesDirty = true;
+}
+
+bool CWallet::WriteZerocoinMint(CWalletDB& walletdb, const CZerocoinMint& mint)
+{
+    if (!walletdb.WriteZerocoinMint(mint))
+        return false;
+    AddToZerocoinSerialIndex(mint);
+    return true;
+}
+
+bool CWallet::EraseZerocoinMint(CWalletDB& walletdb, const CZerocoinMint& mint)
+{
+    RemoveFromZerocoinSerialIndex(mint);
+    return walletdb.EraseZerocoinMint(mint);
+}
+
+bool CWallet::ArchiveMintOrphan(CWalletDB& walletdb, const CZerocoinMint& mint)
+{
+    if (!walletdb.ArchiveMintOrphan(mint))
+        return false;
+    RemoveFromZerocoinSerialIndex(mint);
+    return true;
+}
+
+bool CWallet::UnarchiveZerocoin(CWalletDB& walletdb, const CZerocoinMint& mint)
+{
+    if (!walletdb.UnarchiveZerocoin(mint))
+        return false;
+    AddToZerocoinSerialIndex(mint);
+    return true;
+}
+
+bool CWallet::WriteZerocoinSpendSerialEntry(CWalletDB& walletdb, const CZerocoinSpend& spend)
+{
+    if (!walletdb.WriteZerocoinSpendSerialEntry(spend))
+        return false;
+    AddToZerocoinSpendIndex(spend.GetSerial());
+    return true;
+}
+
+bool CWallet::EraseZerocoinSpendSerialEntry(CWalletDB& walletdb, const CBigNum& bnSerial)
+{
+    RemoveFromZerocoinSpendIndex(bnSerial);
+    return walletdb.EraseZerocoinSpendSerialEntry(bnSerial);
+}
+
+std::list<CZerocoinMint> CWallet::ListMintedCoins(bool fUnusedOnly, bool fMaturedOnly, bool fUpdateStatus, libzerocoin::CoinDenomination denom)
+{
+    std::list<CZerocoinMint> listPubCoin;
+    vector<CZerocoinMint> vOverWrite;
+    vector<CZerocoinMint> vArchive;
+
+    LOCK2(cs_main, cs_wallet);
+    for (std::map<libzerocoin::CoinDenomination, std::set<uint256> >::const_iterator itDenom = mapZerocoinDenominations.begin(); itDenom != mapZerocoinDenominations.end(); ++itDenom) {
+        if (denom != libzerocoin::ZQ_ERROR && itDenom->first != denom)
+            continue;
+
+        BOOST_FOREACH (const uint256& hashSerial, itDenom->second) {
+            CZerocoinMint mint = mapZerocoinSerials.at(hashSerial);
+
+            if (fUnusedOnly) {
+                if (mint.IsUsed())
+                    continue;
+
+                //double check that we have no record of this serial being used
+                if (setZerocoinSpendSerials.count(hashSerial)) {
+                    mint.SetUsed(true);
+                    vOverWrite.emplace_back(mint);
+                    continue;
+                }
+            }
+
+            if (fMaturedOnly || fUpdateStatus) {
+                //if there is not a record of the block height, then look it up and assign it
+                if (!mint.GetHeight()) {
+                    CTransaction tx;
+                    uint256 hashBlock;
+                    if (!GetTransaction(mint.GetTxHash(), tx, hashBlock, true)) {
+                        LogPrintf("%s failed to find tx for mint txid=%s\n", __func__, mint.GetTxHash().GetHex());
+                        vArchive.emplace_back(mint);
+                        continue;
+                    }
+
+                    //if not in the block index, most likely is unconfirmed tx
+                    if (mapBlockIndex.count(hashBlock)) {
+                        mint.SetHeight(mapBlockIndex[hashBlock]->nHeight);
+                        vOverWrite.emplace_back(mint);
+                    } else if (fMaturedOnly) {
+                        continue;
+                    }
+                }
+
+                //not mature
+                if (mint.GetHeight() > chainActive.Height() - Params().Zerocoin_MintRequiredConfirmations()) {
+                    if (!fMaturedOnly)
+                        listPubCoin.emplace_back(mint);
+                    continue;
+                }
+
+                if (fMaturedOnly) {
+                    // check to make sure there are at least 3 other mints added to the accumulators after this
+                    if (chainActive.Height() < mint.GetHeight() + 1)
+                        continue;
+
+                    CBlockIndex* pindex = chainActive[mint.GetHeight() + 1];
+                    int nMintsAdded = 0;
+                    while (pindex->nHeight < chainActive.Height() - 30) { // 30 just to make sure that its at least 2 checkpoints from the top block
+                        nMintsAdded += count(pindex->vMintDenominationsInBlock.begin(), pindex->vMintDenominationsInBlock.end(), mint.GetDenomination());
+                        if (nMintsAdded >= Params().Zerocoin_RequiredAccumulation())
+                            break;
+                        pindex = chainActive[pindex->nHeight + 1];
+                    }
+
+                    if (nMintsAdded < Params().Zerocoin_RequiredAccumulation())
+                        continue;
+                }
+            }
+            listPubCoin.emplace_back(mint);
+        }
+    }
+
+    if (!fFileBacked)
+        return listPubCoin;
+
+    CWalletDB walletdb(strWalletFile);
+    for (const CZerocoinMint& mint : vOverWrite) {
+        if (!WriteZerocoinMint(walletdb, mint))
+            LogPrintf("%s failed to update mint from tx %s\n", __func__, mint.GetTxHash().GetHex());
+    }
+
+    for (const CZerocoinMint& mint : vArchive) {
+        if (!ArchiveMintOrphan(walletdb, mint))
+            LogPrintf("%s failed to archive mint from %s\n", __func__, mint.GetTxHash().GetHex());
+    }
+
+    return listPubCoin;
+}
+
+bool CWallet::GetMintFromSerial(const CBigNum& bnSerial, CZerocoinMint& mint) const
+{
+    LOCK(cs_wallet);
+    ZerocoinSerialMap::const_iterator it = mapZerocoinSerials.find(GetBigNumHash(bnSerial));
+    if (it == mapZerocoinSerials.end())
+        return false;
+
+    mint = it->second;
+    return true;
+}
+
+void CWallet::LoadZerocoinWitness(const CZerocoinWitness& witnessCache)
+{
+    LOCK(cs_wallet);
+    mapZerocoinWitnesses[GetBigNumHash(witnessCache.bnPubcoin)] = witnessCache;
+}
+
+bool CWallet::GetZerocoinWitness(const CBigNum& bnPubcoin, CZerocoinWitness& witnessCache) const
+{
+    LOCK(cs_wallet);
+    std::map<uint256, CZerocoinWitness>::const_iterator it = mapZerocoinWitnesses.find(GetBigNumHash(bnPubcoin));
+    if (it == mapZerocoinWitnesses.end())
+        return false;
+
+    witnessCache = it->second;
+    return true;
+}
+
+void CWallet::SetZerocoinWitness(const CZerocoinWitness& witnessCache)
+{
+    LOCK(cs_wallet);
+    uint256 hashPubcoin = GetBigNumHash(witnessCache.bnPubcoin);
+    std::map<uint256, CZerocoinWitness>::iterator it = mapZerocoinWitnesses.find(hashPubcoin);
+    if (it != mapZerocoinWitnesses.end() && it->second.nHeightAccEnd == witnessCache.nHeightAccEnd && it->second.hashBlockEnd == witnessCache.hashBlockEnd)
+        return;
+
+    mapZerocoinWitnesses[hashPubcoin] = witnessCache;
+    if (fFileBacked)
+        CWalletDB(strWalletFile).WriteZerocoinWitness(witnessCache);
+}
+
+void CWallet::UpdateZerocoinWitnesses()
+{
+    int nHeight;
+    {
+        LOCK(cs_main);
+        nHeight = chainActive.Height();
+    }
+    if (nHeight < Params().Zerocoin_StartHeight())
+        return;
+
+    std::vector<uint256> vErase;
+    std::map<uint256, CZerocoinMint> mapUnspent;
+    {
+        LOCK(cs_wallet);
+        BOOST_FOREACH (const PAIRTYPE(const uint256, CZerocoinMint) & item, mapZerocoinSerials) {
+            const CZerocoinMint& mint = item.second;
+            if (!mint.IsUsed())
+                mapUnspent[GetBigNumHash(mint.GetValue())] = mint;
+        }
+
+        BOOST_FOREACH (const PAIRTYPE(const uint256, CZerocoinWitness) & item, mapZerocoinWitnesses) {
+            if (!mapUnspent.count(item.first))
+                vErase.push_back(item.first);
+        }
+
+        BOOST_FOREACH (const uint256& hashPubcoin, vErase) {
+            if (fFileBacked)
+                CWalletDB(strWalletFile).EraseZerocoinWitness(mapZerocoinWitnesses[hashPubcoin]);
+            mapZerocoinWitnesses.erase(hashPubcoin);
+        }
+    }
+
+    // no lock is held while a witness is built, GenerateAccumulatorWitness only takes cs_main to copy the blocks it needs
+    BOOST_FOREACH (const PAIRTYPE(const uint256, CZerocoinMint) & item, mapUnspent) {
+        boost::this_thread::interruption_point();
+
+        const CZerocoinMint& mint = item.second;
+        if (mint.GetHeight() <= 0 || mint.GetHeight() + 20 > nHeight)
+            continue;
+
+        CZerocoinWitness witnessCache;
+        GetZerocoinWitness(mint.GetValue(), witnessCache);
+
+        libzerocoin::PublicCoin pubcoin(Params().Zerocoin_Params(), mint.GetValue(), mint.GetDenomination());
+        libzerocoin::Accumulator accumulator(Params().Zerocoin_Params(), mint.GetDenomination());
+        libzerocoin::AccumulatorWitness witness(Params().Zerocoin_Params(), accumulator, pubcoin);
+        int nMintsAdded = 0;
+        string strError;
+        GenerateAccumulatorWitness(mint, accumulator, witness, 100, nMintsAdded, strError, &witnessCache);
+        if (!witnessCache.IsNull())
+            SetZerocoinWitness(witnessCache);
+    }
+}
+
+void ThreadUpdateZerocoinWitnesses()
+{
+    // a new accumulator checkpoint is generated every 10 blocks, advance the cached witnesses once per checkpoint
+    int nCheckpointLast = -1;
+    while (true) {
+        MilliSleep(5000);
+
+        CWallet* pwallet = pwalletMain;
+        if (!pwallet || IsInitialBlockDownload())
+            continue;
+
+        int nCheckpoint;
+        {
+            LOCK(cs_main);
+            nCheckpoint = chainActive.Height() / 10;
+        }
+        if (nCheckpoint == nCheckpointLast)
+            continue;
+
+        nCheckpointLast = nCheckpoint;
+        pwallet->UpdateZerocoinWitnesses();
+    }
+}
+
 bool CWallet::IsMyZerocoinSpend(const CBigNum& bnSerial) const
 {
-    return CWalletDB(strWalletFile).ReadZerocoinSpendSerialEntry(bnSerial);
+    LOCK(cs_wallet);
+    return setZerocoinSpendSerials.count(GetBigNumHash(bnSerial)) > 0;
 }
 
 CAmount CWallet::GetDebit(const CTxIn& txin, const isminefilter& filter) const
@@ -1269,86 +1586,222 @@ void CWallet::ResendWalletTransactions()
  * @{
  */
 
-CAmount CWallet::GetBalance() const
+//! Recompute the credit one wallet transaction contributes to each balance category
+void CWallet::UpdateBalances(const uint256& hash)
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
+    map<uint256, CWalletBalances>::iterator itContribution = mapBalanceContributions.find(hash);
+    if (itContribution != mapBalanceContributions.end()) {
+        balances -= itContribution->second;
+        mapBalanceContributions.erase(itContribution);
+    }
+    setBalanceVolatile.erase(hash);
+    setBalanceMempool.erase(hash);
+
+    map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hash);
+    if (mi == mapWallet.end())
+        return;
+
+    const CWalletTx* pcoin = &mi->second;
+    CWalletBalances contribution;
+    bool fTrusted = pcoin->IsTrusted();
+    int nDepth = pcoin->GetDepthInMainChain();
+    bool fFinal = IsFinalTx(*pcoin);
+    if (fTrusted) {
+        contribution.nTrusted = pcoin->GetAvailableCredit();
+        contribution.nWatchOnly = pcoin->GetAvailableWatchOnlyCredit();
+    }
+    if (!fFinal || (!fTrusted && nDepth == 0)) {
+        contribution.nUnconfirmed = pcoin->GetAvailableCredit();
+        contribution.nUnconfirmedWatchOnly = pcoin->GetAvailableWatchOnlyCredit();
+    }
+    contribution.nImmature = pcoin->GetImmatureCredit();
+    contribution.nImmatureWatchOnly = pcoin->GetImmatureWatchOnlyCredit();
+    if (!fLiteMode) {
+        if (fTrusted) {
+            contribution.nAnonymizable = pcoin->GetAnonymizableCredit();
+            contribution.nAnonymized = pcoin->GetAnonymizedCredit();
         }
+        contribution.nDenominated = pcoin->GetDenominatedCredit(false);
+        contribution.nDenominatedUnconfirmed = pcoin->GetDenominatedCredit(true);
     }
 
-    return nTotal;
+    balances += contribution;
+    mapBalanceContributions.insert(make_pair(hash, contribution));
+
+    // trust, finality and maturity of these still change as blocks come in
+    if (!fFinal || nDepth < 1 || pcoin->GetBlocksToMaturity() > 0)
+        setBalanceVolatile.insert(hash);
+
+    // an unconfirmed transaction is only counted while it is in the mempool, eviction or a conflict drops it
+    // (the swifttx depth of a locked one hides that, so look at the plain chain depth)
+    if (pcoin->GetDepthInMainChain(false) == 0)
+        setBalanceMempool.insert(hash);
+
+    // a time lock expires with the clock, not with a new block
+    if (!fFinal && pcoin->nLockTime >= LOCKTIME_THRESHOLD)
+        nBalanceFinalityTime = std::min(nBalanceFinalityTime, (int64_t)pcoin->nLockTime + 1);
 }
 
-CAmount CWallet::GetZerocoinBalance(bool fMatureOnly) const
+//! Queue a wallet transaction and the wallet transactions it spends, whose spent state follows it
+void CWallet::QueueBalanceUpdate(const uint256& hash)
 {
-    CAmount nTotal = 0;
-    //! zerocoin specific fields
-    std::map<libzerocoin::CoinDenomination, unsigned int> myZerocoinSupply;
-    for (auto& denom : libzerocoin::zerocoinDenomList) {
-        myZerocoinSupply.insert(make_pair(denom, 0));
+    setBalancePending.insert(hash);
+    map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hash);
+    if (mi == mapWallet.end() || mi->second.IsCoinBase())
+        return;
+    BOOST_FOREACH (const CTxIn& txin, mi->second.vin) {
+        if (mapWallet.count(txin.prevout.hash))
+            setBalancePending.insert(txin.prevout.hash);
     }
+}
 
-    {
-        LOCK2(cs_main, cs_wallet);
-        // Get Unused coins
-        list<CZerocoinMint> listPubCoin = CWalletDB(strWalletFile).ListMintedCoins(true, fMatureOnly, true);
-        for (auto& mint : listPubCoin) {
-            libzerocoin::CoinDenomination denom = mint.GetDenomination();
-            nTotal += libzerocoin::ZerocoinDenominationToAmount(denom);
-            myZerocoinSupply.at(denom)++;
+//! Whether the running totals still hold without looking at the chain
+bool CWallet::BalancesCurrent() const
+{
+    AssertLockHeld(cs_wallet);
+    if (fBalancesDirty || fBalanceTipChanged || !setBalancePending.empty())
+        return false;
+    if (GetAdjustedTime() >= nBalanceFinalityTime)
+        return false;
+    return setBalanceMempool.empty() || mempool.GetTransactionsUpdated() == nBalanceMempoolUpdated;
+}
+
+//! Bring the running balance totals up to date
+void CWallet::UpdateBalances()
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+    unsigned int nMempoolUpdated = mempool.GetTransactionsUpdated();
+    if (fBalancesDirty || (pindexBalances && !chainActive.Contains(pindexBalances))) {
+        balances.SetNull();
+        mapBalanceContributions.clear();
+        setBalanceVolatile.clear();
+        setBalanceMempool.clear();
+        nBalanceFinalityTime = std::numeric_limits<int64_t>::max();
+        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+            UpdateBalances(it->first);
+        fBalancesDirty = false;
+    } else {
+        if (fBalanceTipChanged || GetAdjustedTime() >= nBalanceFinalityTime) {
+            // a transaction leaving the volatile set can change the spent state of the wallet outputs it spends;
+            // every time locked transaction is in the set, so the deadline is rebuilt from scratch
+            nBalanceFinalityTime = std::numeric_limits<int64_t>::max();
+            BOOST_FOREACH (const uint256& hash, setBalanceVolatile)
+                QueueBalanceUpdate(hash);
         }
+        if (nMempoolUpdated != nBalanceMempoolUpdated) {
+            BOOST_FOREACH (const uint256& hash, setBalanceMempool)
+                QueueBalanceUpdate(hash);
+        }
+        BOOST_FOREACH (const uint256& hash, setBalancePending)
+            UpdateBalances(hash);
     }
-    for (auto& denom : libzerocoin::zerocoinDenomList) {
-        LogPrint("zero","%s My coins for denomination %d pubcoin %s\n", __func__,denom, myZerocoinSupply.at(denom));
-    }
-    LogPrint("zero","Total value of coins %d\n",nTotal);
+    setBalancePending.clear();
+    fBalanceTipChanged = false;
+    nBalanceMempoolUpdated = nMempoolUpdated;
+    pindexBalances = chainActive.Tip();
+}
 
-    if (nTotal < 0 ) nTotal = 0; // Sanity never hurts
+CWalletBalances CWallet::GetBalances()
+{
+    {
+        // nothing moved since the last update, the totals can be read without cs_main
+        LOCK(cs_wallet);
+        if (BalancesCurrent())
+            return balances;
+    }
 
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    UpdateBalances();
+    return balances;
 }
 
-CAmount CWallet::GetImmatureZerocoinBalance() const
+CAmount CWallet::GetBalance()
 {
-    return GetZerocoinBalance(false) - GetZerocoinBalance(true);
+    return GetBalances().nTrusted;
 }
 
-CAmount CWallet::GetUnconfirmedZerocoinBalance() const
+//! Refresh the zerocoin balances from the unspent mint records
+void CWallet::UpdateZerocoinBalances()
 {
-    CAmount nUnconfirmed = 0;
-    CWalletDB walletdb(pwalletMain->strWalletFile);
-    list<CZerocoinMint> listMints = walletdb.ListMintedCoins(true, false, true);
- 
-    std::map<libzerocoin::CoinDenomination, int> mapUnconfirmed;
-    for (const auto& denom : libzerocoin::zerocoinDenomList){
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+    if (!fZerocoinBalancesDirty)
+        return;
+
+    //! zerocoin specific fields
+    std::map<libzerocoin::CoinDenomination, unsigned int> myZerocoinSupply;
+    std::map<libzerocoin::CoinDenomination, unsigned int> mapUnconfirmed;
+    for (auto& denom : libzerocoin::zerocoinDenomList) {
+        myZerocoinSupply.insert(make_pair(denom, 0));
         mapUnconfirmed.insert(make_pair(denom, 0));
     }
 
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (auto& mint : listMints){
-            if (!mint.GetHeight() || mint.GetHeight() > chainActive.Height() - Params().Zerocoin_MintRequiredConfirmations()) {
-                libzerocoin::CoinDenomination denom = mint.GetDenomination();
-                nUnconfirmed += libzerocoin::ZerocoinDenominationToAmount(denom);
-                mapUnconfirmed.at(denom)++;
-            }
+    CAmount nTotal = 0;
+    CAmount nUnconfirmed = 0;
+    list<CZerocoinMint> listMints = ListMintedCoins(true, false, true);
+    for (auto& mint : listMints) {
+        libzerocoin::CoinDenomination denom = mint.GetDenomination();
+        nTotal += libzerocoin::ZerocoinDenominationToAmount(denom);
+        if (!mint.GetHeight() || mint.GetHeight() > chainActive.Height() - Params().Zerocoin_MintRequiredConfirmations()) {
+            nUnconfirmed += libzerocoin::ZerocoinDenominationToAmount(denom);
+            mapUnconfirmed.at(denom)++;
         }
     }
 
+    CAmount nMature = 0;
+    list<CZerocoinMint> listMatureMints = ListMintedCoins(true, true, true);
+    for (auto& mint : listMatureMints) {
+        libzerocoin::CoinDenomination denom = mint.GetDenomination();
+        nMature += libzerocoin::ZerocoinDenominationToAmount(denom);
+        myZerocoinSupply.at(denom)++;
+    }
+
     for (auto& denom : libzerocoin::zerocoinDenomList) {
+        LogPrint("zero","%s My coins for denomination %d pubcoin %s\n", __func__,denom, myZerocoinSupply.at(denom));
         LogPrint("zero","%s My unconfirmed coins for denomination %d pubcoin %s\n", __func__,denom, mapUnconfirmed.at(denom));
     }
-
+    LogPrint("zero","Total value of coins %d\n",nTotal);
     LogPrint("zero","Total value of unconfirmed coins %ld\n", nUnconfirmed);
 
-    if (nUnconfirmed < 0 ) nUnconfirmed = 0; // Sanity never hurts
+    // Sanity never hurts
+    nZerocoinBalance = std::max(nTotal, CAmount(0));
+    nZerocoinMatureBalance = std::max(nMature, CAmount(0));
+    nZerocoinUnconfirmedBalance = std::max(nUnconfirmed, CAmount(0));
 
-    return nUnconfirmed;
+    // listing the mints writes back their updated status, which flags the balances dirty again
+    fZerocoinBalancesDirty = false;
+}
+
+CAmount CWallet::GetZerocoinBalance(bool fMatureOnly)
+{
+    {
+        LOCK(cs_wallet);
+        if (!fZerocoinBalancesDirty)
+            return fMatureOnly ? nZerocoinMatureBalance : nZerocoinBalance;
+    }
+
+    LOCK2(cs_main, cs_wallet);
+    UpdateZerocoinBalances();
+    return fMatureOnly ? nZerocoinMatureBalance : nZerocoinBalance;
+}
+
+CAmount CWallet::GetImmatureZerocoinBalance()
+{
+    return GetZerocoinBalance(false) - GetZerocoinBalance(true);
+}
+
+CAmount CWallet::GetUnconfirmedZerocoinBalance()
+{
+    {
+        LOCK(cs_wallet);
+        if (!fZerocoinBalancesDirty)
+            return nZerocoinUnconfirmedBalance;
+    }
+
+    LOCK2(cs_main, cs_wallet);
+    UpdateZerocoinBalances();
+    return nZerocoinUnconfirmedBalance;
 }
 
 CAmount CWallet::GetUnlockedCoins() const
@@ -1388,14 +1841,14 @@ CAmount CWallet::GetLockedCoins() const
 }
 
 // Get a Map pairing the Denominations with the amount of Zerocoin for each Denomination
-std::map<libzerocoin::CoinDenomination, CAmount> CWallet::GetMyZerocoinDistribution() const
+std::map<libzerocoin::CoinDenomination, CAmount> CWallet::GetMyZerocoinDistribution()
 {
     std::map<libzerocoin::CoinDenomination, CAmount> spread;
     for (const auto& denom : libzerocoin::zerocoinDenomList)
         spread.insert(std::pair<libzerocoin::CoinDenomination, CAmount>(denom, 0));
     {
         LOCK2(cs_main, cs_wallet);
-        list<CZerocoinMint> listPubCoin = CWalletDB(strWalletFile).ListMintedCoins(true, true, true);
+        list<CZerocoinMint> listPubCoin = ListMintedCoins(true, true, true);
         for (auto& mint : listPubCoin)
             spread.at(mint.GetDenomination())++;
     }
@@ -1403,40 +1856,18 @@ std::map<libzerocoin::CoinDenomination, CAmount> CWallet::GetMyZerocoinDistribut
 }
 
 
-CAmount CWallet::GetAnonymizableBalance() const
+CAmount CWallet::GetAnonymizableBalance()
 {
     if (fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAnonymizableCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nAnonymizable;
 }
 
-CAmount CWallet::GetAnonymizedBalance() const
+CAmount CWallet::GetAnonymizedBalance()
 {
     if (fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAnonymizedCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nAnonymized;
 }
 
 // Note: calculated including unconfirmed,
@@ -1502,168 +1933,207 @@ CAmount CWallet::GetNormalizedAnonymizedBalance() const
     return nTotal;
 }
 
-CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
+CAmount CWallet::GetDenominatedBalance(bool unconfirmed)
 {
     if (fLiteMode) return 0;
 
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
+    CWalletBalances current = GetBalances();
+    return unconfirmed ? current.nDenominatedUnconfirmed : current.nDenominated;
+}
 
-            nTotal += pcoin->GetDenominatedCredit(unconfirmed);
-        }
-    }
+CAmount CWallet::GetUnconfirmedBalance()
+{
+    return GetBalances().nUnconfirmed;
+}
 
-    return nTotal;
+CAmount CWallet::GetImmatureBalance()
+{
+    return GetBalances().nImmature;
 }
 
-CAmount CWallet::GetUnconfirmedBalance() const
+CAmount CWallet::GetWatchOnlyBalance()
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!IsFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nWatchOnly;
 }
 
-CAmount CWallet::GetImmatureBalance() const
+CAmount CWallet::GetUnconfirmedWatchOnlyBalance()
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nUnconfirmedWatchOnly;
 }
 
-CAmount CWallet::GetWatchOnlyBalance() const
+CAmount CWallet::GetImmatureWatchOnlyBalance()
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
+    return GetBalances().nImmatureWatchOnly;
+}
+
+void CWallet::QueueUnspentUpdate(const CTransaction& tx)
+{
+    AssertLockHeld(cs_wallet);
+    setUnspentPending.insert(tx.GetHash());
+    setBalancePending.insert(tx.GetHash());
+    if (!tx.IsCoinBase()) {
+        BOOST_FOREACH (const CTxIn& txin, tx.vin) {
+            setUnspentPending.insert(txin.prevout.hash);
+            setBalancePending.insert(txin.prevout.hash);
         }
     }
-
-    return nTotal;
 }
 
-CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
+//! Re-evaluate the outputs of one wallet transaction for the unspent output index
+void CWallet::UpdateUnspentOutputs(const uint256& hash)
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!IsFinalTx(*pcoin) || (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0))
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
+    setUnspentOutputs.erase(setUnspentOutputs.lower_bound(COutPoint(hash, 0)), setUnspentOutputs.upper_bound(COutPoint(hash, std::numeric_limits<uint32_t>::max())));
+    setUnspentDenominated.erase(setUnspentDenominated.lower_bound(COutPoint(hash, 0)), setUnspentDenominated.upper_bound(COutPoint(hash, std::numeric_limits<uint32_t>::max())));
+    setUnspentMNCollateral.erase(setUnspentMNCollateral.lower_bound(COutPoint(hash, 0)), setUnspentMNCollateral.upper_bound(COutPoint(hash, std::numeric_limits<uint32_t>::max())));
+
+    map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hash);
+    if (mi == mapWallet.end())
+        return;
+
+    const CWalletTx& wtx = mi->second;
+    for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+        isminetype mine = IsMine(wtx.vout[i]);
+        if (mine == ISMINE_NO || mine == ISMINE_WATCH_ONLY)
+            continue;
+
+        // only a confirmed spend is final enough to drop the output, its block being disconnected re-queues it
+        bool fSpentConfirmed = false;
+        pair<TxSpends::const_iterator, TxSpends::const_iterator> range = mapTxSpends.equal_range(COutPoint(hash, i));
+        for (TxSpends::const_iterator it = range.first; it != range.second && !fSpentConfirmed; ++it) {
+            map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(it->second);
+            fSpentConfirmed = mit != mapWallet.end() && mit->second.GetDepthInMainChain(false) > 0;
         }
+        if (fSpentConfirmed)
+            continue;
+
+        COutPoint outpoint(hash, i);
+        setUnspentOutputs.insert(outpoint);
+        if (IsDenominatedAmount(wtx.vout[i].nValue))
+            setUnspentDenominated.insert(outpoint);
+        if (wtx.vout[i].nValue == 50000 * COIN)
+            setUnspentMNCollateral.insert(outpoint);
     }
-    return nTotal;
 }
 
-CAmount CWallet::GetImmatureWatchOnlyBalance() const
+//! Bring the unspent output index up to date
+void CWallet::UpdateUnspentOutputs()
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+    if (fUnspentOutputsDirty) {
+        setUnspentOutputs.clear();
+        setUnspentDenominated.clear();
+        setUnspentMNCollateral.clear();
+        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+            UpdateUnspentOutputs(it->first);
+        fUnspentOutputsDirty = false;
+    } else {
+        BOOST_FOREACH (const uint256& hash, setUnspentPending)
+            UpdateUnspentOutputs(hash);
     }
-    return nTotal;
+    setUnspentPending.clear();
 }
 
 /**
  * populate vCoins with vector of available COutputs.
  */
-void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl* coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType, bool fUseIX) const
+void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl* coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType, bool fUseIX)
 {
     vCoins.clear();
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+        UpdateUnspentOutputs();
+
+        // only walk the outputs that can match the requested coin type
+        const std::set<COutPoint>* psetCandidates = &setUnspentOutputs;
+        if (nCoinType == ONLY_DENOMINATED)
+            psetCandidates = &setUnspentDenominated;
+        else if (nCoinType == ONLY_10000)
+            psetCandidates = &setUnspentMNCollateral;
+
+        const CWalletTx* pcoin = NULL;
+        bool fTxUsable = false;
+        int nDepth = 0;
+        BOOST_FOREACH (const COutPoint& outpoint, *psetCandidates) {
+            const uint256& wtxid = outpoint.hash;
+            // the candidates are sorted by transaction, so the per transaction checks run once for all its outputs
+            if (pcoin == NULL || pcoin->GetHash() != wtxid) {
+                map<uint256, CWalletTx>::const_iterator it = mapWallet.find(wtxid);
+                if (it == mapWallet.end()) {
+                    pcoin = NULL;
+                    continue;
+                }
+                pcoin = &(*it).second;
+                fTxUsable = false;
 
-            if (!CheckFinalTx(*pcoin))
-                continue;
+                if (!CheckFinalTx(*pcoin))
+                    continue;
 
-            if (fOnlyConfirmed && !pcoin->IsTrusted())
-                continue;
+                if (fOnlyConfirmed && !pcoin->IsTrusted())
+                    continue;
 
-            if ((pcoin->IsCoinBase() || pcoin->IsCoinStake()) && pcoin->GetBlocksToMaturity() > 0)
-                continue;
+                if ((pcoin->IsCoinBase() || pcoin->IsCoinStake()) && pcoin->GetBlocksToMaturity() > 0)
+                    continue;
 
-            int nDepth = pcoin->GetDepthInMainChain(false);
-            // do not use IX for inputs that have less then 6 blockchain confirmations
-            if (fUseIX && nDepth < 6)
-                continue;
+                nDepth = pcoin->GetDepthInMainChain(false);
+                // do not use IX for inputs that have less then 6 blockchain confirmations
+                if (fUseIX && nDepth < 6)
+                    continue;
 
-            // We should not consider coins which aren't at least in our mempool
-            // It's possible for these to be conflicted via ancestors which we may never be able to detect
-            if (nDepth == 0 && !pcoin->InMempool())
-                continue;
+                // We should not consider coins which aren't at least in our mempool
+                // It's possible for these to be conflicted via ancestors which we may never be able to detect
+                if (nDepth == 0 && !pcoin->InMempool())
+                    continue;
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-                bool found = false;
-                if (nCoinType == ONLY_DENOMINATED) {
-                    found = IsDenominatedAmount(pcoin->vout[i].nValue);
-                } else if (nCoinType == ONLY_NOT10000IFMN) {
-                    found = !(fMasterNode && pcoin->vout[i].nValue == 50000 * COIN);
-                } else if (nCoinType == ONLY_NONDENOMINATED_NOT10000IFMN) {
-                    if (IsCollateralAmount(pcoin->vout[i].nValue)) continue; // do not use collateral amounts
-                    found = !IsDenominatedAmount(pcoin->vout[i].nValue);
-                    if (found && fMasterNode) found = pcoin->vout[i].nValue != 50000 * COIN; // do not use Hot MN funds
-                } else if (nCoinType == ONLY_10000) {
-                    found = pcoin->vout[i].nValue == 50000 * COIN;
-                } else {
-                    found = true;
-                }
-                if (!found) continue;
+                fTxUsable = true;
+            }
+            if (!fTxUsable)
+                continue;
 
-                if (nCoinType == STAKABLE_COINS) {
-                    if (pcoin->vout[i].IsZerocoinMint())
-                        continue;
-                }
+            unsigned int i = outpoint.n;
+            bool found = false;
+            if (nCoinType == ONLY_DENOMINATED) {
+                found = IsDenominatedAmount(pcoin->vout[i].nValue);
+            } else if (nCoinType == ONLY_NOT10000IFMN) {
+                found = !(fMasterNode && pcoin->vout[i].nValue == 50000 * COIN);
+            } else if (nCoinType == ONLY_NONDENOMINATED_NOT10000IFMN) {
+                if (IsCollateralAmount(pcoin->vout[i].nValue)) continue; // do not use collateral amounts
+                found = !IsDenominatedAmount(pcoin->vout[i].nValue);
+                if (found && fMasterNode) found = pcoin->vout[i].nValue != 50000 * COIN; // do not use Hot MN funds
+            } else if (nCoinType == ONLY_10000) {
+                found = pcoin->vout[i].nValue == 50000 * COIN;
+            } else {
+                found = true;
+            }
+            if (!found) continue;
 
-                isminetype mine = IsMine(pcoin->vout[i]);
-                if (IsSpent(wtxid, i))
-                    continue;
-                if (mine == ISMINE_NO)
-                    continue;
-                if (mine == ISMINE_WATCH_ONLY)
+            if (nCoinType == STAKABLE_COINS) {
+                if (pcoin->vout[i].IsZerocoinMint())
                     continue;
+            }
 
-                if (IsLockedCoin((*it).first, i) && nCoinType != ONLY_10000)
-                    continue;
-                if (pcoin->vout[i].nValue <= 0 && !fIncludeZeroValue)
-                    continue;
-                if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected((*it).first, i))
-                    continue;
+            isminetype mine = IsMine(pcoin->vout[i]);
+            if (IsSpent(wtxid, i))
+                continue;
+            if (mine == ISMINE_NO)
+                continue;
+            if (mine == ISMINE_WATCH_ONLY)
+                continue;
 
-                bool fIsSpendable = false;
-                if ((mine & ISMINE_SPENDABLE) != ISMINE_NO)
-                    fIsSpendable = true;
-                if ((mine & ISMINE_MULTISIG) != ISMINE_NO)
-                    fIsSpendable = true;
-                vCoins.emplace_back(COutput(pcoin, i, nDepth, fIsSpendable));
-            }
+            if (IsLockedCoin(wtxid, i) && nCoinType != ONLY_10000)
+                continue;
+            if (pcoin->vout[i].nValue <= 0 && !fIncludeZeroValue)
+                continue;
+            if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs && !coinControl->IsSelected(wtxid, i))
+                continue;
+
+            bool fIsSpendable = false;
+            if ((mine & ISMINE_SPENDABLE) != ISMINE_NO)
+                fIsSpendable = true;
+            if ((mine & ISMINE_MULTISIG) != ISMINE_NO)
+                fIsSpendable = true;
+            vCoins.emplace_back(COutput(pcoin, i, nDepth, fIsSpendable));
         }
     }
 }
@@ -1745,7 +2215,7 @@ bool less_then_denom(const COutput& out1, const COutput& out2)
     return (!found1 && found2);
 }
 
-bool CWallet::SelectStakeCoins(std::set<std::pair<const CWalletTx*, unsigned int> >& setCoins, CAmount nTargetAmount) const
+bool CWallet::SelectStakeCoins(std::set<std::pair<const CWalletTx*, unsigned int> >& setCoins, CAmount nTargetAmount)
 {
     vector<COutput> vCoins;
     AvailableCoins(vCoins, true, NULL, false, STAKABLE_COINS);
@@ -1912,7 +2382,7 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int
     return true;
 }
 
-bool CWallet::SelectCoins(const CAmount& nTargetValue, set<pair<const CWalletTx*, unsigned int> >& setCoinsRet, CAmount& nValueRet, const CCoinControl* coinControl, AvailableCoinsType coin_type, bool useIX) const
+bool CWallet::SelectCoins(const CAmount& nTargetValue, set<pair<const CWalletTx*, unsigned int> >& setCoinsRet, CAmount& nValueRet, const CCoinControl* coinControl, AvailableCoinsType coin_type, bool useIX)
 {
     // Note: this function should never be used for "always free" tx types like dstx
 
@@ -2076,7 +2546,7 @@ bool CWallet::SelectCoinsByDenominations(int nDenom, CAmount nValueMin, CAmount
     return (nValueRet >= nValueMin && fFound10000 && fFound1000 && fFound100 && fFound10 && fFound1 && fFoundDot1);
 }
 
-bool CWallet::SelectCoinsDark(CAmount nValueMin, CAmount nValueMax, std::vector<CTxIn>& setCoinsRet, CAmount& nValueRet, int nObfuscationRoundsMin, int nObfuscationRoundsMax) const
+bool CWallet::SelectCoinsDark(CAmount nValueMin, CAmount nValueMax, std::vector<CTxIn>& setCoinsRet, CAmount& nValueRet, int nObfuscationRoundsMin, int nObfuscationRoundsMax)
 {
     CCoinControl* coinControl = NULL;
 
@@ -2118,7 +2588,7 @@ bool CWallet::SelectCoinsDark(CAmount nValueMin, CAmount nValueMax, std::vector<
     return false;
 }
 
-bool CWallet::SelectCoinsCollateral(std::vector<CTxIn>& setCoinsRet, CAmount& nValueRet) const
+bool CWallet::SelectCoinsCollateral(std::vector<CTxIn>& setCoinsRet, CAmount& nValueRet)
 {
     vector<COutput> vCoins;
 
@@ -2172,7 +2642,7 @@ int CWallet::CountInputsWithAmount(CAmount nInputAmount)
     return nTotal;
 }
 
-bool CWallet::HasCollateralInputs(bool fOnlyConfirmed) const
+bool CWallet::HasCollateralInputs(bool fOnlyConfirmed)
 {
     vector<COutput> vCoins;
     AvailableCoins(vCoins, fOnlyConfirmed);
@@ -2516,6 +2986,198 @@ bool CWallet::CreateTransaction(CScript scriptPubKey, const CAmount& nValue, CWa
 }
 
 // ppcoin: create coin stake transaction
+//! A coin that can stake, together with the kernel data of the block it is from
+struct CStakeInput {
+    const CWalletTx* pwtx;
+    unsigned int n;
+    CStakeKernelInput kernel;
+};
+
+/**
+ * Persistent workers searching the stake kernels for CreateCoinStake, running as long as the stake minter does.
+ * Each search hands every worker an interleaved share of the inputs. The workers only hash the kernel data
+ * captured under cs_main and never take it themselves, so a new tip announced through UpdatedBlockTip calls
+ * them off instead. They also all stop as soon as one of them finds a kernel.
+ */
+class CStakeSearchThreads : public CValidationInterface
+{
+private:
+    boost::mutex mutexSearch; // one search at a time
+    boost::mutex mutex;
+    boost::condition_variable condSearch; // a search was handed out
+    boost::condition_variable condDone;   // the last worker finished its share
+    boost::thread_group threadGroup;
+    int nThreads;
+    int nSearch; // counts the searches handed out, so every worker takes each one exactly once
+    int nRunning;
+    const CBlockIndex* pindexBest; // most work tip announced so far
+
+    // the running search
+    const vector<CStakeInput>* pvInputs;
+    unsigned int nBits;
+    unsigned int nHashDrift;
+    unsigned int nTimeStart;
+    int64_t nMedianTimePast;
+    const CBlockIndex* pindexStart;
+    std::atomic<bool> fStop;
+    bool fFound;
+    size_t nKernel;
+    unsigned int nTimeKernel;
+    uint256 hashProof;
+
+    void SearchShare(int nShare, int nShares);
+    void Thread(int nThread);
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindex);
+
+public:
+    CStakeSearchThreads() : nThreads(0), nSearch(0), nRunning(0), pindexBest(NULL), pvInputs(NULL), pindexStart(NULL), fStop(false), fFound(false) {}
+
+    void Start(int nThreadsIn);
+    void Stop();
+    /** Search vInputs for a kernel from nTimeTx on, using the kernel data captured at tip pindexStartIn. On success
+     *  nKernelRet is the index of the staking input and nTimeTx its kernel time. */
+    bool Search(const vector<CStakeInput>& vInputs, unsigned int nBitsIn, unsigned int nHashDriftIn, const CBlockIndex* pindexStartIn, int64_t nMedianTimePastIn, unsigned int& nTimeTx, size_t& nKernelRet, uint256& hashProofRet);
+};
+
+static CStakeSearchThreads stakeSearchThreads;
+
+void CStakeSearchThreads::SearchShare(int nShare, int nShares)
+{
+    for (size_t i = nShare; i < pvInputs->size() && !fStop; i += nShares) {
+        const CStakeInput& input = (*pvInputs)[i];
+        unsigned int nTimeTry = nTimeStart;
+        uint256 hashProofOfStake = 0;
+        if (!SearchStakeKernelHash(nBits, input.kernel, nTimeTry, nHashDrift, fStop, hashProofOfStake, true))
+            continue;
+
+        //Double check that this will pass time requirements
+        if (nTimeTry <= nMedianTimePast) {
+            LogPrintf("CreateCoinStake() : kernel found, but it is too far in the past \n");
+            continue;
+        }
+
+        boost::lock_guard<boost::mutex> lock(mutex);
+        if (!fFound) {
+            nKernel = i;
+            nTimeKernel = nTimeTry;
+            hashProof = hashProofOfStake;
+            fFound = true;
+        }
+        fStop = true;
+    }
+}
+
+void CStakeSearchThreads::Thread(int nThread)
+{
+    RenameThread("loonie-stake");
+    int nSearchDone = 0;
+    while (true) {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (nSearch == nSearchDone)
+                condSearch.wait(lock);
+            nSearchDone = nSearch;
+        }
+
+        SearchShare(nThread, nThreads);
+
+        boost::lock_guard<boost::mutex> lock(mutex);
+        if (--nRunning == 0)
+            condDone.notify_one();
+    }
+}
+
+void CStakeSearchThreads::UpdatedBlockTip(const CBlockIndex* pindex)
+{
+    //a new tip makes every kernel time tried so far stale; a late announcement of an older one does not
+    boost::lock_guard<boost::mutex> lock(mutex);
+    if (pindexBest == NULL || pindex->nChainWork > pindexBest->nChainWork)
+        pindexBest = pindex;
+    if (pindexStart != NULL && pindexBest->nChainWork > pindexStart->nChainWork)
+        fStop = true;
+}
+
+void CStakeSearchThreads::Start(int nThreadsIn)
+{
+    nThreads = nThreadsIn;
+    for (int i = 0; i < nThreads; i++)
+        threadGroup.create_thread(boost::bind(&CStakeSearchThreads::Thread, this, i));
+    RegisterValidationInterface(this);
+}
+
+void CStakeSearchThreads::Stop()
+{
+    UnregisterValidationInterface(this);
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+    nThreads = 0;
+}
+
+bool CStakeSearchThreads::Search(const vector<CStakeInput>& vInputs, unsigned int nBitsIn, unsigned int nHashDriftIn, const CBlockIndex* pindexStartIn, int64_t nMedianTimePastIn, unsigned int& nTimeTx, size_t& nKernelRet, uint256& hashProofRet)
+{
+    if (vInputs.empty())
+        return false;
+
+    boost::lock_guard<boost::mutex> lockSearch(mutexSearch);
+    boost::unique_lock<boost::mutex> lock(mutex);
+    pvInputs = &vInputs;
+    nBits = nBitsIn;
+    nHashDrift = nHashDriftIn;
+    nTimeStart = nTimeTx;
+    nMedianTimePast = nMedianTimePastIn;
+    pindexStart = pindexStartIn;
+    fStop = pindexBest != NULL && pindexBest->nChainWork > pindexStart->nChainWork;
+    fFound = false;
+
+    if (nThreads == 0) {
+        // no stake minter running, search on the calling thread
+        lock.unlock();
+        SearchShare(0, 1);
+        lock.lock();
+    } else {
+        nRunning = nThreads;
+        nSearch++;
+        condSearch.notify_all();
+        try {
+            while (nRunning > 0)
+                condDone.wait(lock);
+        } catch (const boost::thread_interrupted&) {
+            // the inputs belong to the caller, the workers have to be done with them before it unwinds
+            fStop = true;
+            boost::this_thread::disable_interruption di;
+            while (nRunning > 0)
+                condDone.wait(lock);
+            pvInputs = NULL;
+            pindexStart = NULL;
+            throw;
+        }
+    }
+    pvInputs = NULL;
+    pindexStart = NULL;
+
+    if (fFound) {
+        nKernelRet = nKernel;
+        nTimeTx = nTimeKernel;
+        hashProofRet = hashProof;
+    }
+    return fFound;
+}
+
+void StartStakeSearchThreads()
+{
+    int nStakeThreads = GetArg("-stakethreads", DEFAULT_STAKE_THREADS);
+    if (nStakeThreads <= 0)
+        nStakeThreads = boost::thread::hardware_concurrency();
+    stakeSearchThreads.Start(std::max(1, std::min(nStakeThreads, MAX_STAKE_THREADS)));
+}
+
+void StopStakeSearchThreads()
+{
+    stakeSearchThreads.Stop();
+}
+
 bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int64_t nSearchInterval, CMutableTransaction& txNew, unsigned int& nTxNewTime)
 {
     // The following split & combine thresholds are important to security
@@ -2559,92 +3221,108 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
     CAmount nCredit = 0;
     CScript scriptPubKeyKernel;
 
-    //prevent staking a time that won't be accepted
-    if (GetAdjustedTime() <= chainActive.Tip()->nTime)
-        MilliSleep(10000);
+    //capture everything the kernel search needs from the chain, the search itself runs without cs_main
+    vector<CStakeInput> vStakeInputs;
+    const CBlockIndex* pindexStart;
+    int nHeightStart;
+    int64_t nMedianTimePast;
+    unsigned int nTimeTip;
+    {
+        LOCK2(cs_main, cs_wallet);
+        pindexStart = chainActive.Tip();
+        nHeightStart = chainActive.Height();
+        nMedianTimePast = chainActive.Tip()->GetMedianTimePast();
+        nTimeTip = chainActive.Tip()->nTime;
+
+        BOOST_FOREACH (PAIRTYPE(const CWalletTx*, unsigned int) pcoin, setStakeCoins) {
+            //make sure that enough time has elapsed between
+            BlockMap::iterator it = mapBlockIndex.find(pcoin.first->hashBlock);
+            if (it == mapBlockIndex.end()) {
+                if (fDebug)
+                    LogPrintf("CreateCoinStake() failed to find block index \n");
+                continue;
+            }
 
-    BOOST_FOREACH (PAIRTYPE(const CWalletTx*, unsigned int) pcoin, setStakeCoins) {
-        //make sure that enough time has elapsed between
-        CBlockIndex* pindex = NULL;
-        BlockMap::iterator it = mapBlockIndex.find(pcoin.first->hashBlock);
-        if (it != mapBlockIndex.end())
-            pindex = it->second;
-        else {
-            if (fDebug)
-                LogPrintf("CreateCoinStake() failed to find block index \n");
-            continue;
+            CStakeInput input;
+            input.pwtx = pcoin.first;
+            input.n = pcoin.second;
+            if (!GetStakeKernelInput(it->second, *input.pwtx, COutPoint(input.pwtx->GetHash(), input.n), input.kernel, true))
+                continue;
+            vStakeInputs.push_back(input);
         }
+    }
 
-        // Read block header
-        CBlockHeader block = pindex->GetBlockHeader();
+    //prevent staking a time that won't be accepted: only try times after the tip instead of waiting for the clock to pass it
+    nTxNewTime = GetAdjustedTime();
+    unsigned int nHashDriftSearch = nHashDrift;
+    if (nTxNewTime <= nTimeTip) {
+        unsigned int nBehind = nTimeTip - nTxNewTime + 1;
+        if (nBehind >= nHashDriftSearch)
+            return false;
+        nTxNewTime += nBehind;
+        nHashDriftSearch -= nBehind;
+    }
 
-        bool fKernelFound = false;
-        uint256 hashProofOfStake = 0;
-        COutPoint prevoutStake = COutPoint(pcoin.first->GetHash(), pcoin.second);
-        nTxNewTime = GetAdjustedTime();
-
-        //iterates each utxo inside of CheckStakeKernelHash()
-        if (CheckStakeKernelHash(nBits, block, *pcoin.first, prevoutStake, nTxNewTime, nHashDrift, false, hashProofOfStake, true)) {
-            //Double check that this will pass time requirements
-            if (nTxNewTime <= chainActive.Tip()->GetMedianTimePast()) {
-                LogPrintf("CreateCoinStake() : kernel found, but it is too far in the past \n");
-                continue;
-            }
+    size_t nKernel = 0;
+    uint256 hashProofOfStake = 0;
+    bool fKernelFound = stakeSearchThreads.Search(vStakeInputs, nBits, nHashDriftSearch, pindexStart, nMedianTimePast, nTxNewTime, nKernel, hashProofOfStake);
 
-            // Found a kernel
-            if (fDebug && GetBoolArg("-printcoinstake", false))
-                LogPrintf("CreateCoinStake : kernel found\n");
-
-            vector<valtype> vSolutions;
-            txnouttype whichType;
-            CScript scriptPubKeyOut;
-            scriptPubKeyKernel = pcoin.first->vout[pcoin.second].scriptPubKey;
-            if (!Solver(scriptPubKeyKernel, whichType, vSolutions)) {
-                LogPrintf("CreateCoinStake : failed to parse kernel\n");
-                break;
-            }
+    mapHashedBlocks.clear();
+    mapHashedBlocks[nHeightStart] = GetTime(); //store a time stamp of when we last hashed on this block
+
+    if (!fKernelFound)
+        return false;
+
+    // Found a kernel
+    const CWalletTx* pwtxKernel = vStakeInputs[nKernel].pwtx;
+    unsigned int nKernelOut = vStakeInputs[nKernel].n;
+    if (fDebug && GetBoolArg("-printcoinstake", false))
+        LogPrintf("CreateCoinStake : kernel found\n");
+
+    vector<valtype> vSolutions;
+    txnouttype whichType;
+    CScript scriptPubKeyOut;
+    scriptPubKeyKernel = pwtxKernel->vout[nKernelOut].scriptPubKey;
+    if (!Solver(scriptPubKeyKernel, whichType, vSolutions)) {
+        LogPrintf("CreateCoinStake : failed to parse kernel\n");
+        return false;
+    }
+    if (fDebug && GetBoolArg("-printcoinstake", false))
+        LogPrintf("CreateCoinStake : parsed kernel type=%d\n", whichType);
+    if (whichType != TX_PUBKEY && whichType != TX_PUBKEYHASH) {
+        if (fDebug && GetBoolArg("-printcoinstake", false))
+            LogPrintf("CreateCoinStake : no support for kernel type=%d\n", whichType);
+        return false; // only support pay to public key and pay to address
+    }
+    if (whichType == TX_PUBKEYHASH) // pay to address type
+    {
+        //convert to pay to public key type
+        CKey key;
+        if (!keystore.GetKey(uint160(vSolutions[0]), key)) {
             if (fDebug && GetBoolArg("-printcoinstake", false))
-                LogPrintf("CreateCoinStake : parsed kernel type=%d\n", whichType);
-            if (whichType != TX_PUBKEY && whichType != TX_PUBKEYHASH) {
-                if (fDebug && GetBoolArg("-printcoinstake", false))
-                    LogPrintf("CreateCoinStake : no support for kernel type=%d\n", whichType);
-                break; // only support pay to public key and pay to address
-            }
-            if (whichType == TX_PUBKEYHASH) // pay to address type
-            {
-                //convert to pay to public key type
-                CKey key;
-                if (!keystore.GetKey(uint160(vSolutions[0]), key)) {
-                    if (fDebug && GetBoolArg("-printcoinstake", false))
-                        LogPrintf("CreateCoinStake : failed to get key for kernel type=%d\n", whichType);
-                    break; // unable to find corresponding public key
-                }
+                LogPrintf("CreateCoinStake : failed to get key for kernel type=%d\n", whichType);
+            return false; // unable to find corresponding public key
+        }
 
-                scriptPubKeyOut << key.GetPubKey() << OP_CHECKSIG;
-            } else
-                scriptPubKeyOut = scriptPubKeyKernel;
+        scriptPubKeyOut << key.GetPubKey() << OP_CHECKSIG;
+    } else
+        scriptPubKeyOut = scriptPubKeyKernel;
 
-            txNew.vin.push_back(CTxIn(pcoin.first->GetHash(), pcoin.second));
-            nCredit += pcoin.first->vout[pcoin.second].nValue;
-            vwtxPrev.push_back(pcoin.first);
-            txNew.vout.push_back(CTxOut(0, scriptPubKeyOut));
+    txNew.vin.push_back(CTxIn(pwtxKernel->GetHash(), nKernelOut));
+    nCredit += pwtxKernel->vout[nKernelOut].nValue;
+    vwtxPrev.push_back(pwtxKernel);
+    txNew.vout.push_back(CTxOut(0, scriptPubKeyOut));
 
-            //presstab HyperStake - calculate the total size of our new output including the stake reward so that we can use it to decide whether to split the stake outputs
-            const CBlockIndex* pIndex0 = chainActive.Tip();
-            uint64_t nTotalSize = pcoin.first->vout[pcoin.second].nValue + GetBlockValue(pIndex0->nHeight);
+    //presstab HyperStake - calculate the total size of our new output including the stake reward so that we can use it to decide whether to split the stake outputs
+    uint64_t nTotalSize = pwtxKernel->vout[nKernelOut].nValue + GetBlockValue(chainActive.Tip()->nHeight);
 
-            //presstab HyperStake - if MultiSend is set to send in coinstake we will add our outputs here (values asigned further down)
-            if (nTotalSize / 2 > nStakeSplitThreshold * COIN)
-                txNew.vout.push_back(CTxOut(0, scriptPubKeyOut)); //split stake
+    //presstab HyperStake - if MultiSend is set to send in coinstake we will add our outputs here (values asigned further down)
+    if (nTotalSize / 2 > nStakeSplitThreshold * COIN)
+        txNew.vout.push_back(CTxOut(0, scriptPubKeyOut)); //split stake
+
+    if (fDebug && GetBoolArg("-printcoinstake", false))
+        LogPrintf("CreateCoinStake : added kernel type=%d\n", whichType);
 
-            if (fDebug && GetBoolArg("-printcoinstake", false))
-                LogPrintf("CreateCoinStake : added kernel type=%d\n", whichType);
-            fKernelFound = true;
-            break;
-        }
-        if (fKernelFound)
-            break; // if kernel is found stop searching
-    }
     if (nCredit == 0 || nCredit > nBalance - nReserveBalance)
         return false;
 
@@ -2964,6 +3642,11 @@ DBErrors CWallet::ZapWalletTx(std::vector<CWalletTx>& vWtx)
     if (nZapWalletTxRet != DB_LOAD_OK)
         return nZapWalletTxRet;
 
+    {
+        LOCK(cs_wallet);
+        fUnspentOutputsDirty = true;
+        fBalancesDirty = true;
+    }
     return DB_LOAD_OK;
 }
 
@@ -3349,6 +4032,8 @@ bool CWallet::UpdatedTransaction(const uint256& hashTx)
         // Only notify UI if this transaction is in this wallet
         map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hashTx);
         if (mi != mapWallet.end()) {
+            // a completed SwiftTX lock changes its trust and depth without a tip or mempool change
+            QueueBalanceUpdate(hashTx);
             NotifyTransactionChanged(this, hashTx, CT_UPDATED);
             return true;
         }
@@ -3930,6 +4615,7 @@ int CMerkleTx::GetTransactionLockSignatures() const
     if (!fEnableSwiftTX) return -1;
 
     //compile consessus vote
+    LOCK(cs_mapTxLocks);
     std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
     if (i != mapTxLocks.end()) {
         return (*i).second.CountSignatures();
@@ -3943,6 +4629,7 @@ bool CMerkleTx::IsTransactionLockTimedOut() const
     if (!fEnableSwiftTX) return 0;
 
     //compile consessus vote
+    LOCK(cs_mapTxLocks);
     std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
     if (i != mapTxLocks.end()) {
         return GetTime() > (*i).second.nTimeout;
@@ -4078,7 +4765,12 @@ bool CWallet::MintToTxIn(CZerocoinMint zerocoinSelected, int nSecurityLevel, con
     libzerocoin::AccumulatorWitness witness(Params().Zerocoin_Params(), accumulator, pubCoinSelected);
     string strFailReason = "";
     int nMintsAdded = 0;
-    if (!GenerateAccumulatorWitness(zerocoinSelected, accumulator, witness, nSecurityLevel, nMintsAdded, strFailReason)) {
+    CZerocoinWitness witnessCache;
+    GetZerocoinWitness(zerocoinSelected.GetValue(), witnessCache);
+    bool fWitness = GenerateAccumulatorWitness(zerocoinSelected, accumulator, witness, nSecurityLevel, nMintsAdded, strFailReason, &witnessCache);
+    if (!witnessCache.IsNull())
+        SetZerocoinWitness(witnessCache);
+    if (!fWitness) {
         receipt.SetStatus("Try to spend with a higher security level to include more coins", ZLNI_FAILED_ACCUMULATOR_INITIALIZATION);
         LogPrintf("%s : %s \n", __func__, receipt.GetStatusMessage());
         return false;
@@ -4134,7 +4826,8 @@ bool CWallet::MintToTxIn(CZerocoinMint zerocoinSelected, int nSecurityLevel, con
             if (spend.getCoinSerialNumber() == item) {
                 //Tried to spend an already spent zLNI
                 zerocoinSelected.SetUsed(true);
-                if (!CWalletDB(strWalletFile).WriteZerocoinMint(zerocoinSelected))
+                CWalletDB walletdb(strWalletFile);
+                if (!WriteZerocoinMint(walletdb, zerocoinSelected))
                     LogPrintf("%s failed to write zerocoinmint\n", __func__);
 
                 pwalletMain->NotifyZerocoinChanged(pwalletMain, zerocoinSelected.GetValue().GetHex(), "Used", CT_UPDATED);
@@ -4183,7 +4876,7 @@ bool CWallet::CreateZerocoinSpendTransaction(CAmount nValue, int nSecurityLevel,
     int nNeededSpends = 0;  // Number of spends which would be needed if selection failed
     const int nMaxSpends = Params().Zerocoin_MaxSpendsPerTransaction(); // Maximum possible spends for one zLNI transaction
     if (vSelectedMints.empty()) {
-        listMints = walletdb.ListMintedCoins(true, true, true); // need to find mints to spend
+        listMints = ListMintedCoins(true, true, true); // need to find mints to spend
         if(listMints.empty()) {
             receipt.SetStatus("failed to find Zerocoins in in wallet.dat", nStatus);
             return false;
@@ -4214,7 +4907,7 @@ bool CWallet::CreateZerocoinSpendTransaction(CAmount nValue, int nSecurityLevel,
             receipt.SetStatus("trying to spend an already spent serial #, try again.", nStatus);
 
             mint.SetUsed(true);
-            walletdb.WriteZerocoinMint(mint);
+            WriteZerocoinMint(walletdb, mint);
 
             return false;
         }
@@ -4233,7 +4926,7 @@ bool CWallet::CreateZerocoinSpendTransaction(CAmount nValue, int nSecurityLevel,
 
         // archive this mint as an orphan
         if (fArchive) {
-            walletdb.ArchiveMintOrphan(mint);
+            ArchiveMintOrphan(walletdb, mint);
             nArchived++;
         }
     }
@@ -4326,7 +5019,7 @@ bool CWallet::CreateZerocoinSpendTransaction(CAmount nValue, int nSecurityLevel,
             for (CZerocoinSpend spend : receipt.GetSpends()) {
                 spend.SetTxHash(txHash);
 
-                if (!CWalletDB(strWalletFile).WriteZerocoinSpendSerialEntry(spend)) {
+                if (!WriteZerocoinSpendSerialEntry(walletdb, spend)) {
                     receipt.SetStatus("failed to write coin serial number into wallet", nStatus);
                 }
             }
@@ -4350,7 +5043,7 @@ string CWallet::ResetMintZerocoin(bool fExtendedSearch)
     long deletions = 0;
     CWalletDB walletdb(pwalletMain->strWalletFile);
 
-    list<CZerocoinMint> listMints = walletdb.ListMintedCoins(false, false, true);
+    list<CZerocoinMint> listMints = ListMintedCoins(false, false, true);
     vector<CZerocoinMint> vMintsToFind{ std::make_move_iterator(std::begin(listMints)), std::make_move_iterator(std::end(listMints)) };
     vector<CZerocoinMint> vMintsMissing;
     vector<CZerocoinMint> vMintsToUpdate;
@@ -4361,13 +5054,13 @@ string CWallet::ResetMintZerocoin(bool fExtendedSearch)
     // Update the meta data of mints that were marked for updating
     for (CZerocoinMint mint : vMintsToUpdate) {
         updates++;
-        walletdb.WriteZerocoinMint(mint);
+        WriteZerocoinMint(walletdb, mint);
     }
 
     // Delete any mints that were unable to be located on the blockchain
     for (CZerocoinMint mint : vMintsMissing) {
         deletions++;
-        walletdb.ArchiveMintOrphan(mint);
+        ArchiveMintOrphan(walletdb, mint);
     }
 
     string strResult = _("ResetMintZerocoin finished: ") + to_string(updates) + _(" mints updated, ") + to_string(deletions) + _(" mints deleted\n");
@@ -4379,7 +5072,7 @@ string CWallet::ResetSpentZerocoin()
     long removed = 0;
     CWalletDB walletdb(pwalletMain->strWalletFile);
 
-    list<CZerocoinMint> listMints = walletdb.ListMintedCoins(false, false, false);
+    list<CZerocoinMint> listMints = ListMintedCoins(false, false, false);
     list<CZerocoinSpend> listSpends = walletdb.ListSpentCoins();
     list<CZerocoinSpend> listUnconfirmedSpends;
 
@@ -4402,8 +5095,8 @@ string CWallet::ResetSpentZerocoin()
                 removed++;
                 mint.SetUsed(false);
                 RemoveSerialFromDB(spend.GetSerial());
-                walletdb.WriteZerocoinMint(mint);
-                walletdb.EraseZerocoinSpendSerialEntry(spend.GetSerial());
+                WriteZerocoinMint(walletdb, mint);
+                EraseZerocoinSpendSerialEntry(walletdb, spend.GetSerial());
                 continue;
             }
         }
@@ -4436,7 +5129,7 @@ void CWallet::ReconsiderZerocoins(std::list<CZerocoinMint>& listMintsRestored)
 
         mint.SetTxHash(txHash);
         mint.SetHeight(mapBlockIndex.at(hashBlock)->nHeight);
-        if (!walletdb.UnarchiveZerocoin(mint)) {
+        if (!UnarchiveZerocoin(walletdb, mint)) {
             LogPrintf("%s : failed to unarchive mint %s\n", __func__, mint.GetValue().GetHex());
         }
         listMintsRestored.emplace_back(mint);
@@ -4522,7 +5215,7 @@ string CWallet::MintZerocoin(CAmount nValue, CWalletTx& wtxNew, vector<CZerocoin
         CWalletDB walletdb(pwalletMain->strWalletFile);
         for (CZerocoinMint mint : vMints) {
             mint.SetTxHash(wtxNew.GetHash());
-            walletdb.WriteZerocoinMint(mint);
+            WriteZerocoinMint(walletdb, mint);
             pwalletMain->NotifyZerocoinChanged(pwalletMain, mint.GetValue().GetHex(), "Used", CT_UPDATED);
         }
     }
@@ -4561,13 +5254,13 @@ bool CWallet::SpendZerocoin(CAmount nAmount, int nSecurityLevel, CWalletTx& wtxN
         //reset all mints
         for (CZerocoinMint mint : vMintsSelected) {
             mint.SetUsed(false); // having error, so set to false, to be able to use again
-            walletdb.WriteZerocoinMint(mint);
+            WriteZerocoinMint(walletdb, mint);
             pwalletMain->NotifyZerocoinChanged(pwalletMain, mint.GetValue().GetHex(), "New", CT_UPDATED);
         }
 
         //erase spends
         for (CZerocoinSpend spend : receipt.GetSpends()) {
-            if (!walletdb.EraseZerocoinSpendSerialEntry(spend.GetSerial())) {
+            if (!EraseZerocoinSpendSerialEntry(walletdb, spend.GetSerial())) {
                 receipt.SetStatus("Error: It cannot delete coin serial number in wallet", ZLNI_ERASE_SPENDS_FAILED);
             }
 
@@ -4577,7 +5270,7 @@ bool CWallet::SpendZerocoin(CAmount nAmount, int nSecurityLevel, CWalletTx& wtxN
 
         // erase new mints
         for (auto& mint : vNewMints) {
-            if (!walletdb.EraseZerocoinMint(mint)) {
+            if (!EraseZerocoinMint(walletdb, mint)) {
                 receipt.SetStatus("Error: Unable to cannot delete zerocoin mint in wallet", ZLNI_ERASE_NEW_MINTS_FAILED);
             }
         }
@@ -4588,7 +5281,7 @@ bool CWallet::SpendZerocoin(CAmount nAmount, int nSecurityLevel, CWalletTx& wtxN
 
     for (CZerocoinMint mint : vMintsSelected) {
         mint.SetUsed(true);
-        if (!walletdb.WriteZerocoinMint(mint)) {
+        if (!WriteZerocoinMint(walletdb, mint)) {
             receipt.SetStatus("Failed to write mint to db", nStatus);
             return false;
         }
@@ -4608,7 +5301,7 @@ bool CWallet::SpendZerocoin(CAmount nAmount, int nSecurityLevel, CWalletTx& wtxN
     // write new Mints to db
     for (CZerocoinMint mint : vNewMints) {
         mint.SetTxHash(wtxNew.GetHash());
-        walletdb.WriteZerocoinMint(mint);
+        WriteZerocoinMint(walletdb, mint);
     }
 
     receipt.SetStatus("Spend Successful", ZLNI_SPEND_OKAY);  // When we reach this point spending zLNI was successful
@@ -54,6 +54,10 @@ static const CAmount DEFAULT_TRANSACTION_MAXFEE = 1 * COIN;
 static const CAmount nHighTransactionMaxFeeWarning = 100 * nHighTransactionFeeWarning;
 //! Largest (in bytes) free transaction we're willing to create
 static const unsigned int MAX_FREE_TRANSACTION_CREATE_SIZE = 1000;
+//! -stakethreads default, 0 = one per core
+static const int DEFAULT_STAKE_THREADS = 0;
+//! Maximum number of threads searching for a stake kernel
+static const int MAX_STAKE_THREADS = 16;
 
 // Zerocoin denomination which creates exactly one of each denominations:
 // 6666 = 1*5000 + 1*1000 + 1*500 + 1*100 + 1*50 + 1*10 + 1*5 + 1
@@ -66,6 +70,14 @@ class CReserveKey;
 class CScript;
 class CWalletTx;
 
+/** Start the -stakethreads threads CreateCoinStake searches stake kernels on, run by the stake minter */
+void StartStakeSearchThreads();
+/** Stop them again, with no search running */
+void StopStakeSearchThreads();
+
+/** Advance the cached accumulator witnesses of pwalletMain after every checkpoint, except during initial block download */
+void ThreadUpdateZerocoinWitnesses();
+
 /** (client) version numbers for particular wallet features */
 enum WalletFeature {
     FEATURE_BASE = 10500, // the earliest version new wallets supports (only useful for getinfo's clientversion output)
@@ -104,6 +116,63 @@ enum ZerocoinSpendStatus {
     ZLNI_SPENT_USED_ZLNI = 14                       // Coin has already been spend
 };
 
+/** Credit of one wallet transaction per balance category, or the running totals of the whole wallet */
+struct CWalletBalances {
+    CAmount nTrusted;
+    CAmount nUnconfirmed;
+    CAmount nImmature;
+    CAmount nWatchOnly;
+    CAmount nUnconfirmedWatchOnly;
+    CAmount nImmatureWatchOnly;
+    CAmount nAnonymizable;
+    CAmount nAnonymized;
+    CAmount nDenominated;
+    CAmount nDenominatedUnconfirmed;
+
+    CWalletBalances()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        nTrusted = nUnconfirmed = nImmature = 0;
+        nWatchOnly = nUnconfirmedWatchOnly = nImmatureWatchOnly = 0;
+        nAnonymizable = nAnonymized = 0;
+        nDenominated = nDenominatedUnconfirmed = 0;
+    }
+
+    CWalletBalances& operator+=(const CWalletBalances& b)
+    {
+        nTrusted += b.nTrusted;
+        nUnconfirmed += b.nUnconfirmed;
+        nImmature += b.nImmature;
+        nWatchOnly += b.nWatchOnly;
+        nUnconfirmedWatchOnly += b.nUnconfirmedWatchOnly;
+        nImmatureWatchOnly += b.nImmatureWatchOnly;
+        nAnonymizable += b.nAnonymizable;
+        nAnonymized += b.nAnonymized;
+        nDenominated += b.nDenominated;
+        nDenominatedUnconfirmed += b.nDenominatedUnconfirmed;
+        return *this;
+    }
+
+    CWalletBalances& operator-=(const CWalletBalances& b)
+    {
+        nTrusted -= b.nTrusted;
+        nUnconfirmed -= b.nUnconfirmed;
+        nImmature -= b.nImmature;
+        nWatchOnly -= b.nWatchOnly;
+        nUnconfirmedWatchOnly -= b.nUnconfirmedWatchOnly;
+        nImmatureWatchOnly -= b.nImmatureWatchOnly;
+        nAnonymizable -= b.nAnonymizable;
+        nAnonymized -= b.nAnonymized;
+        nDenominated -= b.nDenominated;
+        nDenominatedUnconfirmed -= b.nDenominatedUnconfirmed;
+        return *this;
+    }
+};
+
 struct CompactTallyItem {
     CBitcoinAddress address;
     CAmount nAmount;
@@ -159,7 +228,7 @@ public:
 class CWallet : public CCryptoKeyStore, public CValidationInterface
 {
 private:
-    bool SelectCoins(const CAmount& nTargetValue, std::set<std::pair<const CWalletTx*, unsigned int> >& setCoinsRet, CAmount& nValueRet, const CCoinControl* coinControl = NULL, AvailableCoinsType coin_type = ALL_COINS, bool useIX = true) const;
+    bool SelectCoins(const CAmount& nTargetValue, std::set<std::pair<const CWalletTx*, unsigned int> >& setCoinsRet, CAmount& nValueRet, const CCoinControl* coinControl = NULL, AvailableCoinsType coin_type = ALL_COINS, bool useIX = true);
     //it was public bool SelectCoins(int64_t nTargetValue, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, int64_t& nValueRet, const CCoinControl *coinControl = NULL, AvailableCoinsType coin_type=ALL_COINS, bool useIX = true) const;
 
     CWalletDB* pwalletdbEncryption;
@@ -173,6 +242,19 @@ private:
     int64_t nNextResend;
     int64_t nLastResend;
 
+    //! serial number hash -> mint for every non-archived zerocoin mint in this wallet
+    typedef boost::unordered_map<uint256, CZerocoinMint, BlockHasher> ZerocoinSerialMap;
+    ZerocoinSerialMap mapZerocoinSerials;
+    //! serial number hashes of mapZerocoinSerials bucketed by denomination
+    std::map<libzerocoin::CoinDenomination, std::set<uint256> > mapZerocoinDenominations;
+    //! serial number hashes of the "zcserial" records, the zerocoin spends made by this wallet
+    std::set<uint256> setZerocoinSpendSerials;
+
+    //! pubcoin hash -> partially computed accumulator witness of an unspent zerocoin mint
+    std::map<uint256, CZerocoinWitness> mapZerocoinWitnesses;
+    bool GetZerocoinWitness(const CBigNum& bnPubcoin, CZerocoinWitness& witnessCache) const;
+    void SetZerocoinWitness(const CZerocoinWitness& witnessCache);
+
     /**
      * Used to keep track of spent outpoints, and
      * detect and report conflicts (double-spends or
@@ -185,17 +267,66 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    /**
+     * Outputs of wallet transactions that are ours and not spent by a confirmed wallet transaction, so listing
+     * the available coins does not have to walk the whole wallet history. Depth, maturity, mempool and lock
+     * state change with time and are still checked by AvailableCoins() on these candidates. Transactions
+     * touched since the last listing are queued in setUnspentPending and re-evaluated lazily, key or script
+     * changes that can alter IsMine() of stored outputs rebuild the whole index. All of it is guarded by cs_wallet.
+     */
+    std::set<COutPoint> setUnspentOutputs;
+    std::set<COutPoint> setUnspentDenominated;
+    std::set<COutPoint> setUnspentMNCollateral;
+    std::set<uint256> setUnspentPending;
+    bool fUnspentOutputsDirty;
+    void QueueUnspentUpdate(const CTransaction& tx);
+    void UpdateUnspentOutputs();
+    void UpdateUnspentOutputs(const uint256& hash);
+
+    /**
+     * Running balance totals, kept as the sum of the credit each wallet transaction contributes so the
+     * balance getters don't walk mapWallet. A transaction's contribution only changes when it or a wallet
+     * transaction spending it is touched (setBalancePending, queued with the unspent output index), or, while
+     * it is unconfirmed, immature or not final, when the tip moves (setBalanceVolatile). Unconfirmed ones also
+     * follow the mempool (setBalanceMempool, re-evaluated once its update counter moves past
+     * nBalanceMempoolUpdated), and time locked ones are re-evaluated once the clock reaches
+     * nBalanceFinalityTime. A reorg below pindexBalances or an IsMine() change rebuilds the totals. All of it
+     * is guarded by cs_wallet.
+     */
+    CWalletBalances balances;
+    std::map<uint256, CWalletBalances> mapBalanceContributions;
+    std::set<uint256> setBalanceVolatile;
+    std::set<uint256> setBalancePending;
+    std::set<uint256> setBalanceMempool;
+    unsigned int nBalanceMempoolUpdated;
+    int64_t nBalanceFinalityTime;
+    const CBlockIndex* pindexBalances;
+    bool fBalancesDirty;
+    bool fBalanceTipChanged;
+    bool BalancesCurrent() const;
+    void QueueBalanceUpdate(const uint256& hash);
+    void UpdateBalances();
+    void UpdateBalances(const uint256& hash);
+    CWalletBalances GetBalances();
+
+    //! zerocoin balances are summed from the in-memory mint store, refreshed when a mint or the tip changes
+    CAmount nZerocoinBalance;
+    CAmount nZerocoinMatureBalance;
+    CAmount nZerocoinUnconfirmedBalance;
+    bool fZerocoinBalancesDirty;
+    void UpdateZerocoinBalances();
+
 public:
     bool MintableCoins();
-    bool SelectStakeCoins(std::set<std::pair<const CWalletTx*, unsigned int> >& setCoins, CAmount nTargetAmount) const;
-    bool SelectCoinsDark(CAmount nValueMin, CAmount nValueMax, std::vector<CTxIn>& setCoinsRet, CAmount& nValueRet, int nObfuscationRoundsMin, int nObfuscationRoundsMax) const;
+    bool SelectStakeCoins(std::set<std::pair<const CWalletTx*, unsigned int> >& setCoins, CAmount nTargetAmount);
+    bool SelectCoinsDark(CAmount nValueMin, CAmount nValueMax, std::vector<CTxIn>& setCoinsRet, CAmount& nValueRet, int nObfuscationRoundsMin, int nObfuscationRoundsMax);
     bool SelectCoinsByDenominations(int nDenom, CAmount nValueMin, CAmount nValueMax, std::vector<CTxIn>& vCoinsRet, std::vector<COutput>& vCoinsRet2, CAmount& nValueRet, int nObfuscationRoundsMin, int nObfuscationRoundsMax);
     bool SelectCoinsDarkDenominated(CAmount nTargetValue, std::vector<CTxIn>& setCoinsRet, CAmount& nValueRet) const;
-    bool HasCollateralInputs(bool fOnlyConfirmed = true) const;
+    bool HasCollateralInputs(bool fOnlyConfirmed = true);
     bool IsCollateralAmount(CAmount nInputAmount) const;
     int CountInputsWithAmount(CAmount nInputAmount);
 
-    bool SelectCoinsCollateral(std::vector<CTxIn>& setCoinsRet, CAmount& nValueRet) const;
+    bool SelectCoinsCollateral(std::vector<CTxIn>& setCoinsRet, CAmount& nValueRet);
 
     // Zerocoin additions
     bool CreateZerocoinMintTransaction(const CAmount nValue, CMutableTransaction& txNew, vector<CZerocoinMint>& vMints, CReserveKey* reservekey, int64_t& nFeeRet, std::string& strFailReason, const CCoinControl* coinControl = NULL, const bool isZCSpendChange = false);
@@ -208,6 +339,37 @@ public:
     void ReconsiderZerocoins(std::list<CZerocoinMint>& listMintsRestored);
     void ZCivBackupWallet();
 
+    /** In-memory mirror of the "zerocoin" and "zcserial" wallet records, keyed by serial number hash.
+     * Loaded with the wallet and kept current by the record writers below so that spend detection,
+     * balances and mint listings do not have to scan wallet.dat.
+     */
+    void AddToZerocoinSerialIndex(const CZerocoinMint& mint);
+    void RemoveFromZerocoinSerialIndex(const CZerocoinMint& mint);
+    bool GetMintFromSerial(const CBigNum& bnSerial, CZerocoinMint& mint) const;
+    void AddToZerocoinSpendIndex(const CBigNum& bnSerial);
+    void RemoveFromZerocoinSpendIndex(const CBigNum& bnSerial);
+
+    //! Write or erase zerocoin wallet records through walletdb and update the in-memory index to match
+    bool WriteZerocoinMint(CWalletDB& walletdb, const CZerocoinMint& mint);
+    bool EraseZerocoinMint(CWalletDB& walletdb, const CZerocoinMint& mint);
+    bool ArchiveMintOrphan(CWalletDB& walletdb, const CZerocoinMint& mint);
+    bool UnarchiveZerocoin(CWalletDB& walletdb, const CZerocoinMint& mint);
+    bool WriteZerocoinSpendSerialEntry(CWalletDB& walletdb, const CZerocoinSpend& spend);
+    bool EraseZerocoinSpendSerialEntry(CWalletDB& walletdb, const CBigNum& bnSerial);
+
+    /** The wallet's mints, optionally only those of one denomination. fUnusedOnly skips spent mints, fMaturedOnly
+     * keeps only mints with enough confirmations and later mints accumulated to be spent, fUpdateStatus fills in
+     * missing mint heights. Status updates found on the way are written back to the database.
+     */
+    std::list<CZerocoinMint> ListMintedCoins(bool fUnusedOnly, bool fMaturedOnly, bool fUpdateStatus, libzerocoin::CoinDenomination denom = libzerocoin::ZQ_ERROR);
+
+    /** Accumulator witnesses of the wallet's unspent mints, stored as "zcwitness" records.
+     * ThreadUpdateZerocoinWitnesses advances them on every accumulator checkpoint, outside of cs_main,
+     * so a spend only has to add the most recent blocks.
+     */
+    void LoadZerocoinWitness(const CZerocoinWitness& witnessCache);
+    void UpdateZerocoinWitnesses();
+
     /** Zerocin entry changed.
     * @note called with lock cs_wallet held.
     */
@@ -275,6 +437,16 @@ public:
         nWalletVersion = FEATURE_BASE;
         nWalletMaxVersion = FEATURE_BASE;
         fFileBacked = false;
+        fUnspentOutputsDirty = true;
+        pindexBalances = NULL;
+        fBalancesDirty = true;
+        fBalanceTipChanged = false;
+        nBalanceMempoolUpdated = 0;
+        nBalanceFinalityTime = 0;
+        nZerocoinBalance = 0;
+        nZerocoinMatureBalance = 0;
+        nZerocoinUnconfirmedBalance = 0;
+        fZerocoinBalancesDirty = true;
         nMasterKeyMaxID = 0;
         pwalletdbEncryption = NULL;
         nOrderPosNext = 0;
@@ -347,7 +519,7 @@ public:
         return nWalletMaxVersion >= wf;
     }
 
-    void AvailableCoins(std::vector<COutput>& vCoins, bool fOnlyConfirmed = true, const CCoinControl* coinControl = NULL, bool fIncludeZeroValue = false, AvailableCoinsType nCoinType = ALL_COINS, bool fUseIX = false) const;
+    void AvailableCoins(std::vector<COutput>& vCoins, bool fOnlyConfirmed = true, const CCoinControl* coinControl = NULL, bool fIncludeZeroValue = false, AvailableCoinsType nCoinType = ALL_COINS, bool fUseIX = false);
     std::map<CBitcoinAddress, std::vector<COutput> > AvailableCoinsByAddress(bool fConfirmed = true, CAmount maxCoinValue = 0);
     bool SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int nConfTheirs, std::vector<COutput> vCoins, std::set<std::pair<const CWalletTx*, unsigned int> >& setCoinsRet, CAmount& nValueRet) const;
 
@@ -442,23 +614,23 @@ public:
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
     void ReacceptWalletTransactions();
     void ResendWalletTransactions();
-    CAmount GetBalance() const;
-    CAmount GetZerocoinBalance(bool fMatureOnly) const;
-    CAmount GetUnconfirmedZerocoinBalance() const;
-    CAmount GetImmatureZerocoinBalance() const;
+    CAmount GetBalance();
+    CAmount GetZerocoinBalance(bool fMatureOnly);
+    CAmount GetUnconfirmedZerocoinBalance();
+    CAmount GetImmatureZerocoinBalance();
     CAmount GetLockedCoins() const;
     CAmount GetUnlockedCoins() const;
-    std::map<libzerocoin::CoinDenomination, CAmount> GetMyZerocoinDistribution() const;
-    CAmount GetUnconfirmedBalance() const;
-    CAmount GetImmatureBalance() const;
-    CAmount GetAnonymizableBalance() const;
-    CAmount GetAnonymizedBalance() const;
+    std::map<libzerocoin::CoinDenomination, CAmount> GetMyZerocoinDistribution();
+    CAmount GetUnconfirmedBalance();
+    CAmount GetImmatureBalance();
+    CAmount GetAnonymizableBalance();
+    CAmount GetAnonymizedBalance();
     double GetAverageAnonymizedRounds() const;
     CAmount GetNormalizedAnonymizedBalance() const;
-    CAmount GetDenominatedBalance(bool unconfirmed = false) const;
-    CAmount GetWatchOnlyBalance() const;
-    CAmount GetUnconfirmedWatchOnlyBalance() const;
-    CAmount GetImmatureWatchOnlyBalance() const;
+    CAmount GetDenominatedBalance(bool unconfirmed = false);
+    CAmount GetWatchOnlyBalance();
+    CAmount GetUnconfirmedWatchOnlyBalance();
+    CAmount GetImmatureWatchOnlyBalance();
     bool CreateTransaction(CScript scriptPubKey, int64_t nValue, CWalletTx& wtxNew, CReserveKey& reservekey, int64_t& nFeeRet, std::string& strFailReason, const CCoinControl* coinControl);
     bool CreateTransaction(const std::vector<std::pair<CScript, CAmount> >& vecSend,
         CWalletTx& wtxNew,
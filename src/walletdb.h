@@ -32,6 +32,7 @@ class CWallet;
 class CWalletTx;
 class CZerocoinMint;
 class CZerocoinSpend;
+class CZerocoinWitness;
 class uint160;
 class uint256;
 
@@ -154,14 +155,14 @@ public:
     bool ReadZerocoinMint(const CBigNum &bnSerial, CZerocoinMint& zerocoinMint);
     bool ArchiveMintOrphan(const CZerocoinMint& zerocoinMint);
     bool UnarchiveZerocoin(const CZerocoinMint& mint);
-    std::list<CZerocoinMint> ListMintedCoins(bool fUnusedOnly, bool fMaturedOnly, bool fUpdateStatus);
     std::list<CZerocoinSpend> ListSpentCoins();
-    std::list<CBigNum> ListMintedCoinsSerial();
     std::list<CBigNum> ListSpentCoinsSerial();
     std::list<CZerocoinMint> ListArchivedZerocoins();
     bool WriteZerocoinSpendSerialEntry(const CZerocoinSpend& zerocoinSpend);
     bool EraseZerocoinSpendSerialEntry(const CBigNum& serialEntry);
     bool ReadZerocoinSpendSerialEntry(const CBigNum& bnSerial);
+    bool WriteZerocoinWitness(const CZerocoinWitness& witnessCache);
+    bool EraseZerocoinWitness(const CZerocoinWitness& witnessCache);
 
 private:
     CWalletDB(const CWalletDB&);